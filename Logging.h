@@ -66,6 +66,21 @@ extern "C" {
 /// Utils
 # define LOGGING__STR(x) #x
 # define LOGGING_STR(x) LOGGING__STR(x)
+# if defined(__cplusplus) && __cplusplus >= 201103L
+#  define LOGGING_THREAD_LOCAL thread_local
+# elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#  define LOGGING_THREAD_LOCAL _Thread_local
+# elif defined(_MSC_VER)
+#  define LOGGING_THREAD_LOCAL __declspec(thread)
+# else
+#  define LOGGING_THREAD_LOCAL __thread
+# endif
+/* A variable shared by every module including Logging.h. */
+# if defined(__GNUC__)
+#  define LOGGING_GLOBAL __attribute__((weak))
+# else
+#  define LOGGING_GLOBAL static
+# endif
 
  //# define LOGGING_CONF_DEBUG
 # ifdef LOGGING_CONF_DEBUG
@@ -89,16 +104,27 @@ extern "C" {
 # if defined(LOGGING_AS_HEADER) || defined(LOGGING_AS_SOURCE)
 #  define LOGGING_EVIL_MODE
 # endif
-# if (defined(LOGGING_LOG_DIRECTION) && (LOGGING_LOG_MAX_SIZE > 0))
+# if (defined(LOGGING_LOG_DIRECTION) && (LOGGING_LOG_MAX_SIZE > 0)) \
+    || defined(LOGGING_CONF_RELOAD)
 #  define LOGGING_FEAT_FILE_TRUNCATE
 # endif
+# if defined(LOGGING_CONF_RELOAD) && !defined(LOGGING_CONF_DYNAMIC_LOG_LEVEL)
+#  define LOGGING_CONF_DYNAMIC_LOG_LEVEL
+# endif
 # if defined(LOGGING_LOG_LEVELFLAG) || defined(LOGGING_LOG_FILELINE) \
     || defined(LOGGING_LOG_TIME) || defined(LOGGING_LOG_DATETIME) \
     || defined(LOGGING_LOG_MODULE) || defined(LOGGING_LOG_FUNCTION) \
     || defined(LOGGING_LOG_PROCID) || defined(LOGGING_LOG_THRDID) \
-    || defined(LOGGING_EVIL_MODE)
+    || defined(LOGGING_LOG_SEQN) || defined(LOGGING_LOG_MONOTIME) \
+    || defined(LOGGING_LOG_BTRC) \
+    || defined(LOGGING_LOG_JSON) || defined(LOGGING_EVIL_MODE)
 #  define LOGGING_FEAT_WITH_FORMAT
 # endif
+# ifdef LOGGING_LOG_MODULE
+#  define LOGGING_MODULE_NAME LOGGING_LOG_MODULE
+# else
+#  define LOGGING_MODULE_NAME ""
+# endif
 
 /******************************************************************************/
 // Logging Level
@@ -134,32 +160,70 @@ typedef struct log_direction
    }
    )
 #  define LOGGING_DIR_WRITE logging_dir_fwrite
+#  define LOGGING_DIR_FILE // directions are FILE *
 # endif
 # define LOGGING_GET_LOG_DIRECTION_EX(r,D,w,n) \
   ( \
       (r)->d.dir = D, (r)->d.write = w, (r)->d.next = n, (r) \
   )
 # ifndef LOGGING_LOG_DIRECTION_LIST
-#  define LOGGING_GET_LOG_DIRECTION(r) LOGGING_GET_LOG_DIRECTION_EX(r, \
-           LOGGING_DIRECTION, LOGGING_DIR_WRITE, NULL)
+#  define LOGGING_DIRECTION_NEXT NULL
 # else
-#  define LOGGING_GET_LOG_DIRECTION(r) LOGGING_GET_LOG_DIRECTION_EX(r, \
-           LOGGING_DIRECTION, LOGGING_DIR_WRITE, LOGGING_LOG_DIRECTION_LIST)
+#  define LOGGING_DIRECTION_NEXT LOGGING_LOG_DIRECTION_LIST
 # endif
+# define LOGGING_GET_LOG_DIRECTION(r) LOGGING_GET_LOG_DIRECTION_EX(r, \
+         LOGGING_DIRECTION, LOGGING_DIR_WRITE, LOGGING_DIRECTION_NEXT)
 # define LOGGING_INIT_DIRECTION(r, l) do \
   { \
-      LOGGING_GET_LOG_DIRECTION(r); \
+      (void)LOGGING_GET_LOG_DIRECTION(r); \
+      LOGGING_CONFIG_DIRECTION(r); \
   } while (0)
+# if defined(LOGGING_CONF_SYSLOG) || defined(LOGGING_CONF_DIRECT) \
+    || defined(LOGGING_CONF_URING)
+   /*
+     Directions only get bytes: the level of the record being written, and
+     whether the thread loop has more records queued behind it, are handed
+     over per thread to the ones batching records.
+   */
+   LOGGING_GLOBAL LOGGING_THREAD_LOCAL int logging_dir_level;
+   LOGGING_GLOBAL LOGGING_THREAD_LOCAL int logging_dir_more;
+#  define LOGGING_DIR_RECORD(level) (logging_dir_level = (level))
+#  define LOGGING_DIR_MORE(more) (logging_dir_more = (more))
+# else
+#  define LOGGING_DIR_RECORD(level)
+#  define LOGGING_DIR_MORE(more)
+# endif
 
 /******************************************************************************/
 // Logging Record
 /******************************************************************************/
 struct log_record_format;
+/* What a configuration file sets, swapped as a whole by a reload. */
+typedef struct log_config
+{
+    unsigned generation;
+    struct log_levels *levels; // NULL for the environment's
+    char format[128]; // "" for the environment's
+    char path[256];
+    FILE *file; // NULL for LOGGING_LOG_DIRECTION
+    long max_size; // 0 for LOGGING_LOG_MAX_SIZE
+    int refs; // queued records and thread buffers holding it
+    struct log_config *retired; // replaced ones, freed once not held
+} log_config_t;
+/* The configuration a thread's records are built with, seen by a reload. */
+typedef struct log_config_slot
+{
+    struct log_config_slot *next; // every slot
+    const struct log_config *held; // NULL between records
+    int nesting; // records its thread is building
+    int dead; // its thread exited
+} log_config_slot_t;
 typedef struct log_record
 {
     #if defined(LOGGING_LOG_THREAD) || defined(LOGGING_EVIL_MODE)
     struct log_record *next;
     struct log_record *prev;
+    uint64_t stamp; // cycles when queued
     #endif
 
     struct log_direction d;
@@ -167,968 +231,7009 @@ typedef struct log_record
     const char *seperator;
 
     struct log_record_format *fmt;
+    const struct log_config *config; // snapshot taken by the record
 
     int mem_size;
     int message_size;
     int message_len;
+    int message_off; // where the message starts, after the formats
+    int message_heap; // message_buf spilled by malloc, owned by the record
+    int message_trunc; // message cut at LOGGING_LOG_RECORD_MAX_SIZE
+    char *message_buf; // &message, or the spill buffer of a long message
     char message;
 } log_record_t;
+# ifdef LOGGING_CONF_RELOAD
+   LOGGING_GLOBAL log_config_t *logging_config;
+   LOGGING_GLOBAL log_config_slot_t *logging_config_slots;
+   LOGGING_GLOBAL LOGGING_THREAD_LOCAL log_config_slot_t *logging_config_slot;
+   LOGGING_FUNC_DCL(const log_config_t *LOGGING_CONFIG_ACQUIRE(void));
+   LOGGING_FUNC_DCL(void LOGGING_CONFIG_LEAVE(void));
+   /* A configured file is written as a FILE *, whatever the direction. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_CONFIG_FWRITE(void *dir, const void *data, size_t size),
+   {
+       fwrite(data, 1, size, (FILE *)dir);
+   }
+   )
+/*
+  LOGGING_CONFIG() takes the current configuration in the thread's slot
+  until LOGGING_CONFIG_RELEASE, a record leaving the thread is counted in
+  it with LOGGING_CONFIG_HOLD until LOGGING_CONFIG_UNHOLD.
+*/
+#  define LOGGING_CONFIG() LOGGING_CONFIG_ACQUIRE()
+#  define LOGGING_CONFIG_RELEASE(c) LOGGING_CONFIG_LEAVE()
+#  define LOGGING_CONFIG_HOLD(c) do \
+   { \
+       if (c) { \
+           LOGGING_ATOMIC_ADD(&((log_config_t *)(c))->refs, 1); \
+       } \
+   } while (0)
+#  define LOGGING_CONFIG_UNHOLD(c) do \
+   { \
+       if (c) { \
+           LOGGING_ATOMIC_ADD_REL(&((log_config_t *)(c))->refs, -1); \
+       } \
+   } while (0)
+#  define LOGGING_CONFIG_DIRECTION(r) do \
+   { \
+       if ((r)->config && (r)->config->file) { \
+           (r)->d.dir = (r)->config->file; \
+           (r)->d.write = LOGGING_CONFIG_FWRITE; \
+       } \
+   } while (0)
+#  define LOGGING_CONFIG_FORMAT(r, fname) do \
+   { \
+       if ((r)->config && (r)->config->format[0]) { \
+           fname = (r)->config->format; \
+       } \
+   } while (0)
+#  define LOGGING_CONFIG_MAX_SIZE(r) \
+   ((r)->config && (r)->config->max_size > 0 ? (r)->config->max_size \
+                                              : LOGGING_LOG_MAX_SIZE)
+# else
+#  define LOGGING_CONFIG() ((const log_config_t *)NULL)
+#  define LOGGING_CONFIG_RELEASE(c)
+#  define LOGGING_CONFIG_HOLD(c)
+#  define LOGGING_CONFIG_UNHOLD(c)
+#  define LOGGING_CONFIG_DIRECTION(r)
+#  define LOGGING_CONFIG_FORMAT(r, fname)
+#  define LOGGING_CONFIG_MAX_SIZE(r) LOGGING_LOG_MAX_SIZE
+# endif
 # ifndef LOGGING_LOG_RECORD_SIZE
-#  define LOGGING_LOG_RECORD_SIZE 1024
+#  define LOGGING_LOG_RECORD_SIZE 256
 # endif
-
-/******************************************************************************/
-// Logging Logger
-/******************************************************************************/
-struct log_logger;
-typedef int (*log_format_init_t)(struct log_record *, struct log_logger *);
-struct log_logger_format
-{
-    const char *name;
-    log_format_init_t init;
-};
-# ifndef LOGGING_LOG_LOGGER_FORMAT_COUNT
-#  define LOGGING_LOG_LOGGER_FORMAT_COUNT 32
+# ifndef LOGGING_LOG_RECORD_MAX_SIZE
+#  define LOGGING_LOG_RECORD_MAX_SIZE (1024*1024)
+# endif
+# ifndef LOGGING_LOG_RECORD_SPILL_KEEP
+#  define LOGGING_LOG_RECORD_SPILL_KEEP (64*1024)
 # endif
-typedef struct log_logger
-{
-    const char *name; // LOGGING_LOG_MODULE
-    int level;
-    const char *levelflag;
-    const char *fileline;
-    const char *flie;
-    int line;
-    const char *function;
-    size_t format_count;
-    const char *format_conf;
-    struct log_logger_format formats[LOGGING_LOG_LOGGER_FORMAT_COUNT];
-} log_logger_t;
 
 /******************************************************************************/
-// Logging Format
+// Logging Statistics
 /******************************************************************************/
-/// Definition
-//// Struct
-typedef int (*log_format_format_t)(void *val, char *msg, int mlen, int first);
-typedef struct log_format_data
-{
-    void *data;
-    log_format_format_t format;
-} log_format_data_t;
-typedef struct log_record_format
-{
-#if !defined(LOGGING_EVIL_MODE)
-
-# if defined(LOGGING_LOG_LEVELFLAG)
-    const char * levelflag;
-# endif
-# if defined(LOGGING_LOG_FILELINE)
-    const char * fileline;
-# endif
-# if defined(LOGGING_LOG_FUNCTION)
-    const char * function;
-# endif
-# if defined(LOGGING_LOG_TIME)
-    int64_t time;
-# endif
-# if defined(LOGGING_LOG_DATETIME)
-    struct tm * datetime;
-# endif
-# if defined(LOGGING_LOG_MODULE)
-    const char * module;
-# endif
-# if defined(LOGGING_LOG_PROCID)
-    int64_t pid;
-# endif
-# if defined(LOGGING_LOG_THRDID)
-    int tid;
-# endif
-    int count;
-
+/*
+  Optional hot path instrumentation: with LOGGING_CONF_STATS the formats,
+  the message, the lock wait, the time in queue and the direction write are
+  timed with a cycle counter into per-thread log2 histograms, which
+  logging_stats_snapshot merges on demand. Without it all of this is gone.
+*/
+/// atomic
+# if defined(__GNUC__)
+#  define LOGGING_ATOMIC_LOAD(p) __atomic_load_n(p, __ATOMIC_RELAXED)
+#  define LOGGING_ATOMIC_STORE(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#  define LOGGING_ATOMIC_ADD(p, v) __atomic_fetch_add(p, v, __ATOMIC_RELAXED)
+#  define LOGGING_ATOMIC_LOAD_ACQ(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#  define LOGGING_ATOMIC_STORE_REL(p, v) \
+   __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#  define LOGGING_ATOMIC_CAS(p, e, d) \
+   __atomic_compare_exchange_n(p, e, d, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#  define LOGGING_ATOMIC_ADD_REL(p, v) \
+   __atomic_fetch_add(p, v, __ATOMIC_RELEASE)
+#  define LOGGING_ATOMIC_FENCE() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+# elif defined(_MSC_VER) && (defined(__cplusplus) || _MSC_VER >= 1939)
+/*
+  Interlocked intrinsics, full barriers, on the 32 or 64 bits of *p. A
+  value comes back as __int64 and is cast to the type of *p.
+*/
+#  include <intrin.h>
+#  ifdef __cplusplus
+}
+    template <class T> struct logging_atomic_type { typedef T type; };
+    template <class T> struct logging_atomic_type<T &> { typedef T type; };
+extern "C" {
+#   define LOGGING_ATOMIC_T(p) logging_atomic_type<decltype(*(p))>::type
+#  else
+#   define LOGGING_ATOMIC_T(p) __typeof__(*(p)) // C since VS 2022 17.9
+#  endif
+   static __inline __int64 LOGGING_ATOMIC_XADD(volatile void *p, __int64 v,
+                                               size_t n)
+   {
+       return n == 8 ? _InterlockedExchangeAdd64((volatile __int64 *)p, v)
+            : _InterlockedExchangeAdd((volatile long *)p, (long)v);
+   }
+   static __inline int LOGGING_ATOMIC_XCAS(volatile void *p, void *e,
+                                           __int64 d, size_t n)
+   {
+       if (n == 8) {
+           __int64 x = *(__int64 *)e;
+           __int64 o = _InterlockedCompareExchange64((volatile __int64 *)p,
+                                                     d, x);
+           return o == x ? 1 : (*(__int64 *)e = o, 0);
+       }
+       else {
+           long x = *(long *)e;
+           long o = _InterlockedCompareExchange((volatile long *)p,
+                                                (long)d, x);
+           return o == x ? 1 : (*(long *)e = o, 0);
+       }
+   }
+   static __inline void LOGGING_ATOMIC_XFENCE(void)
+   {
+       volatile long f = 0;
+       _InterlockedExchange(&f, 1);
+   }
+#  define LOGGING_ATOMIC_ADD(p, v) ((LOGGING_ATOMIC_T(p)) \
+   LOGGING_ATOMIC_XADD(p, (__int64)(v), sizeof(*(p))))
+#  define LOGGING_ATOMIC_LOAD(p) LOGGING_ATOMIC_ADD(p, 0)
+#  define LOGGING_ATOMIC_STORE(p, v) do \
+   { \
+       LOGGING_ATOMIC_T(p) _e = *(p); \
+       while (!LOGGING_ATOMIC_XCAS(p, &_e, (__int64)(v), sizeof(*(p)))); \
+   } while (0)
+#  define LOGGING_ATOMIC_LOAD_ACQ(p) LOGGING_ATOMIC_LOAD(p)
+#  define LOGGING_ATOMIC_STORE_REL(p, v) LOGGING_ATOMIC_STORE(p, v)
+#  define LOGGING_ATOMIC_CAS(p, e, d) \
+   LOGGING_ATOMIC_XCAS(p, e, (__int64)(d), sizeof(*(p)))
+#  define LOGGING_ATOMIC_ADD_REL(p, v) LOGGING_ATOMIC_ADD(p, v)
+#  define LOGGING_ATOMIC_FENCE() LOGGING_ATOMIC_XFENCE()
 # else
-    struct log_record_format *next;
-    const char *name;
-    log_format_format_t format;
-    /* variable info data */
-# endif
-} log_format_t;
-//// EVIL_FILED
-LOGGING_FUNC_DCL(void *LOGGING_RECORD_MALLOC(log_record_t *r, size_t size));
-# ifdef LOGGING_EVIL_MODE
-   log_format_t *LOGGING_RECORD_ADD_FORMAT(log_record_t *r, size_t s,
-       const char *n, log_format_format_t f);
-#  define LOGGING_FMT_FIELD_ADD(r, t, n, f) \
-   ((t *)(LOGGING_RECORD_ADD_FORMAT(r, sizeof(t), n, f)+1))
-#  define LOGGING_FMT_FILED_VAL(f, t) (*(t *)(((log_format_t *)(f))+1))
+#  error Logging.h needs the GCC __atomic builtins or MSVC Interlocked ones
 # endif
-//// Format Template
-///// LOGGING_FORMAT_FORMAT
-# define LOGGING_FORMAT_FORMAT(FIELD, TYPE, FMT, ...) \
-  LOGGING_FUNC_DEF( \
-  int LOGGING_FORMAT_FORMAT_##FIELD(void *r, char *m, int mlen, int f), \
-  { \
-      TYPE v = LOGGING_FORMAT_GET_##FIELD(r); \
-      LOGGING_PRINTF("r: %p, fmt: %s\n", r, FMT); \
-      int would_written = snprintf(m, mlen, " " FMT + !!(f), ##__VA_ARGS__); \
-      LOGGING_PRINTF("ww: %d\n", would_written); \
-      if (would_written > mlen) { \
-          return 0; \
-      } \
-      return would_written; \
-  } \
-  )
-///// LOGGING_FORMAT_SET
-# ifdef LOGGING_EVIL_MODE
-#  define LOGGING_FORMAT_SET(FIELD, SFIELD, TYPE, NAME) \
-   LOGGING_FUNC_DEF( \
-   void LOGGING_FORMAT_SET_##FIELD(log_record_t *r, TYPE v), \
-   { \
-       TYPE *m; \
-       m = LOGGING_FMT_FIELD_ADD(r, TYPE, NAME, \
-                                 LOGGING_FORMAT_FORMAT_##FIELD); \
-       if (m != NULL) *m = v; \
-   } \
+/// cycles
+# if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  define LOGGING_CYCLES() ((uint64_t)__builtin_ia32_rdtsc()) // no header
+# elif defined(_MSC_VER)
+#  include <intrin.h>
+#  define LOGGING_CYCLES() ((uint64_t)__rdtsc())
+# elif defined(__aarch64__)
+   LOGGING_FUNC_DEF(
+   uint64_t LOGGING_CYCLES(void),
+   {
+       uint64_t c;
+       __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(c));
+       return c;
+   }
    )
 # else
-#  define LOGGING_FORMAT_SET(FIELD, SFIELD, TYPE, NAME) \
-   LOGGING_FUNC_DEF( \
-   void LOGGING_FORMAT_SET_##FIELD(log_record_t *r, TYPE v), \
-   { \
-       log_format_format_t *fmter; \
-       r->fmt->SFIELD = v; \
-       fmter = (log_format_format_t *)LOGGING_RECORD_MALLOC(r, \
-                                     sizeof(log_format_format_t)); \
-       if (fmter != NULL) { \
-           *fmter = LOGGING_FORMAT_FORMAT_##FIELD; \
-           (r)->fmt->count += 1; \
-       } \
-   } \
+#  include <time.h>
+   LOGGING_FUNC_DEF(
+   uint64_t LOGGING_CYCLES(void),
+   {
+       return (uint64_t)clock();
+   }
    )
 # endif
-
-///// LOGGING_FORMAT_GET
-# ifdef LOGGING_EVIL_MODE
-#  define LOGGING_FORMAR_GET(FIELD, SFIELD, TYPE) \
-   LOGGING_FUNC_DEF( \
-   TYPE LOGGING_FORMAT_GET_##FIELD(void *f), \
-   { \
-       return LOGGING_FMT_FILED_VAL((log_format_t *)f, TYPE); \
-   } \
-   )
+/// stats
+# define LOGGING_STATS_FORMAT 0
+# define LOGGING_STATS_RECORD 1
+# define LOGGING_STATS_LOCK 2
+# define LOGGING_STATS_QUEUE 3
+# define LOGGING_STATS_WRITE 4
+# define LOGGING_STATS_STAGES 5
+# define LOGGING_STATS_BUCKETS 64 // bucket i counts [2^i, 2^(i+1)) cycles
+# define LOGGING_STATS_NAMES { "format", "record", "lock", "queue", "write" }
+typedef struct logging_stats
+{
+    uint64_t count[LOGGING_STATS_STAGES];
+    uint64_t cycles[LOGGING_STATS_STAGES];
+    uint64_t hist[LOGGING_STATS_STAGES][LOGGING_STATS_BUCKETS];
+} logging_stats_t;
+# if defined(__GNUC__)
+#  define LOGGING_STATS_LOG2(b, c) ((b) = (c) ? 63 - __builtin_clzll(c) : 0)
 # else
-#  define LOGGING_FORMAR_GET(FIELD, SFIELD, TYPE) \
-   LOGGING_FUNC_DEF( \
-   TYPE LOGGING_FORMAT_GET_##FIELD(void *f), \
+#  define LOGGING_STATS_LOG2(b, c) do \
    { \
-       return ((log_format_t *)f)->SFIELD; \
-   } \
+       for ((b) = 0; ((c) >> (b)) > 1; ++(b)); \
+   } while (0)
+# endif
+typedef struct logging_stats_node
+{
+    struct logging_stats_node *next;
+    logging_stats_t stats;
+} logging_stats_node_t;
+# if defined(LOGGING_CONF_STATS) || defined(LOGGING_AS_SOURCE)
+   LOGGING_FUNC_DEF(
+   logging_stats_node_t **LOGGING_STATS_LIST(void),
+   {
+       static logging_stats_node_t *list;
+       return &list;
+   }
+   )
+   /*
+     Only the owning thread writes its node, relaxed stores keep that as
+     cheap as plain ones while a snapshot reads it from another thread.
+   */
+   LOGGING_FUNC_DEF(
+   void LOGGING_STATS_ADD(int stage, uint64_t cycles),
+   {
+       static LOGGING_THREAD_LOCAL logging_stats_node_t *self;
+       logging_stats_t *s;
+       int b = 0;
+       if (self == NULL) {
+           self = (logging_stats_node_t *)calloc(1, sizeof(*self));
+           if (self == NULL) {
+               return;
+           }
+           self->next = LOGGING_ATOMIC_LOAD(LOGGING_STATS_LIST());
+           while (!LOGGING_ATOMIC_CAS(LOGGING_STATS_LIST(), &self->next, self));
+       }
+       s = &self->stats;
+       LOGGING_STATS_LOG2(b, cycles);
+       LOGGING_ATOMIC_STORE(&s->count[stage], s->count[stage]+1);
+       LOGGING_ATOMIC_STORE(&s->cycles[stage], s->cycles[stage]+cycles);
+       LOGGING_ATOMIC_STORE(&s->hist[stage][b], s->hist[stage][b]+1);
+   }
+   )
+   /* Merge the histograms of every thread that has logged so far. */
+   LOGGING_FUNC_DEF(
+   void logging_stats_snapshot(logging_stats_t *out),
+   {
+       logging_stats_node_t *n = LOGGING_ATOMIC_LOAD(LOGGING_STATS_LIST());
+       memset(out, 0, sizeof(*out));
+       for (; n; n = n->next) {
+           for (int i = 0; i < LOGGING_STATS_STAGES; ++i) {
+               out->count[i] += LOGGING_ATOMIC_LOAD(&n->stats.count[i]);
+               out->cycles[i] += LOGGING_ATOMIC_LOAD(&n->stats.cycles[i]);
+               for (int b = 0; b < LOGGING_STATS_BUCKETS; ++b) {
+                   out->hist[i][b] += LOGGING_ATOMIC_LOAD(&n->stats.hist[i][b]);
+               }
+           }
+       }
+   }
+   )
+   /* Upper bound in cycles of the bucket holding the p (0~1) percentile. */
+   LOGGING_FUNC_DEF(
+   uint64_t logging_stats_percentile(const logging_stats_t *s, int stage,
+       double p),
+   {
+       uint64_t want = (uint64_t)(p * (double)s->count[stage]), seen = 0;
+       for (int b = 0; b < LOGGING_STATS_BUCKETS; ++b) {
+           seen += s->hist[stage][b];
+           if (seen > want || seen == s->count[stage]) {
+               return b < LOGGING_STATS_BUCKETS-1 ? ((uint64_t)2 << b) - 1
+                                                  : UINT64_MAX;
+           }
+       }
+       return 0;
+   }
    )
 # endif
-
-
-///// LOGGING_FORMAT_INIT
-# define LOGGING_FORMAT_INIT(FIELD, COLLECT) \
-  LOGGING_FUNC_DEF( \
-  int LOGGING_FORMAT_INIT_##FIELD(log_record_t *r, log_logger_t *l), \
-  { \
-      LOGGING_FORMAT_SET_##FIELD(r, COLLECT); \
-      return 1; /* TODO */ \
-  } \
-  )
-
-///// LOGGING_FORMAT_REGISTER
-# define LOGGING_FMT_DEF(FIELD, SFIELD, NAME, TYPE, COLLECT, FMT, ...) \
-  LOGGING_FORMAR_GET(FIELD, SFIELD, TYPE) \
-  LOGGING_FORMAT_FORMAT(FIELD, TYPE, FMT, ##__VA_ARGS__) \
-  LOGGING_FORMAT_SET(FIELD, SFIELD, TYPE, NAME) \
-  LOGGING_FORMAT_INIT(FIELD, COLLECT)
-# ifdef LOGGING_EVIL_MODE
-#  define LOGGING_FORMAT_REGISTER(FIELD, NAME, TYPE, COLLECT, FMT, ...) \
-    LOGGING_FMT_DEF(FIELD, _, NAME, TYPE, COLLECT, FMT, ##__VA_ARGS__)
+# ifdef LOGGING_CONF_STATS
+#  define LOGGING_STATS_BEGIN(t) uint64_t t = LOGGING_CYCLES()
+#  define LOGGING_STATS_END(stage, t) \
+   LOGGING_STATS_ADD(stage, LOGGING_CYCLES() - (t))
+#  define LOGGING_STATS_STAMP(r) ((r)->stamp = LOGGING_CYCLES())
 # else
-#  define LOGGING_FORMAT_REGISTER(...)
+#  define LOGGING_STATS_BEGIN(t)
+#  define LOGGING_STATS_END(stage, t)
+#  define LOGGING_STATS_STAMP(r)
 # endif
 
-/// Level Flag
-# if defined(LOGGING_LOG_LEVELFLAG) || defined(LOGGING_AS_SOURCE)
-#  ifndef LOGGING_DEBUG_FLAG
-#   define LOGGING_DEBUG_FLAG "[D]"
-#  endif
-#  ifndef LOGGING_INFO_FLAG
-#   define LOGGING_INFO_FLAG "[I]"
+/******************************************************************************/
+// Logging Metrics
+/******************************************************************************/
+/*
+  Optional live counters with LOGGING_CONF_SHM_METRICS: records emitted,
+  filtered, dropped, truncated and bytes, per level and per module, kept in
+  a MAP_SHARED segment named /logging.<pid> so logging-top can read them
+  without touching the process. Counting is a relaxed atomic add.
+*/
+# define LOGGING_METRICS_EMITTED 0
+# define LOGGING_METRICS_FILTERED 1
+# define LOGGING_METRICS_DROPPED 2
+# define LOGGING_METRICS_TRUNCATED 3
+# define LOGGING_METRICS_BYTES 4
+# define LOGGING_METRICS_KINDS 5
+# define LOGGING_METRICS_LEVELS 5 // indexed by level, 0 unused
+# define LOGGING_METRICS_NAMES \
+  { "emitted", "filtered", "dropped", "truncated", "bytes" }
+# define LOGGING_METRICS_MAGIC 0x4D474F4C // "LOGM"
+# define LOGGING_METRICS_VERSION 1
+# ifndef LOGGING_CONF_METRICS_MODULES
+#  define LOGGING_CONF_METRICS_MODULES 64
+# endif
+typedef struct logging_metrics_module
+{
+    uint32_t state; // 0 free, 1 claiming, 2 ready
+    char name[60]; // module[0] is "", no module or no slot left
+    uint64_t counter[LOGGING_METRICS_LEVELS][LOGGING_METRICS_KINDS];
+} logging_metrics_module_t;
+typedef struct logging_metrics
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t modules; // LOGGING_CONF_METRICS_MODULES of the process
+    uint32_t size; // sizeof(logging_metrics_t) of the process
+    int64_t pid;
+    char proc[48];
+    logging_metrics_module_t module[LOGGING_CONF_METRICS_MODULES];
+} logging_metrics_t;
+# define LOGGING_METRICS_SHM_PREFIX "/logging."
+# ifdef LOGGING_CONF_SHM_METRICS
+#  if !defined(__unix__) && !defined(__APPLE__)
+#   error LOGGING_CONF_SHM_METRICS needs POSIX shared memory
 #  endif
-#  ifndef LOGGING_WARN_FLAG
-#   define LOGGING_WARN_FLAG "[W]"
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  if defined(__GLIBC__) && !defined(__USE_POSIX)
+    extern int shm_open(const char *, int, mode_t); // hidden by strict iso mode
+    extern int shm_unlink(const char *);
 #  endif
-#  ifndef LOGGING_ERROR_FLAG
-#   define LOGGING_ERROR_FLAG "[E]"
+#  if defined(__GLIBC__) && !defined(__USE_XOPEN2K8)
+    extern int ftruncate(int, off_t);
 #  endif
-#  define LOGGING_LEVELFLAG_VAL(r) r
-   LOGGING_FMT_DEF(LEVELFLAG, levelflag, "LVFG", const char *, l->levelflag,
-                   "%s", v)
-#  define LOGGING_LEVELFLAG_BUILTIN(l) \
-   LOGGING_LOGGER_ADD_FORMAT(l, "LVFG", LOGGING_FORMAT_INIT_LEVELFLAG)
-# else
-#  define LOGGING_DEBUG_FLAG
-#  define LOGGING_INFO_FLAG
-#  define LOGGING_WARN_FLAG
-#  define LOGGING_ERROR_FLAG
-#  define LOGGING_LEVELFLAG_BUILTIN(l)
-# endif
-
-/// Module
-# if defined(LOGGING_LOG_MODULE) || defined(LOGGING_AS_SOURCE)
-#  define LOGGING_MODULE_VAL(r) r
-   LOGGING_FMT_DEF(MODULE, module, "MODU", const char *, l->name, "%s", v)
-#  define LOGGING_MODULE_BUILTIN(l) \
-   LOGGING_LOGGER_ADD_FORMAT(l, "MODU", LOGGING_FORMAT_INIT_MODULE)
+   LOGGING_FUNC_DEF(
+   void LOGGING_METRICS_UNLINK(void),
+   {
+       char name[64];
+       snprintf(name, sizeof(name), LOGGING_METRICS_SHM_PREFIX "%lld",
+                (long long)getpid());
+       shm_unlink(name);
+   }
+   )
+   /* Map the segment once per process, NULL if it can't be. */
+   LOGGING_FUNC_DEF(
+   logging_metrics_t *LOGGING_METRICS(void),
+   {
+       static logging_metrics_t *metrics;
+       static int failed;
+       logging_metrics_t *m = LOGGING_ATOMIC_LOAD(&metrics), *none = NULL;
+       char name[64];
+       uint32_t magic = 0;
+       FILE *comm;
+       int fd;
+       if (m || LOGGING_ATOMIC_LOAD(&failed)) {
+           return m;
+       }
+       snprintf(name, sizeof(name), LOGGING_METRICS_SHM_PREFIX "%lld",
+                (long long)getpid());
+       fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+       if (fd < 0 || ftruncate(fd, sizeof(logging_metrics_t)) != 0) {
+           if (fd >= 0) {
+               close(fd);
+           }
+           LOGGING_ATOMIC_STORE(&failed, 1);
+           return NULL;
+       }
+       m = (logging_metrics_t *)mmap(NULL, sizeof(logging_metrics_t),
+           PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+       close(fd);
+       if (m == (logging_metrics_t *)MAP_FAILED) {
+           LOGGING_ATOMIC_STORE(&failed, 1);
+           return NULL;
+       }
+       if (!LOGGING_ATOMIC_CAS(&metrics, &none, m)) { // another thread won
+           munmap(m, sizeof(logging_metrics_t));
+           return none;
+       }
+       if (LOGGING_ATOMIC_CAS(&m->magic, &magic, 0)) { // a fresh segment
+           m->version = LOGGING_METRICS_VERSION;
+           m->modules = LOGGING_CONF_METRICS_MODULES;
+           m->size = (uint32_t)sizeof(logging_metrics_t);
+           m->pid = (int64_t)getpid();
+           if ((comm = fopen("/proc/self/comm", "r")) != NULL) {
+               if (fgets(m->proc, sizeof(m->proc), comm) != NULL) {
+                   m->proc[strcspn(m->proc, "\n")] = '\0';
+               }
+               fclose(comm);
+           }
+           m->module[0].state = 2;
+           LOGGING_ATOMIC_STORE_REL(&m->magic, LOGGING_METRICS_MAGIC);
+           atexit(LOGGING_METRICS_UNLINK);
+       }
+       return m;
+   }
+   )
+   /* Find or claim the slot of a module, slot 0 when they are used up. */
+   LOGGING_FUNC_DEF(
+   logging_metrics_module_t *LOGGING_METRICS_SLOT(const char *name),
+   {
+       logging_metrics_t *m = LOGGING_METRICS();
+       logging_metrics_module_t *s;
+       uint32_t state;
+       if (m == NULL) {
+           return NULL;
+       }
+       for (int i = 1; name[0] && i < LOGGING_CONF_METRICS_MODULES; ++i) {
+           s = &m->module[i];
+           state = 0;
+           if (LOGGING_ATOMIC_CAS(&s->state, &state, 1)) {
+               strncpy(s->name, name, sizeof(s->name)-1);
+               LOGGING_ATOMIC_STORE_REL(&s->state, 2);
+               return s;
+           }
+           while (state != 2) { // being claimed by another thread
+               state = LOGGING_ATOMIC_LOAD_ACQ(&s->state);
+           }
+           if (strncmp(s->name, name, sizeof(s->name)-1) == 0) {
+               return s;
+           }
+       }
+       return &m->module[0];
+   }
+   )
+   /* The slot of this translation unit's module, looked up once. */
+   static inline logging_metrics_module_t *LOGGING_METRICS_MODULE(void)
+   {
+       static logging_metrics_module_t *slot;
+       logging_metrics_module_t *s = LOGGING_ATOMIC_LOAD(&slot);
+       if (s == NULL) {
+           s = LOGGING_METRICS_SLOT(LOGGING_MODULE_NAME);
+           LOGGING_ATOMIC_STORE(&slot, s);
+       }
+       return s;
+   }
+#  define LOGGING_METRICS_ADD(level, kind, n) do \
+   { \
+       logging_metrics_module_t *_mm = LOGGING_METRICS_MODULE(); \
+       if (_mm) { \
+           LOGGING_ATOMIC_ADD(&_mm->counter[level][kind], (uint64_t)(n)); \
+       } \
+   } while (0)
+#  define LOGGING_METRICS_RECORD(r) do \
+   { \
+       logging_metrics_module_t *_mm = LOGGING_METRICS_MODULE(); \
+       if (_mm) { \
+           uint64_t *_mc = _mm->counter[(r)->level]; \
+           LOGGING_ATOMIC_ADD(&_mc[LOGGING_METRICS_EMITTED], (uint64_t)1); \
+           LOGGING_ATOMIC_ADD(&_mc[LOGGING_METRICS_BYTES], \
+                              (uint64_t)(r)->message_len); \
+           if ((r)->message_trunc) { \
+               LOGGING_ATOMIC_ADD(&_mc[LOGGING_METRICS_TRUNCATED], \
+                                  (uint64_t)1); \
+           } \
+       } \
+   } while (0)
 # else
-#  define LOGGING_MODULE_BUILTIN(l)
+#  define LOGGING_METRICS_ADD(level, kind, n)
+#  define LOGGING_METRICS_RECORD(r)
 # endif
 
-/// File & Line
-# if defined(LOGGING_LOG_FILELINE) || defined(LOGGING_AS_SOURCE)
-#  define __STR(x) #x
-#  define STR(x) __STR(x)
-#  define LOGGING_FILELINE_VAL(r) r
-   LOGGING_FMT_DEF(FILELINE, fileline, "FLLN", const char *, l->fileline,
-                   "%s", v)
-#  define LOGGING_FILELINE_BUILTIN(l) \
-   LOGGING_LOGGER_ADD_FORMAT(l, "FLLN", LOGGING_FORMAT_INIT_FILELINE)
-# else
-#  define LOGGING_FILELINE_BUILTIN(l)
+/******************************************************************************/
+// Logging Call Sites
+/******************************************************************************/
+/*
+  Every LOG_XXX site can register a static descriptor in the logging_sites
+  ELF section, the registry is walked through the __start/__stop symbols
+  the linker provides. With LOGGING_CONF_SITES each site can be switched on
+  and off at runtime, with LOGGING_CONF_SITE_PROFILE each site counts its
+  records and bytes and logging_sites_report lists the top sites.
+*/
+# if defined(LOGGING_CONF_SITES) || defined(LOGGING_CONF_SITE_PROFILE)
+#  define LOGGING_FEAT_SITES
 # endif
-
-/// Time
-# if defined(LOGGING_LOG_TIME) || defined(LOGGING_AS_SOURCE)
-#  if defined(__linux) || defined(__CYGWIN__)
-#   include <sys/time.h>
-    LOGGING_FUNC_DEF(
-    int64_t LOGGING_TIME(),
-    {
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        return (int64_t)tv.tv_sec * 100000 + tv.tv_usec;
-    }
-    )
-#  elif defined(_WIN32) || defined(_WIN64)
-#   include <windows.h>
-    LOGGING_FUNC_DEF(
-    int64_t LOGGING_TIME(),
-    {
-        FILETIME ft; LARGE_INTEGER li;
-        GetSystemTimeAsFileTime(&ft);
-        li.LowPart = ft.dwLowDateTime;
-        li.HighPart = ft.dwHighDateTime;
-        return (li.QuadPart - 116444736000000000UL)/10;
-    }
-    )
+# ifdef LOGGING_FEAT_SITES
+#  if !defined(__GNUC__) || defined(__APPLE__) || defined(_WIN32)
+#   error The call site registry needs an ELF toolchain
 #  endif
-   LOGGING_FMT_DEF(TIME, time, "TIME", int64_t, LOGGING_TIME(),
-                   "[%.6lf]", v/1e6)
-#  define LOGGING_TIME_BUILTIN(l) \
-   LOGGING_LOGGER_ADD_FORMAT(l, "TIME", LOGGING_FORMAT_INIT_TIME)
-# else
-#  define LOGGING_TIME_BUILTIN(l)
-# endif
-
-/// Datetime
-# if defined(LOGGING_LOG_DATETIME) || defined(LOGGING_AS_SOURCE)
+#  include <signal.h>
 #  include <time.h>
+typedef struct log_site
+{
+    const char *file;
+    const char *function;
+    const char *module;
+    int line;
+    int level;
+    int enabled;
+    struct log_site *next; // registered at first use
+    int registered;
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t last_count; // at the previous report
+    uint64_t last_bytes;
+} log_site_t;
+/*
+  Sites are registered by address since the linker may pad the sites
+  themselves, and by asm since a section attribute conflicts with the
+  COMDAT statics of C++ inline functions. Those can't be addressed by asm
+  in position independent code, so C++ sites there register at first use.
+*/
+#  ifndef LOGGING_CONF_SITES_LEVEL // sites above it start disabled
+#   define LOGGING_CONF_SITES_LEVEL LOGGING_LOG_LEVEL
+#  endif
+#  define LOGGING_SITE_INIT(lvl) \
+   { __FILE__, __FUNCTION__, LOGGING_MODULE_NAME, __LINE__, lvl, \
+     (lvl) <= LOGGING_CONF_SITES_LEVEL }
+#  if defined(__cplusplus) && (defined(__PIC__) || defined(__PIE__))
+#   define LOGGING_SITE_DEF(lvl) \
+    static log_site_t _site = LOGGING_SITE_INIT(lvl); \
+    if (!LOGGING_ATOMIC_LOAD_ACQ(&_site.registered)) { \
+        LOGGING_SITE_REGISTER(&_site); \
+    }
+#  else
+#   define LOGGING_SITE_DEF(lvl) \
+    static log_site_t _site = LOGGING_SITE_INIT(lvl); \
+    __asm__ __volatile__(".pushsection logging_sites,\"aw\"\n\t" \
+                         ".balign %c1\n\t.dc.a %c0\n\t.popsection" \
+                         :: "i"(&_site), "i"(sizeof(void *)))
+#  endif
+   extern log_site_t *__start_logging_sites[] __attribute__((weak));
+   extern log_site_t *__stop_logging_sites[] __attribute__((weak));
+   LOGGING_GLOBAL log_site_t *logging_sites_registered;
+/// match
    LOGGING_FUNC_DEF(
-   struct tm *LOGGING_DATETIME(),
+   int LOGGING_GLOB(const char *p, const char *s),
    {
-       time_t tm; time(&tm);
-       return localtime(&tm);
+       const char *star = NULL, *back = NULL;
+       while (*s) {
+           if (*p == '*') {
+               star = ++p;
+               back = s;
+           }
+           else if (*p == '?' || *p == *s) {
+               ++p;
+               ++s;
+           }
+           else if (star) {
+               p = star;
+               s = ++back;
+           }
+           else {
+               return 0;
+           }
+       }
+       while (*p == '*') {
+           ++p;
+       }
+       return *p == '\0';
    }
    )
-   LOGGING_FMT_DEF(DATETIME, datetime, "DTTM", struct tm *, LOGGING_DATETIME(),
-                   "[%04d-%02d-%02d %02d:%02d:%02d]",
-                   v->tm_year+1900, v->tm_mon+1, v->tm_mday,
-                   v->tm_hour, v->tm_min, v->tm_sec)
-#  define LOGGING_DATETIME_BUILTIN(l) \
-   LOGGING_LOGGER_ADD_FORMAT(l, "DTTM", LOGGING_FORMAT_INIT_DATETIME)
-# else
-#  define LOGGING_DATETIME_BUILTIN(l)
-# endif
-
-/// Function
-# if defined(LOGGING_LOG_FUNCTION) || defined(LOGGING_AS_SOURCE)
-   LOGGING_FMT_DEF(FUNCTION, function, "FUNC", const char *, l->function,
-                   "%s", v)
-#  define LOGGING_FUNCTION_BUILTIN(l) \
-   LOGGING_LOGGER_ADD_FORMAT(l, "FUNC", LOGGING_FORMAT_INIT_FUNCTION)
-# else
-#  define LOGGING_FUNCTION_BUILTIN(l)
-# endif
-
-/// Process ID
-# if defined(LOGGING_LOG_PROCID) || defined(LOGGING_AS_SOURCE)
-#  if defined(__linux) || defined(__CYGWIN__)
-#   include <sys/types.h>
-#   include <unistd.h>
-#   define LOGGING_GETPID() (int64_t)getpid()
-#  elif defined(_WIN32) || defined(_WIN64)
-#   include <windows.h>
-#   define LOGGING_GETPID() (int64_t)GetCurrentProcessId()
+   /*
+     spec is "file[:line[-line]]" or "@module[:line[-line]]", file and module
+     are globs, file also matches the path from any '/' on, so net/tcp.c
+     matches src/net/tcp.c.
+   */
+   LOGGING_FUNC_DEF(
+   int LOGGING_SITE_MATCH(const log_site_t *site, const char *spec),
+   {
+       char glob[256];
+       const char *colon = strrchr(spec, ':'), *f;
+       long from = 0, to = 0x7FFFFFFF;
+       size_t len = strlen(spec);
+       if (colon && colon[1] >= '0' && colon[1] <= '9') {
+           char *end;
+           from = to = strtol(colon+1, &end, 10);
+           if (*end == '-') {
+               to = end[1] ? strtol(end+1, &end, 10) : 0x7FFFFFFF;
+           }
+           len = (size_t)(colon - spec);
+       }
+       if (len >= sizeof(glob) || site->line < from || site->line > to) {
+           return 0;
+       }
+       memcpy(glob, spec, len);
+       glob[len] = '\0';
+       if (glob[0] == '@') {
+           return LOGGING_GLOB(glob+1, site->module);
+       }
+       if (glob[0] == '\0' || LOGGING_GLOB(glob, site->file)) {
+           return 1;
+       }
+       for (f = strchr(site->file, '/'); f; f = strchr(f+1, '/')) {
+           if (LOGGING_GLOB(glob, f+1)) {
+               return 1;
+           }
+       }
+       return 0;
+   }
+   )
+/// rules
+typedef struct log_site_rule
+{
+    struct log_site_rule *next;
+    int enabled;
+    char spec[128];
+} log_site_rule_t;
+   LOGGING_GLOBAL log_site_rule_t *logging_sites_rules; // newest first
+   LOGGING_FUNC_DEF(
+   void LOGGING_SITE_REGISTER(log_site_t *site),
+   {
+       int registered = 0;
+       log_site_rule_t *rule;
+       if (LOGGING_ATOMIC_CAS(&site->registered, &registered, 1)) {
+           for (rule = LOGGING_ATOMIC_LOAD_ACQ(&logging_sites_rules); rule;
+                rule = rule->next) { // the newest matching rule wins
+               if (LOGGING_SITE_MATCH(site, rule->spec)) {
+                   LOGGING_ATOMIC_STORE(&site->enabled, rule->enabled);
+                   break;
+               }
+           }
+           site->next = LOGGING_ATOMIC_LOAD(&logging_sites_registered);
+           while (!LOGGING_ATOMIC_CAS(&logging_sites_registered, &site->next,
+                                      site));
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int LOGGING_SITES_CMP_ADDR(const void *a, const void *b),
+   {
+       uintptr_t x = (uintptr_t)*(log_site_t *const *)a;
+       uintptr_t y = (uintptr_t)*(log_site_t *const *)b;
+       return (x > y) - (x < y);
+   }
+   )
+   /*
+     All sites known so far, each once, in a malloced array. NULL if there
+     is none or no memory.
+   */
+   LOGGING_FUNC_DEF(
+   log_site_t **logging_sites_list(size_t *count),
+   {
+       size_t n = (size_t)(__stop_logging_sites - __start_logging_sites), m = 0;
+       log_site_t *s, **sites;
+       for (s = LOGGING_ATOMIC_LOAD_ACQ(&logging_sites_registered); s;
+            s = s->next) {
+           ++n;
+       }
+       *count = 0;
+       if (n == 0 || (sites = (log_site_t **)malloc(n*sizeof(*sites))) == NULL) {
+           return NULL;
+       }
+       for (size_t i = 0; __start_logging_sites + i < __stop_logging_sites; ++i) {
+           sites[m++] = __start_logging_sites[i];
+       }
+       for (s = LOGGING_ATOMIC_LOAD_ACQ(&logging_sites_registered);
+            s && m < n; s = s->next) {
+           sites[m++] = s;
+       }
+       qsort(sites, m, sizeof(*sites), LOGGING_SITES_CMP_ADDR);
+       for (size_t i = 0; i < m; ++i) { // inlined or cloned code repeats sites
+           if (*count == 0 || sites[*count-1] != sites[i]) {
+               sites[(*count)++] = sites[i];
+           }
+       }
+       return sites;
+   }
+   )
+/// toggle
+   /*
+     Enable or disable the sites matching spec, also those registering
+     later. Returns how many sites were matched, -1 on a bad spec.
+   */
+   LOGGING_FUNC_DEF(
+   int logging_sites_set(const char *spec, int enabled),
+   {
+       log_site_rule_t *rule;
+       log_site_t **sites;
+       size_t n;
+       int matched = 0;
+       if (strlen(spec) >= sizeof(rule->spec)
+           || (rule = (log_site_rule_t *)malloc(sizeof(*rule))) == NULL) {
+           return -1;
+       }
+       strcpy(rule->spec, spec);
+       rule->enabled = !!enabled;
+       rule->next = LOGGING_ATOMIC_LOAD(&logging_sites_rules);
+       while (!LOGGING_ATOMIC_CAS(&logging_sites_rules, &rule->next, rule));
+       if ((sites = logging_sites_list(&n)) != NULL) {
+           for (size_t i = 0; i < n; ++i) {
+               if (LOGGING_SITE_MATCH(sites[i], spec)) {
+                   LOGGING_ATOMIC_STORE(&sites[i]->enabled, rule->enabled);
+                   ++matched;
+               }
+           }
+           free(sites);
+       }
+       return matched;
+   }
+   )
+   /* One "file:line [module] function level on|off" line per site. */
+   LOGGING_FUNC_DEF(
+   void logging_sites_dump(FILE *out),
+   {
+       size_t n;
+       log_site_t **sites = logging_sites_list(&n);
+       for (size_t i = 0; i < n; ++i) {
+           fprintf(out, "%s:%d [%s] %s %d %s\n", sites[i]->file,
+                   sites[i]->line, sites[i]->module, sites[i]->function,
+                   sites[i]->level,
+                   LOGGING_ATOMIC_LOAD(&sites[i]->enabled) ? "on" : "off");
+       }
+       free(sites);
+   }
+   )
+#  ifdef LOGGING_CONF_SITES
+#   define LOGGING_SITE_CHECK() \
+    if (__builtin_expect(!LOGGING_ATOMIC_LOAD(&_site.enabled), 0)) break
+#  else
+#   define LOGGING_SITE_CHECK()
 #  endif
-#  define LOGGING_PROCID_VAL(d) d
-   LOGGING_FMT_DEF(PROCID, pid, "PCID", int64_t, LOGGING_GETPID(), "pid(%d)")
-#  define LOGGING_PROCID_BUILTIN(l) \
-   LOGGING_LOGGER_ADD_FORMAT(l, "PCID", LOGGING_FORMAT_INIT_PROCID)
 # else
-#  define LOGGING_PROCID_BUILTIN(l)
+#  define LOGGING_SITE_DEF(lvl)
+#  define LOGGING_SITE_CHECK()
 # endif
 
-/// Thread ID
-# ifndef LOGGING_LOG_THRDID
-#  define LOGGING_THRDID_FMT
+/// profile
+# ifdef LOGGING_CONF_SITE_PROFILE
+#  define LOGGING_SITES_BY_BYTES 0
+#  define LOGGING_SITES_BY_RATE 1
+#  ifndef LOGGING_CONF_SITES_TOP
+#   define LOGGING_CONF_SITES_TOP 20
+#  endif
+   LOGGING_GLOBAL volatile sig_atomic_t logging_sites_signaled;
+typedef struct log_site_stat
+{
+    log_site_t *site;
+    uint64_t count;
+    uint64_t bytes;
+    uint64_t rate; // bytes since the previous report
+} log_site_stat_t;
+   LOGGING_FUNC_DEF(
+   int LOGGING_SITES_CMP(const void *a, const void *b),
+   {
+       const log_site_stat_t *x = (const log_site_stat_t *)a;
+       const log_site_stat_t *y = (const log_site_stat_t *)b;
+       return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int LOGGING_SITES_CMP_RATE(const void *a, const void *b),
+   {
+       const log_site_stat_t *x = (const log_site_stat_t *)a;
+       const log_site_stat_t *y = (const log_site_stat_t *)b;
+       return (x->rate < y->rate) - (x->rate > y->rate);
+   }
+   )
+   /*
+     Print the top sites by bytes or by bytes per second since the previous
+     report, top <= 0 prints all of them.
+   */
+   LOGGING_FUNC_DEF(
+   void logging_sites_report(FILE *out, int top, int by),
+   {
+       static time_t last;
+       time_t now = time(NULL);
+       double secs = last && now > last ? difftime(now, last) : 1;
+       size_t n;
+       uint64_t records = 0, bytes = 0;
+       log_site_t **sites = logging_sites_list(&n);
+       log_site_stat_t *st;
+       if (sites == NULL) {
+           return;
+       }
+       if ((st = (log_site_stat_t *)malloc(n*sizeof(*st))) == NULL) {
+           free(sites);
+           return;
+       }
+       for (size_t i = 0; i < n; ++i) {
+           log_site_t *s = sites[i];
+           st[i].site = s;
+           st[i].count = LOGGING_ATOMIC_LOAD(&s->count);
+           st[i].bytes = LOGGING_ATOMIC_LOAD(&s->bytes);
+           st[i].rate = st[i].bytes - s->last_bytes;
+           records += st[i].count;
+           bytes += st[i].bytes;
+       }
+       qsort(st, n, sizeof(*st), by == LOGGING_SITES_BY_RATE
+             ? LOGGING_SITES_CMP_RATE : LOGGING_SITES_CMP);
+       fprintf(out, "logging sites: %llu records, %llu bytes in %d sites\n"
+               "%14s %6s %12s %12s %10s  %s\n",
+               (unsigned long long)records, (unsigned long long)bytes, (int)n,
+               "bytes", "%", "records", "bytes/s", "records/s", "site");
+       for (size_t i = 0; i < n && (top <= 0 || (int)i < top); ++i) {
+           fprintf(out, "%14llu %6.2f %12llu %12.0f %10.0f  %s:%d\n",
+                   (unsigned long long)st[i].bytes,
+                   bytes ? 100.0 * (double)st[i].bytes / (double)bytes : 0.0,
+                   (unsigned long long)st[i].count,
+                   (double)st[i].rate / secs,
+                   (double)(st[i].count - st[i].site->last_count) / secs,
+                   st[i].site->file, st[i].site->line);
+       }
+       for (size_t i = 0; i < n; ++i) {
+           st[i].site->last_count = st[i].count;
+           st[i].site->last_bytes = st[i].bytes;
+       }
+       last = now;
+       free(st);
+       free(sites);
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_SITES_ON_SIGNAL(int sig),
+   {
+       (void)sig;
+       logging_sites_signaled = 1;
+   }
+   )
+   /*
+     Report the top LOGGING_CONF_SITES_TOP sites to stderr on sig, from the
+     next logging call instead of the signal handler.
+   */
+   LOGGING_FUNC_DEF(
+   void logging_sites_report_on(int sig),
+   {
+       signal(sig, LOGGING_SITES_ON_SIGNAL);
+   }
+   )
+#  define LOGGING_SITE_PROFILE(r) LOGGING_SITE_PROFILE_AT(&_site, r)
+#  define LOGGING_SITE_PROFILE_AT(site, r) do \
+   { \
+       LOGGING_ATOMIC_ADD(&(site)->count, (uint64_t)1); \
+       LOGGING_ATOMIC_ADD(&(site)->bytes, (uint64_t)(r)->message_len); \
+       if (logging_sites_signaled) { \
+           logging_sites_signaled = 0; \
+           logging_sites_report(stderr, LOGGING_CONF_SITES_TOP, \
+                                LOGGING_SITES_BY_BYTES); \
+       } \
+   } while (0)
 # else
-   // "Not support thread id now"
-#  define LOGGING_THRDID_FMT
+#  define LOGGING_SITE_PROFILE(r)
+#  define LOGGING_SITE_PROFILE_AT(site, r)
 # endif
 
 /******************************************************************************/
-// Logging Color
+// Logging JSON
 /******************************************************************************/
-# if !defined(LOGGING_LOG_COLOR)
-#  define LOGGING_DEBUG_COLOR
-#  define LOGGING_INFO_COLOR
-#  define LOGGING_WARN_COLOR
-#  define LOGGING_ERROR_COLOR
+/// escape
+/*
+  Escape s[0, len) in place, cap is the space s can grow to (without '\0').
+  The common case is a string with nothing to escape, so find the first
+  special char fast, and only expand (backward, no extra buffer) if needed.
+*/
+# define LOGGING_JSON_SPECIAL(c) \
+  ((c) == '"' || (c) == '\\' || (uint8_t)(c) < 0x20)
+# if defined(__SSE2__) && defined(__GNUC__)
+#  include <emmintrin.h>
+   LOGGING_FUNC_DEF(
+   int LOGGING_JSON_SCAN(const char *s, int len),
+   {
+       const __m128i q = _mm_set1_epi8('"');
+       const __m128i b = _mm_set1_epi8('\\');
+       const __m128i c = _mm_set1_epi8(0x1f);
+       int i = 0;
+       for (; i+16 <= len; i += 16) {
+           __m128i v = _mm_loadu_si128((const __m128i *)(s+i));
+           __m128i m = _mm_or_si128(
+               _mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, b)),
+               _mm_cmpeq_epi8(_mm_min_epu8(v, c), v));
+           int mask = _mm_movemask_epi8(m);
+           if (mask) {
+               return i + __builtin_ctz(mask);
+           }
+       }
+       while (i < len && !LOGGING_JSON_SPECIAL(s[i])) {
+           ++i;
+       }
+       return i;
+   }
+   )
 # else
-#  if defined(LOGGING_LOG_DIRECTION)
-#   error Color feature only support with stdout
-#  endif
-#  if defined(__linux) || defined(__CYGWIN__)
-#   define LOGGING_DEBUG_COLOR ((void *)"\033[37m")
-#   define LOGGING_INFO_COLOR ((void *)"\033[0m")
-#   define LOGGING_WARN_COLOR ((void *)"\033[1;33;40m")
-#   define LOGGING_ERROR_COLOR ((void *)"\033[1;31;40m")
-#   define LOGGING_CLEAR_COLOR ((void *)"\033[0m")
-#   define LOGGING_COLOR_SET(color) do \
-    { \
-        fprintf(stdout, "%s", (const char *)color); \
-    } while (0)
-#  elif defined(_WIN32) || defined(_WIN64)
-#  include <windows.h>
-#   define LOGGING_DEBUG_COLOR ((void *)FOREGROUND_INTENSITY)
-#   define LOGGING_INFO_COLOR  ((void *)0x07)
-#   define LOGGING_WARN_COLOR  ((void *)(FOREGROUND_INTENSITY | FOREGROUND_RED \
-                                         | FOREGROUND_GREEN))
-#   define LOGGING_ERROR_COLOR ((void *)(FOREGROUND_INTENSITY | FOREGROUND_RED))
-#   define LOGGING_CLEAR_COLOR ((void *)0x07)
-#   define LOGGING_COLOR_SET(color) do \
-    { \
-        HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE); \
-        SetConsoleTextAttribute(handle, (int)(uint64_t)(color)); \
-    } while (0)
-#  else
-#   error Not support platform
-#  endif
+   LOGGING_FUNC_DEF(
+   int LOGGING_JSON_SCAN(const char *s, int len),
+   {
+       int i = 0;
+       while (i < len && !LOGGING_JSON_SPECIAL(s[i])) {
+           ++i;
+       }
+       return i;
+   }
+   )
 # endif
-
-/******************************************************************************/
-// Logging File Truncate Support
-/******************************************************************************/
-# if defined(LOGGING_FEAT_FILE_TRUNCATE)
-#  if defined(__linux) || defined(__CYGWIN__)
-#   include <unistd.h>
-#   define LOGGING_FILE_TRUNCATE(file, size) ftruncate(fileno(file), size)
-#  elif defined(_WIN32) || defined(_WIN64)
-#   include <io.h>
-#   define LOGGING_FILE_TRUNCATE(file, size) _chsize(_fileno(file), size)
-#  endif
-#  ifndef LOGGING_LOG_ROLLBACK
-    #define LOGGING_LOG_ROLLBACK(_log_file) do \
-    { \
-        FILE *log_file = (FILE *)_log_file; \
-        if (log_file != stdout) { \
-            long org = ftell(log_file); \
-            fseek(log_file, 0L, SEEK_END); \
-            long pos = ftell(log_file); \
-            if (pos > LOGGING_LOG_MAX_SIZE) { \
-                LOGGING_FILE_TRUNCATE(log_file, 0); \
-                fseek(log_file, 0L, SEEK_SET); \
-            } \
-            else { \
-                fseek(log_file, org, SEEK_SET); \
-            } \
-        } \
-    } while (0)
-#  endif
-# else
-#  define LOGGING_LOG_ROLLBACK(log_file)
-# endif
-
-/******************************************************************************/
-// Dynamic Logging Format
-/******************************************************************************/
-/// Format Config String
-# ifndef LOGGING_CONF_DYNAMIC_LOG_FORMAT
-#  define LOGGING_GET_FORMAT_CONF_STR(x)
-# else
-#  ifdef LOGGING_LOG_MODULE
-#   define LOGGING_GET_MODULE_FORMAT_CONF_STR(pstr) do \
-    { \
-        *(pstr) = getenv(LOGGING_LOG_MODULE "_LOGGING_LOG_FORMAT"); \
-        LOGGING_PRINTF("%s module format conf str: %p\n", \
-                       LOGGING_LOG_MODULE, *(pstr)); \
-    } while (0)
-
-#  else
-#   define LOGGING_GET_MODULE_FORMAT_CONF_STR(pstr)
-#  endif
-#  define LOGGING_GET_FORMAT_CONF_STR(pstr) do \
-   { \
-       LOGGING_GET_MODULE_FORMAT_CONF_STR(pstr); \
-       if (*(pstr) != NULL) break; \
-       *(pstr) = getenv("LOGGING_LOG_FORMAT"); \
-       LOGGING_PRINTF("format conf str: %p\n", *(pstr)); \
-   } while (0)
-# endif
-
-/// Static Format Config
+# define LOGGING_JSON_SHORT "\"\\\n\r\t\b\f"
+# define LOGGING_JSON_EXTRA(c) (!LOGGING_JSON_SPECIAL(c) ? 0 \
+  : (((c) != '\0' && strchr(LOGGING_JSON_SHORT, (c))) ? 1 : 5))
 LOGGING_FUNC_DEF(
-void LOGGING_INIT_FORMAT_STATIC(struct log_record *r, struct log_logger *l),
+int LOGGING_JSON_ESCAPED_LEN(const char *s, int len),
 {
-    LOGGING_PRINTF("logger format count: %d\n", l->format_count);
-    for (int i = 0; i < l->format_count; ++i) {
-        LOGGING_PRINTF("%s format init\n", l->formats[i].name);
-        l->formats[i].init(r, l);
+    int i = LOGGING_JSON_SCAN(s, len);
+    int n = len;
+    for (; i < len; ++i) {
+        n += LOGGING_JSON_EXTRA(s[i]);
     }
+    return n;
 }
 )
-/// Dynamic Format Config
-LOGGING_FUNC_DCL(log_format_init_t
-    LOGGING_LOGGER_GET_FORMAT(struct log_logger *l, const char *name))
 LOGGING_FUNC_DEF(
-void LOGGING_INIT_FORMAT_DYNAMIC(struct log_record *r, struct log_logger *l),
+int LOGGING_JSON_ESCAPE(char *s, int len, int cap),
 {
-    const char *fname = l->format_conf;
-    if (fname == NULL) {
-        LOGGING_INIT_FORMAT_STATIC(r, l);
-        return;
+    const char *hex = "0123456789abcdef";
+    int i = LOGGING_JSON_SCAN(s, len);
+    int j, n = len;
+    if (i == len) {
+        return len > cap ? cap : len;
     }
-    LOGGING_PRINTF("FORMAT_CONF_STR: %s\n", fname);
-
-    log_format_init_t init;
-    while (fname && strlen(fname) >= 4) {
-        init = LOGGING_LOGGER_GET_FORMAT(l, fname);
-        if (init) {
-            init(r, l);
+    for (j = i; j < len; ++j) {
+        n += LOGGING_JSON_EXTRA(s[j]);
+    }
+    while (n > cap) { // drop tail chars until it fits
+        --len;
+        n -= 1 + LOGGING_JSON_EXTRA(s[len]);
+    }
+    for (j = len-1, len = n; j >= i; --j) {
+        uint8_t c = (uint8_t)s[j];
+        if (!LOGGING_JSON_SPECIAL(c)) {
+            s[--n] = (char)c;
+        }
+        else if (LOGGING_JSON_EXTRA(c) == 1) {
+            s[--n] = "\"\\nrtbf"[strchr(LOGGING_JSON_SHORT, c)-LOGGING_JSON_SHORT];
+            s[--n] = '\\';
+        }
+        else {
+            s[--n] = hex[c&0xf]; s[--n] = hex[c>>4];
+            s[--n] = '0'; s[--n] = '0'; s[--n] = 'u'; s[--n] = '\\';
         }
-        fname = strpbrk(fname, " ");
-        fname = fname != NULL ? fname+1 : fname;
     }
+    return len;
 }
 )
-
-/// Interface
-# ifdef LOGGING_CONF_DYNAMIC_LOG_FORMAT
-#  define LOGGING_INIT_FORMAT LOGGING_INIT_FORMAT_DYNAMIC
-# else
-#  define LOGGING_INIT_FORMAT LOGGING_INIT_FORMAT_STATIC
-# endif
-
-/******************************************************************************/
-// Logging Logger Functions
-/******************************************************************************/
-/// logger_get_caller_context
-# ifdef LOGGING_LOG_LEVELFLAG
-#  define LOGGING_LOGGER_GET_LEVELFLAG(l) do \
-   { \
-     const char *lvl_flag[] = { \
-         "", LOGGING_DEBUG_FLAG, LOGGING_INFO_FLAG, \
-         LOGGING_WARN_FLAG, LOGGING_ERROR_FLAG, \
-     }; \
-     (l)->levelflag = lvl_flag[(l)->level]; \
-   } while (0)
-# else
-#  define LOGGING_LOGGER_GET_LEVELFLAG(l) (l)->levelflag = NULL;
-# endif
-# ifdef LOGGING_LOG_MODULE
-#  define LOGGING_LOGGER_GET_MODULE(l) (l)->name = LOGGING_LOG_MODULE;
-# else
-#  define LOGGING_LOGGER_GET_MODULE(l) (l)->name = NULL;
-# endif
-# define LOGGING_LOGGER_GET_CALLER_CONTEXT(l) do \
-  { \
-    LOGGING_LOGGER_GET_MODULE(l); \
-    LOGGING_LOGGER_GET_LEVELFLAG(l); \
-    (l)->fileline = __FILE__ "(" LOGGING_STR(__LINE__) ")"; \
-    (l)->function = __FUNCTION__; \
-    (l)->flie = __FILE__; \
-    (l)->line = __LINE__; \
-  } while (0)
-/// logger_add_format
+/// key
 LOGGING_FUNC_DEF(
-int LOGGING_LOGGER_ADD_FORMAT(struct log_logger *l,
-                               const char *name, log_format_init_t init),
+int LOGGING_JSON_KEY(char *m, int mlen, const char *key, int comma),
 {
-    if (l->format_count < LOGGING_LOG_LOGGER_FORMAT_COUNT) {
-        l->formats[l->format_count].name = name;
-        l->formats[l->format_count].init = init;
-        l->format_count += 1;
-        LOGGING_PRINTF("logger add format: %s, %p\n", name, init);
-        return !0;
+    int n = 0;
+    if (comma && n < mlen) m[n++] = ',';
+    if (n < mlen) m[n++] = '"';
+    for (; *key && n < mlen; ++key) {
+        m[n++] = (*key >= 'A' && *key <= 'Z') ? (char)(*key-'A'+'a') : *key;
     }
-    return 0;
+    if (n < mlen) m[n++] = '"';
+    if (n < mlen) m[n++] = ':';
+    if (*key || n >= mlen) {
+        return 0;
+    }
+    m[n] = '\0';
+    return n;
 }
 )
-/// logger_get_format
+/// value
+/*
+  Turn an already rendered value m[0, len) into a json value: numbers stay as
+  they are, anything else is quoted and escaped. cap excludes the '\0'.
+*/
 LOGGING_FUNC_DEF(
-log_format_init_t LOGGING_LOGGER_GET_FORMAT(struct log_logger *l,
-                                            const char *name),
+int LOGGING_JSON_VALUE(char *m, int len, int cap),
 {
-    for (int i = 0; i < l->format_count; ++i) {
-        if (*(uint32_t *)name == *(uint32_t *)(l->formats[i].name)) {
-            LOGGING_PRINTF("%s init found\n", l->formats[i].name);
-            return l->formats[i].init;
-        }
+    int i = (len > 0 && m[0] == '-');
+    int digits = 0, dot = 0;
+    for (; i < len; ++i) {
+        if (m[i] >= '0' && m[i] <= '9') digits++;
+        else if (m[i] == '.' && !dot) dot = 1;
+        else break;
     }
-    return NULL;
+    if (i == len && digits > 0 && m[len-1] != '.') {
+        return len;
+    }
+    if (cap < 2) {
+        return 0;
+    }
+    memmove(m+1, m, len > cap-2 ? cap-2 : len);
+    m[0] = '"';
+    len = LOGGING_JSON_ESCAPE(m+1, len > cap-2 ? cap-2 : len, cap-2);
+    m[len+1] = '"';
+    m[len+2] = '\0';
+    return len+2;
 }
 )
-/// logger_add_builtin_format
-/*
-  This should be a macro function so that we can add builtin according to user
-  configuration.
-*/
-# define LOGGING_LOGGER_ADD_BUILTIN_FORMAT(l) do \
-{ \
-    LOGGING_LEVELFLAG_BUILTIN(l); \
-    LOGGING_DATETIME_BUILTIN(l); \
-    LOGGING_TIME_BUILTIN(l); \
-    LOGGING_PROCID_BUILTIN(l); \
-    LOGGING_MODULE_BUILTIN(l); \
-    LOGGING_FILELINE_BUILTIN(l); \
-    LOGGING_FUNCTION_BUILTIN(l); \
-} while (0)
 
-/// logger_add_custom_format
-# ifdef LOGGING_CONF_DYNAMIC_LOG_FORMAT
-#  ifdef LOGGING_LOGGER_ADD_CUSTOM_FORMAT_AS_FUNCTION
-    extern void LOGGING_LOGGER_ADD_CUSTOM_FORMAT(log_logger_t *l);
-#  elif !defined(LOGGING_LOGGER_ADD_CUSTOM_FORMAT)
-#   define LOGGING_LOGGER_ADD_CUSTOM_FORMAT(l)
+/******************************************************************************/
+// Logging Logger
+/******************************************************************************/
+struct log_logger;
+typedef int (*log_format_init_t)(struct log_record *, struct log_logger *);
+struct log_logger_format
+{
+    const char *name;
+    log_format_init_t init;
+};
+# ifndef LOGGING_LOG_LOGGER_FORMAT_COUNT
+#  define LOGGING_LOG_LOGGER_FORMAT_COUNT 32
+# endif
+typedef struct log_logger
+{
+    const char *name; // LOGGING_LOG_MODULE
+    int level;
+    const char *levelflag;
+    const char *fileline;
+    const char *flie;
+    int line;
+    const char *function;
+    size_t format_count;
+    const char *format_conf;
+    struct log_logger_format formats[LOGGING_LOG_LOGGER_FORMAT_COUNT];
+} log_logger_t;
+
+/******************************************************************************/
+// Logging Format
+/******************************************************************************/
+/// Definition
+//// Struct
+typedef int (*log_format_format_t)(void *val, char *msg, int mlen, int first);
+typedef struct log_format_data
+{
+    void *data;
+    log_format_format_t format;
+} log_format_data_t;
+typedef struct log_record_format
+{
+#if !defined(LOGGING_EVIL_MODE)
+
+# if defined(LOGGING_LOG_LEVELFLAG)
+    const char * levelflag;
+# endif
+# if defined(LOGGING_LOG_FILELINE)
+    const char * fileline;
+# endif
+# if defined(LOGGING_LOG_FUNCTION)
+    const char * function;
+# endif
+# if defined(LOGGING_LOG_TIME)
+    int64_t time;
+# endif
+# if defined(LOGGING_LOG_DATETIME)
+    struct tm * datetime;
+# endif
+# if defined(LOGGING_LOG_MODULE)
+    const char * module;
+# endif
+# if defined(LOGGING_LOG_PROCID)
+    int64_t pid;
+# endif
+# if defined(LOGGING_LOG_THRDID)
+    int64_t tid;
+# endif
+# if defined(LOGGING_LOG_SEQN)
+    uint64_t seqn;
+# endif
+# if defined(LOGGING_LOG_MONOTIME)
+    int64_t mono;
+# endif
+# if defined(LOGGING_LOG_BTRC)
+    const struct log_btrc *btrc;
+# endif
+    int count;
+
+# else
+    struct log_record_format *next;
+    const char *name;
+    log_format_format_t format;
+    /* variable info data */
+# endif
+} log_format_t;
+//// EVIL_FILED
+LOGGING_FUNC_DCL(void *LOGGING_RECORD_MALLOC(log_record_t *r, size_t size));
+LOGGING_FUNC_DCL(int LOGGING_RECORD_RESERVE(log_record_t *r, int size));
+# ifdef LOGGING_EVIL_MODE
+   log_format_t *LOGGING_RECORD_ADD_FORMAT(log_record_t *r, size_t s,
+       const char *n, log_format_format_t f);
+#  define LOGGING_FMT_FIELD_ADD(r, t, n, f) \
+   ((t *)(LOGGING_RECORD_ADD_FORMAT(r, sizeof(t), n, f)+1))
+#  define LOGGING_FMT_FILED_VAL(f, t) (*(t *)(((log_format_t *)(f))+1))
+# endif
+//// Format Template
+///// LOGGING_FORMAT_FORMAT
+# ifndef LOGGING_LOG_JSON
+#  define LOGGING_FORMAT_FORMAT(FIELD, SFIELD, TYPE, FMT, ...) \
+   LOGGING_FUNC_DEF( \
+   int LOGGING_FORMAT_FORMAT_##FIELD(void *r, char *m, int mlen, int f), \
+   { \
+       TYPE v = LOGGING_FORMAT_GET_##FIELD(r); \
+       LOGGING_PRINTF("r: %p, fmt: %s\n", r, FMT); \
+       int would_written = snprintf(m, mlen, " " FMT + !!(f), ##__VA_ARGS__); \
+       LOGGING_PRINTF("ww: %d\n", would_written); \
+       if (would_written > mlen) { \
+           return 0; \
+       } \
+       return would_written; \
+   } \
+   )
+# else
+/* builtin fields are keyed by their member name, registered ones by FIELD */
+#  define LOGGING_JSON_FIELD_KEY(FIELD, SFIELD) \
+   ((#SFIELD)[0] == '_' && (#SFIELD)[1] == '\0' ? #FIELD : #SFIELD)
+#  define LOGGING_FORMAT_FORMAT(FIELD, SFIELD, TYPE, FMT, ...) \
+   LOGGING_FUNC_DEF( \
+   int LOGGING_FORMAT_FORMAT_##FIELD(void *r, char *m, int mlen, int f), \
+   { \
+       TYPE v = LOGGING_FORMAT_GET_##FIELD(r); \
+       int kl = LOGGING_JSON_KEY(m, mlen, LOGGING_JSON_FIELD_KEY(FIELD, \
+                                                         SFIELD), !(f)); \
+       int vl; \
+       if (kl == 0) { \
+           return 0; \
+       } \
+       vl = snprintf(m+kl, mlen-kl, FMT, ##__VA_ARGS__); \
+       if (vl < 0 || vl >= mlen-kl) { \
+           return 0; \
+       } \
+       vl = LOGGING_JSON_VALUE(m+kl, vl, mlen-kl-1); \
+       return vl > 0 ? kl+vl : 0; \
+   } \
+   )
+# endif
+///// LOGGING_FORMAT_SET
+# ifdef LOGGING_EVIL_MODE
+#  define LOGGING_FORMAT_SET(FIELD, SFIELD, TYPE, NAME) \
+   LOGGING_FUNC_DEF( \
+   void LOGGING_FORMAT_SET_##FIELD(log_record_t *r, TYPE v), \
+   { \
+       TYPE *m; \
+       m = LOGGING_FMT_FIELD_ADD(r, TYPE, NAME, \
+                                 LOGGING_FORMAT_FORMAT_##FIELD); \
+       if (m != NULL) *m = v; \
+   } \
+   )
+# else
+#  define LOGGING_FORMAT_SET(FIELD, SFIELD, TYPE, NAME) \
+   LOGGING_FUNC_DEF( \
+   void LOGGING_FORMAT_SET_##FIELD(log_record_t *r, TYPE v), \
+   { \
+       log_format_format_t *fmter; \
+       r->fmt->SFIELD = v; \
+       fmter = (log_format_format_t *)LOGGING_RECORD_MALLOC(r, \
+                                     sizeof(log_format_format_t)); \
+       if (fmter != NULL) { \
+           *fmter = LOGGING_FORMAT_FORMAT_##FIELD; \
+           (r)->fmt->count += 1; \
+       } \
+   } \
+   )
+# endif
+
+///// LOGGING_FORMAT_GET
+# ifdef LOGGING_EVIL_MODE
+#  define LOGGING_FORMAR_GET(FIELD, SFIELD, TYPE) \
+   LOGGING_FUNC_DEF( \
+   TYPE LOGGING_FORMAT_GET_##FIELD(void *f), \
+   { \
+       return LOGGING_FMT_FILED_VAL((log_format_t *)f, TYPE); \
+   } \
+   )
+# else
+#  define LOGGING_FORMAR_GET(FIELD, SFIELD, TYPE) \
+   LOGGING_FUNC_DEF( \
+   TYPE LOGGING_FORMAT_GET_##FIELD(void *f), \
+   { \
+       return ((log_format_t *)f)->SFIELD; \
+   } \
+   )
+# endif
+
+
+///// LOGGING_FORMAT_INIT
+# define LOGGING_FORMAT_INIT(FIELD, COLLECT) \
+  LOGGING_FUNC_DEF( \
+  int LOGGING_FORMAT_INIT_##FIELD(log_record_t *r, log_logger_t *l), \
+  { \
+      LOGGING_FORMAT_SET_##FIELD(r, COLLECT); \
+      return 1; /* TODO */ \
+  } \
+  )
+
+///// LOGGING_FORMAT_REGISTER
+# define LOGGING_FMT_DEF(FIELD, SFIELD, NAME, TYPE, COLLECT, FMT, ...) \
+  LOGGING_FORMAR_GET(FIELD, SFIELD, TYPE) \
+  LOGGING_FORMAT_FORMAT(FIELD, SFIELD, TYPE, FMT, ##__VA_ARGS__) \
+  LOGGING_FORMAT_SET(FIELD, SFIELD, TYPE, NAME) \
+  LOGGING_FORMAT_INIT(FIELD, COLLECT)
+# ifdef LOGGING_EVIL_MODE
+#  define LOGGING_FORMAT_REGISTER(FIELD, NAME, TYPE, COLLECT, FMT, ...) \
+    LOGGING_FMT_DEF(FIELD, _, NAME, TYPE, COLLECT, FMT, ##__VA_ARGS__)
+# else
+#  define LOGGING_FORMAT_REGISTER(...)
+# endif
+
+/// Level Flag
+# if defined(LOGGING_LOG_LEVELFLAG) || defined(LOGGING_AS_SOURCE)
+#  if defined(LOGGING_LOG_JSON) && !defined(LOGGING_DEBUG_FLAG)
+#   define LOGGING_DEBUG_FLAG "DEBUG"
+#   define LOGGING_INFO_FLAG "INFO"
+#   define LOGGING_WARN_FLAG "WARN"
+#   define LOGGING_ERROR_FLAG "ERROR"
+#  endif
+#  ifndef LOGGING_DEBUG_FLAG
+#   define LOGGING_DEBUG_FLAG "[D]"
+#  endif
+#  ifndef LOGGING_INFO_FLAG
+#   define LOGGING_INFO_FLAG "[I]"
+#  endif
+#  ifndef LOGGING_WARN_FLAG
+#   define LOGGING_WARN_FLAG "[W]"
+#  endif
+#  ifndef LOGGING_ERROR_FLAG
+#   define LOGGING_ERROR_FLAG "[E]"
+#  endif
+#  define LOGGING_LEVELFLAG_VAL(r) r
+   LOGGING_FMT_DEF(LEVELFLAG, levelflag, "LVFG", const char *, l->levelflag,
+                   "%s", v)
+#  define LOGGING_LEVELFLAG_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "LVFG", LOGGING_FORMAT_INIT_LEVELFLAG)
+# else
+#  define LOGGING_DEBUG_FLAG
+#  define LOGGING_INFO_FLAG
+#  define LOGGING_WARN_FLAG
+#  define LOGGING_ERROR_FLAG
+#  define LOGGING_LEVELFLAG_BUILTIN(l)
+# endif
+
+/// Module
+# if defined(LOGGING_LOG_MODULE) || defined(LOGGING_AS_SOURCE)
+#  define LOGGING_MODULE_VAL(r) r
+   LOGGING_FMT_DEF(MODULE, module, "MODU", const char *, l->name, "%s", v)
+#  define LOGGING_MODULE_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "MODU", LOGGING_FORMAT_INIT_MODULE)
+# else
+#  define LOGGING_MODULE_BUILTIN(l)
+# endif
+
+/// File & Line
+# if defined(LOGGING_LOG_FILELINE) || defined(LOGGING_AS_SOURCE)
+#  define __STR(x) #x
+#  define STR(x) __STR(x)
+#  define LOGGING_FILELINE_VAL(r) r
+   LOGGING_FMT_DEF(FILELINE, fileline, "FLLN", const char *, l->fileline,
+                   "%s", v)
+#  define LOGGING_FILELINE_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "FLLN", LOGGING_FORMAT_INIT_FILELINE)
+# else
+#  define LOGGING_FILELINE_BUILTIN(l)
+# endif
+
+/// Time
+# if defined(LOGGING_LOG_TIME) || defined(LOGGING_AS_SOURCE)
+#  if defined(__linux) || defined(__CYGWIN__)
+#   include <sys/time.h>
+    LOGGING_FUNC_DEF(
+    int64_t LOGGING_TIME(),
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    }
+    )
+#  elif defined(_WIN32) || defined(_WIN64)
+#   include <windows.h>
+    LOGGING_FUNC_DEF(
+    int64_t LOGGING_TIME(),
+    {
+        FILETIME ft; LARGE_INTEGER li;
+        GetSystemTimeAsFileTime(&ft);
+        li.LowPart = ft.dwLowDateTime;
+        li.HighPart = ft.dwHighDateTime;
+        return (li.QuadPart - 116444736000000000UL)/10;
+    }
+    )
+#  endif
+#  ifdef LOGGING_LOG_JSON
+#   define LOGGING_TIME_FMT "%lld.%06lld"
+#  else
+#   define LOGGING_TIME_FMT "[%lld.%06lld]"
+#  endif
+   LOGGING_FMT_DEF(TIME, time, "TIME", int64_t, LOGGING_TIME(),
+                   LOGGING_TIME_FMT, (long long)(v / 1000000),
+                   (long long)(v % 1000000))
+#  define LOGGING_TIME_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "TIME", LOGGING_FORMAT_INIT_TIME)
+# else
+#  define LOGGING_TIME_BUILTIN(l)
+# endif
+
+/// Datetime
+# if defined(LOGGING_LOG_DATETIME) || defined(LOGGING_AS_SOURCE)
+#  include <time.h>
+   LOGGING_FUNC_DEF(
+   struct tm *LOGGING_DATETIME(),
+   {
+       time_t tm; time(&tm);
+       return localtime(&tm);
+   }
+   )
+#  ifdef LOGGING_LOG_JSON
+#   define LOGGING_DATETIME_FMT "%04d-%02d-%02dT%02d:%02d:%02d"
+#  else
+#   define LOGGING_DATETIME_FMT "[%04d-%02d-%02d %02d:%02d:%02d]"
+#  endif
+   LOGGING_FMT_DEF(DATETIME, datetime, "DTTM", struct tm *, LOGGING_DATETIME(),
+                   LOGGING_DATETIME_FMT,
+                   v->tm_year+1900, v->tm_mon+1, v->tm_mday,
+                   v->tm_hour, v->tm_min, v->tm_sec)
+#  define LOGGING_DATETIME_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "DTTM", LOGGING_FORMAT_INIT_DATETIME)
+# else
+#  define LOGGING_DATETIME_BUILTIN(l)
+# endif
+
+/// Function
+# if defined(LOGGING_LOG_FUNCTION) || defined(LOGGING_AS_SOURCE)
+   LOGGING_FMT_DEF(FUNCTION, function, "FUNC", const char *, l->function,
+                   "%s", v)
+#  define LOGGING_FUNCTION_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "FUNC", LOGGING_FORMAT_INIT_FUNCTION)
+# else
+#  define LOGGING_FUNCTION_BUILTIN(l)
+# endif
+
+/// Process ID
+# if defined(LOGGING_LOG_PROCID) || defined(LOGGING_AS_SOURCE)
+#  if defined(__linux) || defined(__CYGWIN__)
+#   include <sys/types.h>
+#   include <unistd.h>
+#   define LOGGING_GETPID() (int64_t)getpid()
+#  elif defined(_WIN32) || defined(_WIN64)
+#   include <windows.h>
+#   define LOGGING_GETPID() (int64_t)GetCurrentProcessId()
+#  endif
+#  define LOGGING_PROCID_VAL(d) d
+#  ifdef LOGGING_LOG_JSON
+#   define LOGGING_PROCID_FMT "%lld"
+#  else
+#   define LOGGING_PROCID_FMT "pid(%lld)"
+#  endif
+   LOGGING_FMT_DEF(PROCID, pid, "PCID", int64_t, LOGGING_GETPID(),
+                   LOGGING_PROCID_FMT, (long long)v)
+#  define LOGGING_PROCID_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "PCID", LOGGING_FORMAT_INIT_PROCID)
+# else
+#  define LOGGING_PROCID_BUILTIN(l)
+# endif
+
+/// Thread ID
+# if defined(LOGGING_LOG_THRDID) || defined(LOGGING_AS_SOURCE)
+#  if defined(__linux)
+#   include <unistd.h>
+#   include <sys/syscall.h>
+#   if defined(__GLIBC__) && !defined(__USE_MISC)
+     extern long syscall(long, ...); // hidden by strict iso mode
+#   endif
+#   define LOGGING_GETTID() (int64_t)syscall(SYS_gettid)
+#  elif defined(_WIN32) || defined(_WIN64)
+#   include <windows.h>
+#   define LOGGING_GETTID() (int64_t)GetCurrentThreadId()
+#  else
+#   define LOGGING_GETTID() (int64_t)0
+#  endif
+#  ifdef LOGGING_LOG_JSON
+#   define LOGGING_THRDID_FMT "%lld"
+#  else
+#   define LOGGING_THRDID_FMT "tid(%lld)"
+#  endif
+   LOGGING_FMT_DEF(THRDID, tid, "TRID", int64_t, LOGGING_GETTID(),
+                   LOGGING_THRDID_FMT, (long long)v)
+#  define LOGGING_THRDID_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "TRID", LOGGING_FORMAT_INIT_THRDID)
+# else
+#  define LOGGING_THRDID_BUILTIN(l)
+# endif
+
+/// Sequence Number
+# if defined(LOGGING_LOG_SEQN) || defined(LOGGING_AS_SOURCE)
+   /*
+     A number counted per record from 1, by the process, or by all the
+     processes giving the same LOGGING_CONF_SEQN_SHM name ("/app.seqn") to
+     a counter in shared memory.
+   */
+   LOGGING_GLOBAL uint64_t logging_seqn;
+#  if defined(LOGGING_CONF_SEQN_SHM)
+#   if !defined(__unix__) && !defined(__APPLE__)
+#    error LOGGING_CONF_SEQN_SHM needs POSIX shared memory
+#   endif
+#   include <sys/types.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   include <unistd.h>
+#   if defined(__GLIBC__) && !defined(__USE_POSIX)
+     extern int shm_open(const char *, int, mode_t); // hidden by strict iso
+#   endif
+#   if defined(__GLIBC__) && !defined(__USE_XOPEN2K8)
+     extern int ftruncate(int, off_t);
+#   endif
+    LOGGING_GLOBAL uint64_t *logging_seqn_counter; // NULL until mapped
+    /* Map the shared counter once, the process' one if it can't be. */
+    LOGGING_FUNC_DEF(
+    uint64_t *LOGGING_SEQN_COUNTER(void),
+    {
+        uint64_t *c = LOGGING_ATOMIC_LOAD_ACQ(&logging_seqn_counter);
+        uint64_t *none = NULL;
+        int fd;
+        if (c) {
+            return c;
+        }
+        fd = shm_open(LOGGING_CONF_SEQN_SHM, O_RDWR | O_CREAT, 0644);
+        if (fd >= 0 && ftruncate(fd, sizeof(uint64_t)) == 0) {
+            c = (uint64_t *)mmap(NULL, sizeof(uint64_t),
+                PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (c == NULL || c == (uint64_t *)MAP_FAILED) {
+            c = &logging_seqn;
+        }
+        if (!LOGGING_ATOMIC_CAS(&logging_seqn_counter, &none, c)) {
+            if (c != &logging_seqn) { // another thread won
+                munmap(c, sizeof(uint64_t));
+            }
+            return none;
+        }
+        return c;
+    }
+    )
+#   ifdef __GNUC__
+    /* Map it before main, so that a signal handler never has to. */
+    static __attribute__((constructor, unused)) void LOGGING_SEQN_MAP(void)
+    {
+        (void)LOGGING_SEQN_COUNTER();
+    }
+#   endif
+    /*
+      For signal handlers: shm_open and mmap are not async signal safe, so
+      count by the process until the counter is mapped.
+    */
+    LOGGING_FUNC_DEF(
+    uint64_t LOGGING_SEQN_SIGNAL_SAFE(void),
+    {
+        uint64_t *c = LOGGING_ATOMIC_LOAD_ACQ(&logging_seqn_counter);
+        return LOGGING_ATOMIC_ADD(c ? c : &logging_seqn, 1) + 1;
+    }
+    )
+#   define LOGGING_SEQN() (LOGGING_ATOMIC_ADD(LOGGING_SEQN_COUNTER(), 1) + 1)
+#  else
+#   define LOGGING_SEQN() (LOGGING_ATOMIC_ADD(&logging_seqn, 1) + 1)
+#   define LOGGING_SEQN_SIGNAL_SAFE() LOGGING_SEQN()
+#  endif
+#  ifdef LOGGING_LOG_JSON
+#   define LOGGING_SEQN_FMT "%llu"
+#  else
+#   define LOGGING_SEQN_FMT "seq(%llu)"
+#  endif
+   LOGGING_FMT_DEF(SEQN, seqn, "SEQN", uint64_t, LOGGING_SEQN(),
+                   LOGGING_SEQN_FMT, (unsigned long long)v)
+#  define LOGGING_SEQN_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "SEQN", LOGGING_FORMAT_INIT_SEQN)
+# else
+#  define LOGGING_SEQN_BUILTIN(l)
+# endif
+
+/// Monotonic Time
+# if defined(LOGGING_LOG_MONOTIME) || defined(LOGGING_CONF_TIMERS) \
+     || defined(LOGGING_AS_SOURCE)
+#  if defined(__unix__) || defined(__APPLE__)
+#   include <time.h>
+#   include <sched.h> // struct timespec in strict iso mode
+#   if defined(__GLIBC__) && !defined(__USE_POSIX199309)
+     extern int clock_gettime(int, struct timespec *);
+#   endif
+#   ifndef CLOCK_MONOTONIC
+#    define CLOCK_MONOTONIC 1
+#   endif
+    LOGGING_FUNC_DEF(
+    int64_t LOGGING_MONOTIME(void),
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    }
+    )
+#  elif defined(_WIN32) || defined(_WIN64)
+#   include <windows.h>
+    LOGGING_FUNC_DEF(
+    int64_t LOGGING_MONOTIME(void),
+    {
+        LARGE_INTEGER c, f;
+        QueryPerformanceCounter(&c);
+        QueryPerformanceFrequency(&f);
+        return (int64_t)(c.QuadPart / f.QuadPart * 1000000000
+                         + c.QuadPart % f.QuadPart * 1000000000 / f.QuadPart);
+    }
+    )
+#  endif
+# endif
+# if defined(LOGGING_LOG_MONOTIME) || defined(LOGGING_AS_SOURCE)
+#  ifdef LOGGING_LOG_JSON
+#   define LOGGING_MONOTIME_FMT "%lld"
+#  else
+#   define LOGGING_MONOTIME_FMT "mono(%lld)"
+#  endif
+   LOGGING_FMT_DEF(MONOTIME, mono, "MONO", int64_t, LOGGING_MONOTIME(),
+                   LOGGING_MONOTIME_FMT, (long long)v)
+#  define LOGGING_MONOTIME_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "MONO", LOGGING_FORMAT_INIT_MONOTIME)
+# else
+#  define LOGGING_MONOTIME_BUILTIN(l)
+# endif
+
+/// Backtrace
+# if defined(LOGGING_LOG_BTRC) || defined(LOGGING_AS_SOURCE)
+   /*
+     The raw return addresses of the records at LOGGING_BTRC_LEVEL or more
+     severe, by backtrace(), CaptureStackBackTrace or, with
+     LOGGING_CONF_BTRC_FP, a walk of the frame pointers. Nothing is looked
+     up on the logging thread: LOGGING_CONF_BTRC_SYMBOLS names the frames
+     when the record is written, by the writer thread in threading mode,
+     and logging_btrc_loadmap saves what is needed to do it offline.
+   */
+#  ifndef LOGGING_BTRC_LEVEL
+#   define LOGGING_BTRC_LEVEL LOGGING_ERROR_LEVEL
+#  endif
+#  ifndef LOGGING_BTRC_DEPTH
+#   define LOGGING_BTRC_DEPTH 16
+#  endif
+#  ifndef LOGGING_BTRC_SKIP // frames between the caller and the capture
+#   if defined(LOGGING_EVIL_MODE) || !defined(__OPTIMIZE__)
+#    define LOGGING_BTRC_INIT_FRAMES 1 // LOGGING_INIT_FORMAT not inlined
+#   else
+#    define LOGGING_BTRC_INIT_FRAMES 0
+#   endif
+#   ifdef LOGGING_CONF_SLOW_PATH
+#    define LOGGING_BTRC_SKIP (LOGGING_BTRC_INIT_FRAMES + 1) // logging_log
+#   else
+#    define LOGGING_BTRC_SKIP LOGGING_BTRC_INIT_FRAMES
+#   endif
+#  endif
+   typedef struct log_btrc
+   {
+       int n;
+       void *pc[LOGGING_BTRC_DEPTH];
+   } log_btrc_t;
+   /* Fill bt with the frames above the function calling it. */
+#  if defined(LOGGING_CONF_BTRC_FP) && defined(__GNUC__)
+#   define LOGGING_BTRC_WALK(bt) do \
+    { \
+        void **_fp = (void **)__builtin_frame_address(0), **_next; \
+        int _skip = LOGGING_BTRC_SKIP; \
+        (bt)->n = 0; \
+        while (_fp && (bt)->n < LOGGING_BTRC_DEPTH && _fp[1]) { \
+            if (_skip > 0) { \
+                --_skip; \
+            } \
+            else { \
+                (bt)->pc[(bt)->n++] = _fp[1]; \
+            } \
+            _next = (void **)_fp[0]; \
+            if (_next <= _fp || (char *)_next - (char *)_fp > (1 << 20) \
+                || ((uintptr_t)_next & (sizeof(void *) - 1))) { \
+                break; /* the bottom, or no frame pointer */ \
+            } \
+            _fp = _next; \
+        } \
+    } while (0)
+#  elif defined(_WIN32) || defined(_WIN64)
+#   include <windows.h>
+#   define LOGGING_BTRC_WALK(bt) \
+    ((bt)->n = (int)CaptureStackBackTrace(1 + LOGGING_BTRC_SKIP, \
+                                          LOGGING_BTRC_DEPTH, (bt)->pc, NULL))
+#  elif defined(__GLIBC__) || defined(__APPLE__)
+#   include <execinfo.h>
+#   define LOGGING_BTRC_WALK(bt) do \
+    { \
+        void *_pc[1 + LOGGING_BTRC_SKIP + LOGGING_BTRC_DEPTH]; \
+        int _n = backtrace(_pc, 1 + LOGGING_BTRC_SKIP + LOGGING_BTRC_DEPTH); \
+        (bt)->n = _n > 1 + LOGGING_BTRC_SKIP ? _n - 1 - LOGGING_BTRC_SKIP : 0; \
+        memcpy((bt)->pc, _pc + 1 + LOGGING_BTRC_SKIP, \
+               (size_t)(bt)->n * sizeof(void *)); \
+    } while (0)
+#  else
+#   define LOGGING_BTRC_WALK(bt) ((bt)->n = 0)
+#  endif
+#  ifdef LOGGING_LOG_JSON
+    LOGGING_FUNC_DEF(
+    int LOGGING_BTRC_OPEN(char *m, int mlen, int first),
+    {
+        int n = LOGGING_JSON_KEY(m, mlen, "btrc", !first);
+        if (n == 0 || n + 1 >= mlen) {
+            return 0;
+        }
+        m[n++] = '"';
+        return n;
+    }
+    )
+#   define LOGGING_BTRC_CLOSE '"'
+#   define LOGGING_BTRC_JSON 1
+#   define LOGGING_BTRC_MARK "\"btrc\":\"0x"
+#  else
+#   define LOGGING_BTRC_OPEN(m, mlen, first) \
+    snprintf(m, mlen, " bt(" + !!(first))
+#   define LOGGING_BTRC_CLOSE ')'
+#   define LOGGING_BTRC_JSON 0
+#   define LOGGING_BTRC_MARK "bt(0x"
+#  endif
+   LOGGING_FORMAR_GET(BTRC, btrc, const log_btrc_t *)
+   LOGGING_FUNC_DEF(
+   int LOGGING_FORMAT_FORMAT_BTRC(void *f, char *m, int mlen, int first),
+   {
+       const log_btrc_t *bt = LOGGING_FORMAT_GET_BTRC(f);
+       static const char hex[] = "0123456789abcdef";
+       int n;
+
+       if (mlen < 8 + bt->n * (2 + 2 * (int)sizeof(void *) + 1)) {
+           return 0;
+       }
+       if ((n = LOGGING_BTRC_OPEN(m, mlen, first)) <= 0) {
+           return 0;
+       }
+       for (int i = 0; i < bt->n; ++i) {
+           uintptr_t pc = (uintptr_t)bt->pc[i];
+           int d = 1;
+           while (d < (int)sizeof(pc) * 2 && (pc >> (4 * d)) != 0) {
+               ++d;
+           }
+           if (i > 0) {
+               m[n++] = ' ';
+           }
+           m[n++] = '0';
+           m[n++] = 'x';
+           while (d-- > 0) {
+               m[n++] = hex[(pc >> (4 * d)) & 0xf];
+           }
+       }
+       m[n++] = LOGGING_BTRC_CLOSE;
+       m[n] = '\0';
+       return n;
+   }
+   )
+   LOGGING_FORMAT_SET(BTRC, btrc, const log_btrc_t *, "BTRC")
+   LOGGING_FUNC_DEF(
+   int LOGGING_FORMAT_INIT_BTRC(log_record_t *r, log_logger_t *l),
+   {
+       static LOGGING_THREAD_LOCAL log_btrc_t bt; // formatted before reuse
+       (void)l;
+       if (r->level <= LOGGING_BTRC_LEVEL) {
+           LOGGING_BTRC_WALK(&bt);
+           if (bt.n > 0) {
+               LOGGING_FORMAT_SET_BTRC(r, &bt);
+           }
+       }
+       return 1;
+   }
+   )
+#  define LOGGING_BTRC_BUILTIN(l) \
+   LOGGING_LOGGER_ADD_FORMAT(l, "BTRC", LOGGING_FORMAT_INIT_BTRC)
+#  if defined(__linux__)
+    /*
+      Copy the executable mappings of the process to path, for
+      logging-symbolize to turn the addresses into modules and offsets.
+    */
+    LOGGING_FUNC_DEF(
+    int logging_btrc_loadmap(const char *path),
+    {
+        char line[1024];
+        FILE *in = fopen("/proc/self/maps", "r"), *out;
+        if (in == NULL) {
+            return -1;
+        }
+        if ((out = fopen(path, "w")) == NULL) {
+            fclose(in);
+            return -1;
+        }
+        while (fgets(line, sizeof(line), in)) {
+            char perms[8];
+            if (sscanf(line, "%*s %7s", perms) == 1 && perms[2] == 'x') {
+                fputs(line, out);
+            }
+        }
+        fclose(in);
+        return fclose(out) == 0 ? 0 : -1;
+    }
+    )
+#  endif
+# else
+#  define LOGGING_BTRC_BUILTIN(l)
+# endif
+/// Backtrace Symbols
+# if defined(LOGGING_CONF_BTRC_SYMBOLS) \
+    && (defined(LOGGING_LOG_BTRC) || defined(LOGGING_AS_SOURCE))
+#  if !defined(__unix__) && !defined(__APPLE__)
+#   error LOGGING_CONF_BTRC_SYMBOLS needs dladdr
+#  endif
+#  include <dlfcn.h>
+#  if defined(__GLIBC__) && !defined(__USE_GNU)
+    typedef struct // hidden by strict iso
+    {
+        const char *dli_fname;
+        void *dli_fbase;
+        const char *dli_sname;
+        void *dli_saddr;
+    } Dl_info;
+    extern int dladdr(const void *, Dl_info *);
+#  endif
+#  ifndef LOGGING_BTRC_CACHE
+#   define LOGGING_BTRC_CACHE 512 // addresses named, direct mapped
+#  endif
+#  ifndef LOGGING_BTRC_SYMBOL_SIZE
+#   define LOGGING_BTRC_SYMBOL_SIZE 160
+#  endif
+   /* Name pc as "symbol+0xoff (module)", or "module+0xoff" without one. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_BTRC_SYMBOL(void *pc, char *name),
+   {
+       static struct { void *pc; char name[LOGGING_BTRC_SYMBOL_SIZE]; }
+           cache[LOGGING_BTRC_CACHE];
+       static int lock;
+       size_t i = (size_t)(((uintptr_t)pc * 0x9e3779b97f4a7c15ULL) >> 40)
+                % LOGGING_BTRC_CACHE;
+       int unlocked = 0;
+       Dl_info info;
+
+       while (!LOGGING_ATOMIC_CAS(&lock, &unlocked, 1)) {
+           unlocked = 0;
+       }
+       if (cache[i].pc != pc) {
+           if (dladdr(pc, &info) == 0 || info.dli_fname == NULL) {
+               snprintf(cache[i].name, LOGGING_BTRC_SYMBOL_SIZE, "?");
+           }
+           else if (info.dli_sname) {
+               snprintf(cache[i].name, LOGGING_BTRC_SYMBOL_SIZE,
+                        "%s+0x%llx (%s)", info.dli_sname,
+                        (unsigned long long)((char *)pc
+                                             - (char *)info.dli_saddr),
+                        info.dli_fname);
+           }
+           else {
+               snprintf(cache[i].name, LOGGING_BTRC_SYMBOL_SIZE,
+                        "%s+0x%llx", info.dli_fname,
+                        (unsigned long long)((char *)pc
+                                             - (char *)info.dli_fbase));
+           }
+           cache[i].pc = pc;
+       }
+       memcpy(name, cache[i].name, LOGGING_BTRC_SYMBOL_SIZE);
+       LOGGING_ATOMIC_STORE_REL(&lock, 0);
+   }
+   )
+   /*
+     Name the frames of the addresses formatted in r: a line per frame after
+     a text record, a "btrc_symbols" array closing a JSON one.
+   */
+   LOGGING_FUNC_DEF(
+   void LOGGING_BTRC_SYMBOLIZE_AT(log_record_t *r),
+   {
+       static const char mark[] = LOGGING_BTRC_MARK;
+       char name[LOGGING_BTRC_SYMBOL_SIZE * 2 + 8];
+       const char *p = NULL;
+       char *end;
+       void *pcs[LOGGING_BTRC_DEPTH];
+       int n = 0, i, json = LOGGING_BTRC_JSON;
+
+       for (i = 0; i + (int)sizeof(mark) - 1 <= r->message_off; ++i) {
+           if (memcmp(r->message_buf + i, mark, sizeof(mark) - 1) == 0) {
+               p = r->message_buf + i + sizeof(mark) - 3; // at 0x
+               break;
+           }
+       }
+       while (p && n < LOGGING_BTRC_DEPTH && p[0] == '0' && p[1] == 'x') {
+           pcs[n++] = (void *)(uintptr_t)strtoull(p + 2, &end, 16);
+           p = *end == ' ' ? end + 1 : end;
+       }
+       if (n == 0 || r->message_len < 2 || (json
+           && memcmp(r->message_buf + r->message_len - 2, "}\n", 2) != 0)) {
+           return;
+       }
+       r->message_len -= json ? 2 : 0; // reopen the object, "}\n"
+       for (i = 0; i < n; ++i) {
+           int len;
+           LOGGING_BTRC_SYMBOL(pcs[i], name);
+           len = (int)strlen(name);
+           if (json) {
+               len = LOGGING_JSON_ESCAPE(name, len, (int)sizeof(name) - 1);
+               name[len] = '\0';
+           }
+           if (!LOGGING_RECORD_RESERVE(r, r->message_len + len + 64)) {
+               break;
+           }
+           if (json) {
+               len = snprintf(r->message_buf + r->message_len,
+                   r->message_size - r->message_len, "%s\"%s\"",
+                   i ? "," : ",\"btrc_symbols\":[", name);
+           }
+           else {
+               len = snprintf(r->message_buf + r->message_len,
+                   r->message_size - r->message_len, "    #%d 0x%llx %s\n",
+                   i, (unsigned long long)(uintptr_t)pcs[i], name);
+           }
+           r->message_len += len;
+       }
+       if (json) { // room left by the last reserve
+           r->message_len += snprintf(r->message_buf + r->message_len,
+               r->message_size - r->message_len, i ? "]}\n" : "}\n");
+       }
+   }
+   )
+#  define LOGGING_BTRC_SYMBOLIZE(r) do \
+   { \
+       if ((r)->level <= LOGGING_BTRC_LEVEL) { \
+           LOGGING_BTRC_SYMBOLIZE_AT(r); \
+       } \
+   } while (0)
+# else
+#  define LOGGING_BTRC_SYMBOLIZE(r)
+# endif
+
+/******************************************************************************/
+// Logging Color
+/******************************************************************************/
+# define LOGGING_CLEAR_COLOR "\033[0m"
+# if defined(LOGGING_LOG_COLOR)
+#  if defined(__linux) || defined(__CYGWIN__) || defined(__APPLE__)
+#   include <unistd.h>
+#   if defined(__GLIBC__) && !defined(__USE_POSIX)
+     extern int fileno(FILE *); // hidden by strict iso mode
+#   endif
+#   define LOGGING_ISATTY(file) isatty(fileno(file))
+#  elif defined(_WIN32) || defined(_WIN64)
+#   include <windows.h>
+#   include <io.h>
+#   ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#    define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#   endif
+    /*
+      Consoles take the escape sequences once virtual terminal processing is
+      on, which is turned on here for the console of file (windows 10+).
+    */
+    LOGGING_FUNC_DEF(
+    int LOGGING_ISATTY(FILE *file),
+    {
+        HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+        DWORD mode;
+        if (!_isatty(_fileno(file)) || !GetConsoleMode(handle, &mode)) {
+            return 0;
+        }
+        return (mode & ENABLE_VIRTUAL_TERMINAL_PROCESSING)
+            || SetConsoleMode(handle, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+    )
+#  else
+#   error Not support platform
+#  endif
+#  ifndef LOGGING_DEBUG_COLOR
+#   define LOGGING_DEBUG_COLOR "\033[37m"
+#  endif
+#  ifndef LOGGING_INFO_COLOR
+#   define LOGGING_INFO_COLOR "\033[0m"
+#  endif
+#  ifndef LOGGING_WARN_COLOR
+#   define LOGGING_WARN_COLOR "\033[1;33;40m"
+#  endif
+#  ifndef LOGGING_ERROR_COLOR
+#   define LOGGING_ERROR_COLOR "\033[1;31;40m"
+#  endif
+   /*
+     Only the stdio writer is known to write to a FILE *, a custom
+     LOGGING_DIR_WRITE gets no color unless LOGGING_DIR_ISATTY says so.
+   */
+#  ifndef LOGGING_DIR_ISATTY
+#   ifdef LOGGING_DIR_FILE
+#    define LOGGING_DIR_ISATTY(dir) LOGGING_ISATTY((FILE *)(dir))
+#   else
+#    define LOGGING_DIR_ISATTY(dir) 0
+#   endif
+#  endif
+#  ifndef LOGGING_CONF_COLOR_DIRS
+#   define LOGGING_CONF_COLOR_DIRS 4
+#  endif
+   /*
+     Whether a direction is a terminal is asked once, the answer is kept in
+     the low bit of the direction pointer so a cache slot is a single word.
+   */
+   static inline int LOGGING_DIR_COLORED(void *dir)
+   {
+       static uintptr_t cache[LOGGING_CONF_COLOR_DIRS];
+       uintptr_t d = (uintptr_t)dir, c;
+       int tty;
+       for (int i = 0; i < LOGGING_CONF_COLOR_DIRS; ++i) {
+           c = LOGGING_ATOMIC_LOAD(&cache[i]);
+           if (c == 0) {
+               tty = LOGGING_DIR_ISATTY(dir) != 0;
+               LOGGING_ATOMIC_CAS(&cache[i], &c, d | (uintptr_t)tty);
+               return tty;
+           }
+           if ((c & ~(uintptr_t)1) == d) {
+               return (int)(c & 1);
+           }
+       }
+       return LOGGING_DIR_ISATTY(dir) != 0; // cache full
+   }
+   static inline const char *LOGGING_LEVEL_COLOR(int level)
+   {
+       static const char *const color[] = {
+           LOGGING_CLEAR_COLOR,
+           LOGGING_ERROR_COLOR,
+           LOGGING_WARN_COLOR,
+           LOGGING_INFO_COLOR,
+           LOGGING_DEBUG_COLOR,
+       };
+       return color[level];
+   }
+# endif
+
+/******************************************************************************/
+// Logging File Truncate Support
+/******************************************************************************/
+# if defined(LOGGING_FEAT_FILE_TRUNCATE)
+#  ifndef LOGGING_LOG_MAX_SIZE
+#   define LOGGING_LOG_MAX_SIZE 0 // no limit but the configuration file's
+#  endif
+#  if defined(__linux) || defined(__CYGWIN__)
+#   include <sys/types.h>
+#   include <unistd.h>
+#   if defined(__GLIBC__) && !defined(__USE_POSIX)
+     extern int fileno(FILE *); // hidden by strict iso mode
+#   endif
+#   if defined(__GLIBC__) && !defined(__USE_XOPEN2K8)
+     extern int ftruncate(int, off_t);
+#   endif
+#   define LOGGING_FILE_TRUNCATE(file, size) ftruncate(fileno(file), size)
+#  elif defined(_WIN32) || defined(_WIN64)
+#   include <io.h>
+#   define LOGGING_FILE_TRUNCATE(file, size) _chsize(_fileno(file), size)
+#  endif
+#  ifndef LOGGING_LOG_ROLLBACK
+    #define LOGGING_LOG_ROLLBACK(_log_file) \
+    LOGGING_LOG_ROLLBACK_TO(_log_file, LOGGING_LOG_MAX_SIZE)
+    #define LOGGING_LOG_ROLLBACK_TO(_log_file, _max_size) do \
+    { \
+        FILE *log_file = (FILE *)_log_file; \
+        if (log_file != stdout && (_max_size) > 0) { \
+            long org = ftell(log_file); \
+            fseek(log_file, 0L, SEEK_END); \
+            long pos = ftell(log_file); \
+            if (pos > (_max_size)) { \
+                LOGGING_FILE_TRUNCATE(log_file, 0); \
+                fseek(log_file, 0L, SEEK_SET); \
+                LOGGING_INDEX_RESET(log_file); \
+            } \
+            else { \
+                fseek(log_file, org, SEEK_SET); \
+            } \
+        } \
+    } while (0)
+    /*
+      The rollback takes the direction for a FILE *, which a custom writer
+      may not write to: then only a configured file is rolled back.
+    */
+#   if defined(LOGGING_DIR_FILE) || !defined(LOGGING_CONF_RELOAD)
+#    define LOGGING_DIR_ROLLBACK(d, max_size) \
+     LOGGING_LOG_ROLLBACK_TO((d)->dir, max_size)
+#   else
+#    define LOGGING_DIR_ROLLBACK(d, max_size) do \
+     { \
+         if ((d)->write == LOGGING_CONFIG_FWRITE) { \
+             LOGGING_LOG_ROLLBACK_TO((d)->dir, max_size); \
+         } \
+     } while (0)
+#   endif
+#  else
+#   define LOGGING_LOG_ROLLBACK_TO(log_file, max_size) \
+    LOGGING_LOG_ROLLBACK(log_file)
+#   define LOGGING_DIR_ROLLBACK(d, max_size) LOGGING_LOG_ROLLBACK((d)->dir)
+#  endif
+# else
+#  define LOGGING_LOG_ROLLBACK(log_file)
+#  define LOGGING_LOG_ROLLBACK_TO(log_file, max_size)
+#  define LOGGING_DIR_ROLLBACK(d, max_size)
+# endif
+
+/******************************************************************************/
+// Logging Time Index
+/******************************************************************************/
+/*
+  A side file "<log>.idx" next to a log file attached by logging_index_attach:
+  a (time, offset) entry in front of every LOGGING_CONF_INDEX_RECORDS records
+  or LOGGING_CONF_INDEX_BYTES bytes written to it, which logging-seek binary
+  searches to read a time window of a huge log without scanning it. The time
+  is when the record at the offset was written, so the entries are sorted.
+  A rollback truncates the index along with the log.
+*/
+# ifdef LOGGING_CONF_INDEX
+#  if !defined(__unix__) && !defined(__APPLE__)
+#   error LOGGING_CONF_INDEX needs POSIX files
+#  endif
+#  include <sys/types.h>
+#  include <sys/time.h>
+#  include <unistd.h>
+#  if defined(__GLIBC__) && !defined(__USE_POSIX)
+    extern int fileno(FILE *); // hidden by strict iso mode
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_XOPEN2K8)
+    extern int ftruncate(int, off_t);
+#  endif
+#  ifndef LOGGING_CONF_INDEX_RECORDS
+#   define LOGGING_CONF_INDEX_RECORDS 1024
+#  endif
+#  ifndef LOGGING_CONF_INDEX_BYTES
+#   define LOGGING_CONF_INDEX_BYTES (1024*1024)
+#  endif
+#  ifndef LOGGING_CONF_INDEX_FILES
+#   define LOGGING_CONF_INDEX_FILES 4 // log files with an index
+#  endif
+#  define LOGGING_INDEX_MAGIC 0x5844494cu // "LIDX"
+#  define LOGGING_INDEX_VERSION 1
+   typedef struct logging_index_header
+   {
+       uint32_t magic;
+       uint32_t version;
+   } logging_index_header_t;
+   typedef struct logging_index_entry
+   {
+       int64_t time; // us since the epoch
+       uint64_t offset; // of the first record written at time
+   } logging_index_entry_t;
+   typedef struct log_index
+   {
+       FILE *log; // published last, NULL for a free slot
+       FILE *index;
+       int claimed;
+       uint64_t records; // written since the last entry
+       uint64_t bytes;
+   } log_index_t;
+   LOGGING_GLOBAL log_index_t logging_indexes[LOGGING_CONF_INDEX_FILES];
+/// lookup
+   LOGGING_FUNC_DEF(
+   log_index_t *LOGGING_INDEX_FIND(void *dir),
+   {
+       for (int i = 0; i < LOGGING_CONF_INDEX_FILES; ++i) { // holes detached
+           FILE *log = LOGGING_ATOMIC_LOAD_ACQ(&logging_indexes[i].log);
+           if (log && log == (FILE *)dir) {
+               return &logging_indexes[i];
+           }
+       }
+       return NULL;
+   }
+   )
+/// record
+   /* Called before a record of len bytes is written to dir. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_INDEX_RECORD(void *dir, size_t len),
+   {
+       log_index_t *x = LOGGING_INDEX_FIND(dir);
+       logging_index_entry_t e;
+       struct timeval tv;
+       if (x == NULL) {
+           return;
+       }
+       if (x->records >= LOGGING_CONF_INDEX_RECORDS
+           || x->bytes >= LOGGING_CONF_INDEX_BYTES) {
+           fflush(x->log); // the offset of what is on disk
+           gettimeofday(&tv, NULL);
+           e.time = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+           e.offset = (uint64_t)ftell(x->log);
+           fwrite(&e, sizeof(e), 1, x->index);
+           fflush(x->index);
+           x->records = 0;
+           x->bytes = 0;
+       }
+       ++x->records;
+       x->bytes += len;
+   }
+   )
+/// rollback
+   /* The log was truncated to 0, so are its entries. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_INDEX_RESET(void *dir),
+   {
+       log_index_t *x = LOGGING_INDEX_FIND(dir);
+       if (x == NULL) {
+           return;
+       }
+       fflush(x->index);
+       if (ftruncate(fileno(x->index), sizeof(logging_index_header_t)) == 0) {
+           fseek(x->index, 0L, SEEK_END);
+       }
+       x->records = LOGGING_CONF_INDEX_RECORDS; // the next record is indexed
+       x->bytes = 0;
+   }
+   )
+/// attach
+   /*
+     Index log, whose path is path, into "<path>.idx". Entries of an older
+     index past the end of the log are dropped, an empty log starts a new
+     index. Return 0, or -1 if the index can not be opened or all slots
+     (LOGGING_CONF_INDEX_FILES) are taken.
+   */
+   LOGGING_FUNC_DEF(
+   int logging_index_attach(FILE *log, const char *path),
+   {
+       logging_index_header_t h = { LOGGING_INDEX_MAGIC, LOGGING_INDEX_VERSION };
+       logging_index_header_t old;
+       logging_index_entry_t e;
+       log_index_t *x = NULL;
+       char name[512];
+       long size, n;
+       FILE *index;
+
+       if (LOGGING_INDEX_FIND(log)) {
+           return 0;
+       }
+       for (int i = 0; i < LOGGING_CONF_INDEX_FILES && x == NULL; ++i) {
+           int free_slot = 0;
+           if (LOGGING_ATOMIC_CAS(&logging_indexes[i].claimed, &free_slot, 1)) {
+               x = &logging_indexes[i];
+           }
+       }
+       snprintf(name, sizeof(name), "%s.idx", path);
+       if (x == NULL || ((index = fopen(name, "r+b")) == NULL
+                         && (index = fopen(name, "w+b")) == NULL)) {
+           if (x) {
+               LOGGING_ATOMIC_STORE_REL(&x->claimed, 0);
+           }
+           return -1;
+       }
+       fflush(log);
+       fseek(log, 0L, SEEK_END);
+       size = ftell(log);
+       n = 0;
+       if (size > 0 && fread(&old, sizeof(old), 1, index) == 1
+           && old.magic == h.magic && old.version == h.version) {
+           fseek(index, 0L, SEEK_END);
+           n = (ftell(index) - (long)sizeof(h)) / (long)sizeof(e);
+           for (; n > 0; --n) { // drop what points past the log
+               fseek(index, (long)sizeof(h) + (n - 1) * (long)sizeof(e),
+                     SEEK_SET);
+               if (fread(&e, sizeof(e), 1, index) == 1
+                   && e.offset <= (uint64_t)size) {
+                   break;
+               }
+           }
+       }
+       fflush(index);
+       if (ftruncate(fileno(index), (long)sizeof(h) + n * (long)sizeof(e))) {
+           n = 0;
+       }
+       fseek(index, 0L, SEEK_SET);
+       fwrite(&h, sizeof(h), 1, index);
+       fseek(index, 0L, SEEK_END);
+       fflush(index);
+       x->index = index;
+       x->records = LOGGING_CONF_INDEX_RECORDS; // the next record is indexed
+       x->bytes = 0;
+       LOGGING_ATOMIC_STORE_REL(&x->log, log);
+       return 0;
+   }
+   )
+/// detach
+   /* Stop indexing log, before it is closed, and free its slot. */
+   LOGGING_FUNC_DEF(
+   void logging_index_detach(FILE *log),
+   {
+       log_index_t *x = LOGGING_INDEX_FIND(log);
+       if (x == NULL) {
+           return;
+       }
+       LOGGING_ATOMIC_STORE_REL(&x->log, (FILE *)NULL);
+       fclose(x->index);
+       x->index = NULL;
+       LOGGING_ATOMIC_STORE_REL(&x->claimed, 0);
+   }
+   )
+# else
+#  define LOGGING_INDEX_RECORD(dir, len)
+#  define LOGGING_INDEX_RESET(dir)
+# endif
+
+/******************************************************************************/
+// Logging Linger
+/******************************************************************************/
+/*
+  The batching directions hold a batch linger ms for more records, and look
+  at the time when one is written. So that the last batch before a quiet
+  period does not wait for the next record, a sink with a linger registers
+  its due check here, called by one detached thread every smallest linger.
+  The thread buffers register theirs for the buffers of idle threads.
+*/
+# if defined(LOGGING_CONF_SYSLOG) || defined(LOGGING_CONF_DIRECT) \
+    || defined(LOGGING_CONF_URING) || defined(LOGGING_CONF_THREAD_BUFFER)
+#  include <sys/time.h>
+#  include <poll.h>
+#  include <pthread.h>
+   typedef struct log_linger
+   {
+       struct log_linger *next;
+       void *dir;
+       void (*due)(void *dir, int64_t now); // flush a batch older than linger
+   } log_linger_t;
+   LOGGING_GLOBAL log_linger_t *logging_lingers;
+   LOGGING_GLOBAL int logging_linger_tick; // ms, 0 before the ticker
+   LOGGING_FUNC_DEF(
+   void *LOGGING_LINGER_TICKER(void *arg),
+   {
+       struct timeval tv;
+       (void)arg;
+       for (;;) {
+           poll(NULL, 0, LOGGING_ATOMIC_LOAD(&logging_linger_tick));
+           gettimeofday(&tv, NULL);
+           for (log_linger_t *t = LOGGING_ATOMIC_LOAD_ACQ(&logging_lingers);
+                t; t = t->next) {
+               t->due(t->dir, (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000);
+           }
+       }
+       return NULL;
+   }
+   )
+   /* Have t->due called every linger ms or sooner, from now on. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_LINGER_REGISTER(log_linger_t *t, int linger),
+   {
+       int old = LOGGING_ATOMIC_LOAD(&logging_linger_tick);
+       pthread_t tid;
+       t->next = LOGGING_ATOMIC_LOAD(&logging_lingers);
+       while (!LOGGING_ATOMIC_CAS(&logging_lingers, &t->next, t));
+       while ((old == 0 || linger < old)
+              && !LOGGING_ATOMIC_CAS(&logging_linger_tick, &old, linger));
+       if (old == 0 && pthread_create(&tid, NULL, LOGGING_LINGER_TICKER,
+                                      NULL) == 0) {
+           pthread_detach(tid);
+       }
+   }
+   )
+# endif
+
+/******************************************************************************/
+// Logging Syslog
+/******************************************************************************/
+/*
+  A direction sending every record as one datagram to a local AF_UNIX
+  socket, framed as RFC 5424 for syslog or as native journald fields:
+    log_syslog_t app_log = { "/dev/log", "app" };
+    #define LOGGING_LOG_DIRECTION (&app_log)
+    #define LOGGING_DIR_WRITE logging_syslog_write
+  Datagrams are batched and sent with one sendmmsg: records queued behind
+  each other in the LOGGING_LOG_THREAD loop, or written within linger ms of
+  the first one, share a batch. A record at LOGGING_CONF_SYSLOG_FLUSH_LEVEL
+  or above, a full batch, the linger ticker, exit and logging_syslog_flush
+  send it. A socket which went away is reconnected once right away, then at
+  most every LOGGING_CONF_SYSLOG_RETRY ms, the records in between are
+  dropped.
+*/
+# ifdef LOGGING_CONF_SYSLOG
+#  if !defined(__linux)
+#   error LOGGING_CONF_SYSLOG needs AF_UNIX sockets and sendmmsg (linux)
+#  endif
+#  include <sys/types.h>
+#  include <sys/socket.h>
+#  include <sys/time.h>
+#  include <sys/uio.h>
+#  include <sys/un.h>
+#  include <errno.h>
+#  include <sched.h>
+#  include <time.h>
+#  include <unistd.h>
+#  if defined(__GLIBC__) && !defined(__USE_GNU)
+    struct mmsghdr // hidden by strict iso mode
+    {
+        struct msghdr msg_hdr;
+        unsigned int msg_len;
+    };
+    extern int sendmmsg(int, struct mmsghdr *, unsigned int, int);
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_POSIX)
+    extern struct tm *gmtime_r(const time_t *, struct tm *);
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_XOPEN_EXTENDED) \
+      && !defined(__USE_MISC)
+    extern int gethostname(char *, size_t);
+#  endif
+#  ifndef LOGGING_CONF_SYSLOG_BATCH
+#   define LOGGING_CONF_SYSLOG_BATCH 32 // datagrams per sendmmsg
+#  endif
+#  ifndef LOGGING_CONF_SYSLOG_BUFFER
+#   define LOGGING_CONF_SYSLOG_BUFFER (32*1024) // bytes of a batch
+#  endif
+#  ifndef LOGGING_CONF_SYSLOG_RETRY
+#   define LOGGING_CONF_SYSLOG_RETRY 1000
+#  endif
+#  ifndef LOGGING_CONF_SYSLOG_FACILITY
+#   define LOGGING_CONF_SYSLOG_FACILITY 1 // user-level messages
+#  endif
+#  ifndef LOGGING_CONF_SYSLOG_FLUSH_LEVEL
+#   define LOGGING_CONF_SYSLOG_FLUSH_LEVEL LOGGING_ERROR_LEVEL
+#  endif
+   typedef struct log_syslog
+   {
+       const char *path; // "/dev/log", "/run/systemd/journal/socket", ...
+       const char *ident; // APP-NAME or SYSLOG_IDENTIFIER, NULL for comm
+       int journald; // native journald fields instead of RFC 5424
+       int facility; // 0 for LOGGING_CONF_SYSLOG_FACILITY
+       int linger; // ms a batch waits for more records, 0 to send each
+
+       /* zero initialized state */
+       struct log_syslog *next; // sinks flushed at exit
+       log_linger_t ticker; // with a linger
+       int registered;
+       int busy;
+       int fd; // socket + 1, 0 when not connected
+       int count; // datagrams in the batch
+       size_t used; // bytes of the batch
+       int64_t first; // ms when the batch was started
+       int64_t retry; // ms before which no connect is tried
+       uint64_t sent, dropped, connects;
+       char host[64];
+       char name[48];
+       size_t len[LOGGING_CONF_SYSLOG_BATCH];
+       char buf[LOGGING_CONF_SYSLOG_BUFFER];
+   } log_syslog_t;
+   LOGGING_GLOBAL log_syslog_t *logging_syslogs;
+   LOGGING_GLOBAL int logging_syslog_exit; // flush at exit registered
+   LOGGING_FUNC_DCL(void logging_syslog_flush(log_syslog_t *s));
+   LOGGING_FUNC_DCL(void LOGGING_SYSLOG_DUE(void *dir, int64_t now));
+/// connect
+   LOGGING_FUNC_DEF(
+   void LOGGING_SYSLOG_EXIT(void),
+   {
+       log_syslog_t *s = LOGGING_ATOMIC_LOAD_ACQ(&logging_syslogs);
+       for (; s; s = s->next) {
+           logging_syslog_flush(s);
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_SYSLOG_REGISTER(log_syslog_t *s),
+   {
+       FILE *comm = fopen("/proc/self/comm", "r");
+       int none = 0;
+       if (comm) {
+           if (fgets(s->name, sizeof(s->name), comm)) {
+               s->name[strcspn(s->name, "\n")] = '\0';
+           }
+           fclose(comm);
+       }
+       if (gethostname(s->host, sizeof(s->host) - 1) != 0) {
+           s->host[0] = '\0';
+       }
+       s->registered = 1;
+       s->next = LOGGING_ATOMIC_LOAD(&logging_syslogs);
+       while (!LOGGING_ATOMIC_CAS(&logging_syslogs, &s->next, s));
+       if (LOGGING_ATOMIC_CAS(&logging_syslog_exit, &none, 1)) {
+           atexit(LOGGING_SYSLOG_EXIT);
+       }
+       if (s->linger > 0) {
+           s->ticker.dir = s;
+           s->ticker.due = LOGGING_SYSLOG_DUE;
+           LOGGING_LINGER_REGISTER(&s->ticker, s->linger);
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int LOGGING_SYSLOG_CONNECT(log_syslog_t *s, int64_t now),
+   {
+       struct sockaddr_un addr;
+       int fd;
+       if (s->fd > 0) {
+           return 1;
+       }
+       if (now < s->retry) {
+           return 0;
+       }
+       s->retry = now + LOGGING_CONF_SYSLOG_RETRY;
+       memset(&addr, 0, sizeof(addr));
+       addr.sun_family = AF_UNIX;
+       strncpy(addr.sun_path, s->path, sizeof(addr.sun_path) - 1);
+       fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+       if (fd < 0) {
+           return 0;
+       }
+       if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+           close(fd);
+           return 0;
+       }
+       s->fd = fd + 1;
+       ++s->connects;
+       return 1;
+   }
+   )
+/// frame
+   /*
+     The part of a datagram in front of the message, with the message as
+     the final field: "<PRI>1 TIMESTAMP HOST APP PID - - " or journald's
+     PRIORITY=... lines and the length of a binary MESSAGE field.
+   */
+   LOGGING_FUNC_DEF(
+   size_t LOGGING_SYSLOG_HEADER(log_syslog_t *s, char *buf, size_t size,
+       const struct timeval *tv, int level, size_t len),
+   {
+       static const int severity[] = { 7, 3, 4, 6, 7 }; // by LOGGING_*_LEVEL
+       int facility = s->facility ? s->facility : LOGGING_CONF_SYSLOG_FACILITY;
+       const char *ident = s->ident ? s->ident : s->name[0] ? s->name : "-";
+       int sev = severity[level >= 0 && level <= 4 ? level : 0];
+       size_t n;
+       struct tm tm;
+
+       if (s->journald) {
+           n = (size_t)snprintf(buf, size - 8, "PRIORITY=%d\n"
+               "SYSLOG_FACILITY=%d\nSYSLOG_IDENTIFIER=%s\nSYSLOG_PID=%ld\n"
+               "MESSAGE\n", sev, facility, ident, (long)getpid());
+           n = n < size - 8 ? n : size - 9;
+           for (int i = 0; i < 8; ++i) { // little endian 64 bits length
+               buf[n++] = (char)(((uint64_t)len >> (8 * i)) & 0xff);
+           }
+           return n;
+       }
+       gmtime_r(&tv->tv_sec, &tm);
+       n = (size_t)snprintf(buf, size,
+           "<%d>1 %04d-%02d-%02dT%02d:%02d:%02d.%06ldZ %s %s %ld - - ",
+           facility * 8 + sev, tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+           tm.tm_hour, tm.tm_min, tm.tm_sec, (long)tv->tv_usec,
+           s->host[0] ? s->host : "-", ident, (long)getpid());
+       return n < size ? n : size - 1;
+   }
+   )
+/// send
+   /*
+     Send the batch, a vanished or restarted listener gets one reconnect
+     right away. Called with the sink locked.
+   */
+   LOGGING_FUNC_DEF(
+   void LOGGING_SYSLOG_SEND(log_syslog_t *s, int64_t now),
+   {
+       struct mmsghdr msg[LOGGING_CONF_SYSLOG_BATCH];
+       struct iovec iov[LOGGING_CONF_SYSLOG_BATCH];
+       char *p = s->buf;
+       int done = 0, lost = 0, retried = 0, n;
+
+       memset(msg, 0, sizeof(msg[0]) * s->count);
+       for (int i = 0; i < s->count; ++i) {
+           iov[i].iov_base = p;
+           iov[i].iov_len = s->len[i];
+           msg[i].msg_hdr.msg_iov = &iov[i];
+           msg[i].msg_hdr.msg_iovlen = 1;
+           p += s->len[i];
+       }
+       while (done < s->count && LOGGING_SYSLOG_CONNECT(s, now)) {
+           n = sendmmsg(s->fd - 1, msg + done, (unsigned)(s->count - done), 0);
+           if (n > 0) {
+               done += n;
+           }
+           else if (errno == EMSGSIZE) { // too long for the listener
+               ++done;
+               ++lost;
+           }
+           else if (errno != EINTR) {
+               close(s->fd - 1);
+               s->fd = 0;
+               if (retried++) {
+                   break;
+               }
+               s->retry = 0;
+           }
+       }
+       s->sent += done - lost;
+       s->dropped += s->count - done + lost;
+       s->count = 0;
+       s->used = 0;
+   }
+   )
+   /* A datagram too long for a batch goes alone, from where it is. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_SYSLOG_SEND_ONE(log_syslog_t *s, int64_t now,
+       char *head, size_t hl, const char *msg, size_t len),
+   {
+       struct iovec iov[3];
+       struct msghdr m;
+       iov[0].iov_base = head;
+       iov[0].iov_len = hl;
+       iov[1].iov_base = (void *)msg;
+       iov[1].iov_len = len;
+       iov[2].iov_base = (void *)"\n"; // closes journald's binary field
+       iov[2].iov_len = s->journald ? 1 : 0;
+       memset(&m, 0, sizeof(m));
+       m.msg_iov = iov;
+       m.msg_iovlen = 3;
+       if (LOGGING_SYSLOG_CONNECT(s, now) && sendmsg(s->fd - 1, &m, 0) >= 0) {
+           ++s->sent;
+       }
+       else {
+           ++s->dropped;
+       }
+   }
+   )
+/// write
+   LOGGING_FUNC_DEF(
+   void logging_syslog_write(void *dir, const void *data, size_t size),
+   {
+       log_syslog_t *s = (log_syslog_t *)dir;
+       const char *msg = (const char *)data;
+       int level = logging_dir_level, none = 0;
+       char head[256];
+       size_t hl, n;
+       struct timeval tv;
+       int64_t now;
+
+       gettimeofday(&tv, NULL);
+       now = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+       if (size > 0 && msg[size - 1] == '\n') {
+           --size;
+       }
+       while (!LOGGING_ATOMIC_CAS(&s->busy, &none, 1)) {
+           none = 0;
+           sched_yield();
+       }
+       if (!s->registered) {
+           LOGGING_SYSLOG_REGISTER(s);
+       }
+       hl = LOGGING_SYSLOG_HEADER(s, head, sizeof(head), &tv, level, size);
+       n = hl + size + (s->journald ? 1 : 0);
+       if (s->count == LOGGING_CONF_SYSLOG_BATCH
+           || s->used + n > sizeof(s->buf)) {
+           LOGGING_SYSLOG_SEND(s, now);
+       }
+       if (n > sizeof(s->buf)) {
+           LOGGING_SYSLOG_SEND_ONE(s, now, head, hl, msg, size);
+       }
+       else {
+           if (s->count == 0) {
+               s->first = now;
+           }
+           memcpy(s->buf + s->used, head, hl);
+           memcpy(s->buf + s->used + hl, msg, size);
+           if (s->journald) {
+               s->buf[s->used + n - 1] = '\n';
+           }
+           s->len[s->count++] = n;
+           s->used += n;
+           if (!logging_dir_more
+               && (level <= LOGGING_CONF_SYSLOG_FLUSH_LEVEL
+                   || now - s->first >= s->linger)) {
+               LOGGING_SYSLOG_SEND(s, now);
+           }
+       }
+       LOGGING_ATOMIC_STORE_REL(&s->busy, 0);
+   }
+   )
+   /* Send the batch of s if it lingered, unless a writer has s. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_SYSLOG_DUE(void *dir, int64_t now),
+   {
+       log_syslog_t *s = (log_syslog_t *)dir;
+       int none = 0;
+       if (LOGGING_ATOMIC_CAS(&s->busy, &none, 1)) {
+           if (s->count > 0 && now - s->first >= s->linger) {
+               LOGGING_SYSLOG_SEND(s, now);
+           }
+           LOGGING_ATOMIC_STORE_REL(&s->busy, 0);
+       }
+   }
+   )
+   /* Send what is batched in s now. */
+   LOGGING_FUNC_DEF(
+   void logging_syslog_flush(log_syslog_t *s),
+   {
+       struct timeval tv;
+       int none = 0;
+       while (!LOGGING_ATOMIC_CAS(&s->busy, &none, 1)) {
+           none = 0;
+           sched_yield();
+       }
+       if (s->count > 0) {
+           gettimeofday(&tv, NULL);
+           LOGGING_SYSLOG_SEND(s, (int64_t)tv.tv_sec * 1000
+                                  + tv.tv_usec / 1000);
+       }
+       LOGGING_ATOMIC_STORE_REL(&s->busy, 0);
+   }
+   )
+# endif
+
+/******************************************************************************/
+// Logging Direct File
+/******************************************************************************/
+/*
+  A file direction keeping logs out of the page cache:
+    log_direct_t app_log = { "/var/log/app.log" };
+    #define LOGGING_LOG_DIRECTION (&app_log)
+    #define LOGGING_DIR_WRITE logging_direct_write
+  Records are gathered in a block aligned buffer and written as whole
+  LOGGING_CONF_DIRECT_BLOCK blocks through O_DIRECT, to a file fallocated a
+  segment ahead so that appending changes no file size. The last partial
+  block is written zero padded for a record at
+  LOGGING_CONF_DIRECT_FLUSH_LEVEL or above, linger ms after its first record
+  (by the linger ticker if no record comes), at logging_direct_flush and at
+  exit, and is carried over to be written again when it grows. At exit the
+  file is cut where its records end, on open that end is looked for again.
+  A file system rejecting O_DIRECT gets the same blocks through the page
+  cache, one without fallocate gets a file growing by the writes.
+*/
+# ifdef LOGGING_CONF_DIRECT
+#  if !defined(__linux)
+#   error LOGGING_CONF_DIRECT needs O_DIRECT and fallocate (linux)
+#  endif
+#  include <sys/types.h>
+#  include <sys/stat.h>
+#  include <sys/time.h>
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <sched.h>
+#  include <unistd.h>
+#  if !defined(O_DIRECT) && defined(__O_DIRECT)
+#   define O_DIRECT __O_DIRECT // hidden by strict iso mode
+#  endif
+#  if !defined(O_CLOEXEC) && defined(__O_CLOEXEC)
+#   define O_CLOEXEC __O_CLOEXEC
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_GNU)
+    extern int fallocate(int, int, off_t, off_t);
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_XOPEN2K8) \
+      && !defined(__USE_UNIX98)
+    extern ssize_t pread(int, void *, size_t, off_t);
+    extern ssize_t pwrite(int, const void *, size_t, off_t);
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_XOPEN2K)
+    extern int posix_memalign(void **, size_t, size_t);
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_XOPEN2K8)
+    extern int ftruncate(int, off_t);
+#  endif
+#  ifndef LOGGING_CONF_DIRECT_BLOCK
+#   define LOGGING_CONF_DIRECT_BLOCK 4096
+#  endif
+#  ifndef LOGGING_CONF_DIRECT_BUFFER
+#   define LOGGING_CONF_DIRECT_BUFFER (64*1024) // bytes per write
+#  endif
+#  ifndef LOGGING_CONF_DIRECT_SEGMENT
+#   define LOGGING_CONF_DIRECT_SEGMENT (64*1024*1024) // bytes fallocated
+#  endif
+#  ifndef LOGGING_CONF_DIRECT_FLUSH_LEVEL
+#   define LOGGING_CONF_DIRECT_FLUSH_LEVEL LOGGING_ERROR_LEVEL
+#  endif
+#  if LOGGING_CONF_DIRECT_BUFFER % LOGGING_CONF_DIRECT_BLOCK != 0
+#   error LOGGING_CONF_DIRECT_BUFFER must be a multiple of the block size
+#  endif
+   typedef struct log_direct
+   {
+       const char *path;
+       int linger; // ms a partial block waits, 0 to write each record
+       long segment; // 0 for LOGGING_CONF_DIRECT_SEGMENT
+
+       /* zero initialized state */
+       struct log_direct *next; // files cut at exit
+       log_linger_t ticker; // with a linger
+       int opened; // 1, or -1 when the open failed
+       int busy;
+       int fd;
+       int direct; // O_DIRECT is on
+       uint64_t offset; // of buf in the file, block aligned
+       uint64_t allocated; // end of the fallocated part
+       size_t used; // bytes in buf
+       size_t written; // bytes of buf on the file
+       int64_t first; // ms of the oldest record not on the file
+       uint64_t blocks, errors;
+       char *buf; // LOGGING_CONF_DIRECT_BUFFER bytes, block aligned
+   } log_direct_t;
+   LOGGING_GLOBAL log_direct_t *logging_directs;
+   LOGGING_GLOBAL int logging_direct_exit; // cut at exit registered
+#  define LOGGING_DIRECT_LOCK(d) do \
+   { \
+       int _none = 0; \
+       while (!LOGGING_ATOMIC_CAS(&(d)->busy, &_none, 1)) { \
+           _none = 0; \
+           sched_yield(); \
+       } \
+   } while (0)
+#  define LOGGING_DIRECT_UNLOCK(d) LOGGING_ATOMIC_STORE_REL(&(d)->busy, 0)
+   LOGGING_FUNC_DCL(void logging_direct_flush(log_direct_t *d));
+   LOGGING_FUNC_DCL(void LOGGING_DIRECT_DUE(void *dir, int64_t now));
+/// write
+   /* Write the first size bytes of buf at offset, fallocating ahead. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_DIRECT_PWRITE(log_direct_t *d, size_t size),
+   {
+       uint64_t end = d->offset + size;
+       long segment = d->segment > 0 ? d->segment : LOGGING_CONF_DIRECT_SEGMENT;
+       ssize_t n;
+       if (end > d->allocated) {
+           uint64_t want = end - d->allocated > (uint64_t)segment
+                         ? end - d->allocated : (uint64_t)segment;
+           if (fallocate(d->fd, 0, (off_t)d->allocated, (off_t)want) == 0) {
+               d->allocated += want;
+           }
+           else {
+               d->allocated = UINT64_MAX; // unsupported, grow by writes
+           }
+       }
+       n = pwrite(d->fd, d->buf, size, (off_t)d->offset);
+       if (n < 0 && errno == EINVAL && d->direct) { // rejected by the fs
+           fcntl(d->fd, F_SETFL, fcntl(d->fd, F_GETFL) & ~O_DIRECT);
+           d->direct = 0;
+           n = pwrite(d->fd, d->buf, size, (off_t)d->offset);
+       }
+       if (n == (ssize_t)size) {
+           d->blocks += size / LOGGING_CONF_DIRECT_BLOCK;
+       }
+       else {
+           ++d->errors;
+       }
+   }
+   )
+   /* Write the unwritten part of buf, keep its partial block. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_DIRECT_FLUSH(log_direct_t *d),
+   {
+       size_t full = d->used / LOGGING_CONF_DIRECT_BLOCK
+                   * LOGGING_CONF_DIRECT_BLOCK;
+       size_t padded = full < d->used ? full + LOGGING_CONF_DIRECT_BLOCK : full;
+       if (d->used == d->written) {
+           return;
+       }
+       memset(d->buf + d->used, 0, padded - d->used);
+       LOGGING_DIRECT_PWRITE(d, padded);
+       memmove(d->buf, d->buf + full, d->used - full);
+       d->offset += full;
+       d->used -= full;
+       d->written = d->used;
+   }
+   )
+/// open
+   LOGGING_FUNC_DEF(
+   void LOGGING_DIRECT_EXIT(void),
+   {
+       log_direct_t *d = LOGGING_ATOMIC_LOAD_ACQ(&logging_directs);
+       for (; d; d = d->next) {
+           LOGGING_DIRECT_LOCK(d);
+           LOGGING_DIRECT_FLUSH(d);
+           if (ftruncate(d->fd, (off_t)(d->offset + d->used)) == 0) {
+               d->allocated = d->offset + d->used;
+           }
+           LOGGING_DIRECT_UNLOCK(d);
+       }
+   }
+   )
+   /*
+     Open the file, and continue it where its records end: the rest of the
+     file is fallocated zeros, or padding of the last block.
+   */
+   LOGGING_FUNC_DEF(
+   int LOGGING_DIRECT_OPEN(log_direct_t *d),
+   {
+       struct stat st;
+       uint64_t end;
+       void *buf;
+       int none = 0;
+       d->opened = -1;
+       if (posix_memalign(&buf, LOGGING_CONF_DIRECT_BLOCK,
+                          LOGGING_CONF_DIRECT_BUFFER) != 0) {
+           return 0;
+       }
+       d->buf = (char *)buf;
+       d->direct = 1;
+       d->fd = open(d->path, O_RDWR | O_CREAT | O_CLOEXEC | O_DIRECT, 0644);
+       if (d->fd < 0 && errno == EINVAL) {
+           d->direct = 0;
+           d->fd = open(d->path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+       }
+       if (d->fd < 0 || fstat(d->fd, &st) != 0) {
+           return 0;
+       }
+       d->allocated = (uint64_t)st.st_size;
+       end = (d->allocated + LOGGING_CONF_DIRECT_BLOCK - 1)
+           / LOGGING_CONF_DIRECT_BLOCK * LOGGING_CONF_DIRECT_BLOCK;
+       while (end > 0) { // back over zeros, a buffer at a time
+           uint64_t from = end > LOGGING_CONF_DIRECT_BUFFER
+                         ? end - LOGGING_CONF_DIRECT_BUFFER : 0;
+           ssize_t n = pread(d->fd, d->buf, (size_t)(end - from), (off_t)from);
+           if (n < 0 && errno == EINVAL && d->direct) {
+               fcntl(d->fd, F_SETFL, fcntl(d->fd, F_GETFL) & ~O_DIRECT);
+               d->direct = 0;
+               continue;
+           }
+           if (n < 0) { // rather than write over what could not be read
+               close(d->fd);
+               return 0;
+           }
+           while (n > 0 && d->buf[n - 1] == '\0') {
+               --n;
+           }
+           if (n > 0) {
+               end = from + (uint64_t)n;
+               d->offset = end / LOGGING_CONF_DIRECT_BLOCK
+                         * LOGGING_CONF_DIRECT_BLOCK;
+               memmove(d->buf, d->buf + (d->offset - from), end - d->offset);
+               break;
+           }
+           end = from;
+       }
+       d->used = d->written = end > 0 ? (size_t)(end - d->offset) : 0;
+       d->opened = 1;
+       d->next = LOGGING_ATOMIC_LOAD(&logging_directs);
+       while (!LOGGING_ATOMIC_CAS(&logging_directs, &d->next, d));
+       if (LOGGING_ATOMIC_CAS(&logging_direct_exit, &none, 1)) {
+           atexit(LOGGING_DIRECT_EXIT);
+       }
+       if (d->linger > 0) {
+           d->ticker.dir = d;
+           d->ticker.due = LOGGING_DIRECT_DUE;
+           LOGGING_LINGER_REGISTER(&d->ticker, d->linger);
+       }
+       return 1;
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void logging_direct_write(void *dir, const void *data, size_t size),
+   {
+       log_direct_t *d = (log_direct_t *)dir;
+       const char *p = (const char *)data;
+       struct timeval tv;
+       int64_t now;
+
+       gettimeofday(&tv, NULL);
+       now = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+       LOGGING_DIRECT_LOCK(d);
+       if (d->opened == 0) {
+           LOGGING_DIRECT_OPEN(d);
+       }
+       if (d->opened < 0) {
+           ++d->errors;
+           LOGGING_DIRECT_UNLOCK(d);
+           return;
+       }
+       if (d->used == d->written) {
+           d->first = now;
+       }
+       while (size > 0) {
+           size_t n = LOGGING_CONF_DIRECT_BUFFER - d->used;
+           n = n < size ? n : size;
+           memcpy(d->buf + d->used, p, n);
+           d->used += n;
+           p += n;
+           size -= n;
+           if (d->used == LOGGING_CONF_DIRECT_BUFFER) {
+               LOGGING_DIRECT_PWRITE(d, LOGGING_CONF_DIRECT_BUFFER);
+               d->offset += LOGGING_CONF_DIRECT_BUFFER;
+               d->used = d->written = 0;
+           }
+       }
+       if (!logging_dir_more
+           && (logging_dir_level <= LOGGING_CONF_DIRECT_FLUSH_LEVEL
+               || now - d->first >= d->linger)) {
+           LOGGING_DIRECT_FLUSH(d);
+       }
+       LOGGING_DIRECT_UNLOCK(d);
+   }
+   )
+   /* Write the partial block of d if it lingered, unless a writer has d. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_DIRECT_DUE(void *dir, int64_t now),
+   {
+       log_direct_t *d = (log_direct_t *)dir;
+       int none = 0;
+       if (LOGGING_ATOMIC_CAS(&d->busy, &none, 1)) {
+           if (d->used != d->written && now - d->first >= d->linger) {
+               LOGGING_DIRECT_FLUSH(d);
+           }
+           LOGGING_DIRECT_UNLOCK(d);
+       }
+   }
+   )
+   /* Write the partial block of d now. */
+   LOGGING_FUNC_DEF(
+   void logging_direct_flush(log_direct_t *d),
+   {
+       LOGGING_DIRECT_LOCK(d);
+       if (d->opened > 0) {
+           LOGGING_DIRECT_FLUSH(d);
+       }
+       LOGGING_DIRECT_UNLOCK(d);
+   }
+   )
+# endif
+
+/******************************************************************************/
+// Logging io_uring File
+/******************************************************************************/
+/*
+  A file direction for which the writer does not wait for the disk:
+    log_uring_t app_log = { "/var/log/app.log" };
+    #define LOGGING_LOG_DIRECTION (&app_log)
+    #define LOGGING_DIR_WRITE logging_uring_write
+  Records are appended to one of LOGGING_CONF_URING_BUFFERS buffers
+  registered with an io_uring. A buffer is submitted as one write at its
+  place in the file when it is full, for a record at
+  LOGGING_CONF_URING_FLUSH_LEVEL or above once the LOGGING_LOG_THREAD loop
+  has no more records queued behind, and linger ms after its first record
+  (by the linger ticker if no record comes). All the buffers may be in
+  flight at once, and a buffer is filled again once its write completed:
+  the writer only waits when the disk is behind by all of them. Without
+  io_uring (an old kernel, a seccomp filter), the submitted buffers are
+  written in order by a pwrite thread.
+*/
+# ifdef LOGGING_CONF_URING
+#  if !defined(__linux)
+#   error LOGGING_CONF_URING needs io_uring (linux)
+#  endif
+#  include <sys/types.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <sys/syscall.h>
+#  include <sys/time.h>
+#  include <sys/uio.h>
+#  include <linux/io_uring.h>
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <pthread.h>
+#  include <sched.h>
+#  include <unistd.h>
+#  if !defined(O_CLOEXEC) && defined(__O_CLOEXEC)
+#   define O_CLOEXEC __O_CLOEXEC // hidden by strict iso mode
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_MISC)
+    extern long syscall(long, ...);
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_XOPEN2K8) \
+      && !defined(__USE_UNIX98)
+    extern ssize_t pwrite(int, const void *, size_t, off_t);
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_XOPEN2K)
+    extern int posix_memalign(void **, size_t, size_t);
+#  endif
+#  ifndef LOGGING_CONF_URING_BUFFERS
+#   define LOGGING_CONF_URING_BUFFERS 8 // writes in flight at most
+#  endif
+#  ifndef LOGGING_CONF_URING_BUFFER
+#   define LOGGING_CONF_URING_BUFFER (64*1024) // bytes per write
+#  endif
+#  ifndef LOGGING_CONF_URING_FLUSH_LEVEL
+#   define LOGGING_CONF_URING_FLUSH_LEVEL LOGGING_ERROR_LEVEL
+#  endif
+   typedef struct log_uring
+   {
+       const char *path;
+       int linger; // ms a buffer waits for more records, 0 to submit each
+
+       /* zero initialized state */
+       struct log_uring *next; // files drained at exit
+       log_linger_t ticker; // with a linger
+       int opened; // 1, or -1 when the open failed
+       int busy;
+       int fd;
+       int ring; // io_uring fd + 1, 0 for the pwrite thread
+       int current; // buffer being filled
+       size_t used; // bytes in it
+       int64_t first; // ms of its first record
+       uint64_t offset; // in the file of the next buffer submitted
+       int inflight[LOGGING_CONF_URING_BUFFERS];
+       size_t len[LOGGING_CONF_URING_BUFFERS];
+       uint64_t at[LOGGING_CONF_URING_BUFFERS];
+       unsigned unsubmitted; // queued in the ring, not taken by the kernel
+       uint64_t writes, bytes, waits, errors;
+       char *buf; // the buffers, page aligned
+       /* the ring */
+       unsigned *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+       struct io_uring_sqe *sqes;
+       struct io_uring_cqe *cqes;
+       /* the pwrite thread */
+       pthread_mutex_t lock;
+       pthread_cond_t cond;
+       unsigned queued, done; // buffers submitted, written
+       int order[LOGGING_CONF_URING_BUFFERS]; // of the submitted buffers
+   } log_uring_t;
+   LOGGING_GLOBAL log_uring_t *logging_urings;
+   LOGGING_GLOBAL int logging_uring_exit; // drain at exit registered
+#  define LOGGING_URING_LOCK(u) do \
+   { \
+       int _none = 0; \
+       while (!LOGGING_ATOMIC_CAS(&(u)->busy, &_none, 1)) { \
+           _none = 0; \
+           sched_yield(); \
+       } \
+   } while (0)
+#  define LOGGING_URING_UNLOCK(u) LOGGING_ATOMIC_STORE_REL(&(u)->busy, 0)
+#  define LOGGING_URING_BUF(u, i) ((u)->buf + (size_t)(i) \
+                                   * LOGGING_CONF_URING_BUFFER)
+   LOGGING_FUNC_DCL(void logging_uring_flush(log_uring_t *u));
+   LOGGING_FUNC_DCL(void LOGGING_URING_DUE(void *dir, int64_t now));
+/// ring
+   /* Write what the kernel left of buffer i, or all of it, by pwrite. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_URING_PWRITE(log_uring_t *u, int i, size_t from),
+   {
+       while (from < u->len[i]) {
+           ssize_t n = pwrite(u->fd, LOGGING_URING_BUF(u, i) + from,
+                              u->len[i] - from, (off_t)(u->at[i] + from));
+           if (n <= 0 && errno != EINTR) {
+               LOGGING_ATOMIC_ADD(&u->errors, 1);
+               break;
+           }
+           from += n > 0 ? (size_t)n : 0;
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int LOGGING_URING_SETUP(log_uring_t *u),
+   {
+       struct io_uring_params p;
+       struct iovec iov[LOGGING_CONF_URING_BUFFERS];
+       size_t sq_size, cq_size;
+       char *sq, *cq;
+       void *sqes;
+       int fd;
+
+       memset(&p, 0, sizeof(p));
+       fd = (int)syscall(__NR_io_uring_setup, LOGGING_CONF_URING_BUFFERS, &p);
+       if (fd < 0) {
+           return 0;
+       }
+       sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+       cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+       if (p.features & IORING_FEAT_SINGLE_MMAP) {
+           sq_size = cq_size = sq_size > cq_size ? sq_size : cq_size;
+       }
+       sq = (char *)mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd, IORING_OFF_SQ_RING);
+       cq = p.features & IORING_FEAT_SINGLE_MMAP ? sq
+          : (char *)mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd, IORING_OFF_CQ_RING);
+       sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                   PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQES);
+       for (int i = 0; i < LOGGING_CONF_URING_BUFFERS; ++i) {
+           iov[i].iov_base = LOGGING_URING_BUF(u, i);
+           iov[i].iov_len = LOGGING_CONF_URING_BUFFER;
+       }
+       if (sq == MAP_FAILED || cq == MAP_FAILED || sqes == MAP_FAILED
+           || syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS,
+                      iov, LOGGING_CONF_URING_BUFFERS) != 0) {
+           close(fd); // the mappings are kept, a few pages
+           return 0;
+       }
+       u->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+       u->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+       u->sq_array = (unsigned *)(sq + p.sq_off.array);
+       u->cq_head = (unsigned *)(cq + p.cq_off.head);
+       u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+       u->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+       u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+       u->sqes = (struct io_uring_sqe *)sqes;
+       u->ring = fd + 1;
+       return 1;
+   }
+   )
+   /* Take the completed writes, waiting for one if wait. */
+   LOGGING_FUNC_DEF(
+   int LOGGING_URING_REAP(log_uring_t *u, int wait),
+   {
+       unsigned head, tail;
+       long n = syscall(__NR_io_uring_enter, u->ring - 1, u->unsubmitted,
+                        wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0,
+                        NULL, 0);
+       if (n > 0) {
+           u->unsubmitted -= (unsigned)n;
+       }
+       head = *u->cq_head;
+       tail = LOGGING_ATOMIC_LOAD_ACQ(u->cq_tail);
+       for (; head != tail; ++head) {
+           struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+           int i = (int)cqe->user_data;
+           if (cqe->res < 0) { // e.g. a file system without async writes
+               LOGGING_URING_PWRITE(u, i, 0);
+           }
+           else if ((size_t)cqe->res < u->len[i]) {
+               LOGGING_URING_PWRITE(u, i, (size_t)cqe->res);
+           }
+           u->inflight[i] = 0;
+       }
+       LOGGING_ATOMIC_STORE_REL(u->cq_head, head);
+       return n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY
+            ? -1 : 0;
+   }
+   )
+/// pwrite thread
+   LOGGING_FUNC_DEF(
+   void *LOGGING_URING_THREAD(void *arg),
+   {
+       log_uring_t *u = (log_uring_t *)arg;
+       pthread_mutex_lock(&u->lock);
+       for (;;) {
+           int i;
+           while (u->done == u->queued) {
+               pthread_cond_wait(&u->cond, &u->lock);
+           }
+           i = u->order[u->done % LOGGING_CONF_URING_BUFFERS];
+           pthread_mutex_unlock(&u->lock);
+           LOGGING_URING_PWRITE(u, i, 0);
+           pthread_mutex_lock(&u->lock);
+           ++u->done;
+           u->inflight[i] = 0;
+           pthread_cond_broadcast(&u->cond);
+       }
+       return NULL;
+   }
+   )
+/// submit
+   /* Wait until buffer i is not in flight. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_URING_WAIT(log_uring_t *u, int i),
+   {
+       if (u->ring) {
+           if (u->inflight[i]) {
+               LOGGING_URING_REAP(u, 0);
+           }
+           while (u->inflight[i]) {
+               ++u->waits;
+               if (LOGGING_URING_REAP(u, 1) < 0) { // the same bytes again
+                   LOGGING_URING_PWRITE(u, i, 0);
+                   u->inflight[i] = 0;
+               }
+           }
+           return;
+       }
+       pthread_mutex_lock(&u->lock);
+       if (u->inflight[i]) {
+           ++u->waits;
+       }
+       while (u->inflight[i]) {
+           pthread_cond_wait(&u->cond, &u->lock);
+       }
+       pthread_mutex_unlock(&u->lock);
+   }
+   )
+   /* Submit the current buffer and move to the next one. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_URING_SUBMIT(log_uring_t *u),
+   {
+       int i = u->current;
+       if (u->used == 0) {
+           return;
+       }
+       u->len[i] = u->used;
+       u->at[i] = u->offset;
+       u->offset += u->used;
+       u->inflight[i] = 1;
+       ++u->writes;
+       u->bytes += u->used;
+       if (u->ring) {
+           unsigned tail = *u->sq_tail, index = tail & *u->sq_mask;
+           struct io_uring_sqe *sqe = &u->sqes[index];
+           memset(sqe, 0, sizeof(*sqe));
+           sqe->opcode = IORING_OP_WRITE_FIXED;
+           sqe->fd = u->fd;
+           sqe->addr = (uint64_t)(uintptr_t)LOGGING_URING_BUF(u, i);
+           sqe->len = (unsigned)u->used;
+           sqe->off = u->at[i];
+           sqe->buf_index = (uint16_t)i;
+           sqe->user_data = (uint64_t)i;
+           u->sq_array[index] = index;
+           LOGGING_ATOMIC_STORE_REL(u->sq_tail, tail + 1);
+           ++u->unsubmitted;
+           LOGGING_URING_REAP(u, 0);
+       }
+       else {
+           pthread_mutex_lock(&u->lock);
+           u->order[u->queued++ % LOGGING_CONF_URING_BUFFERS] = i;
+           pthread_cond_broadcast(&u->cond);
+           pthread_mutex_unlock(&u->lock);
+       }
+       u->current = (i + 1) % LOGGING_CONF_URING_BUFFERS;
+       u->used = 0;
+       LOGGING_URING_WAIT(u, u->current);
+   }
+   )
+/// open
+   LOGGING_FUNC_DEF(
+   void LOGGING_URING_EXIT(void),
+   {
+       log_uring_t *u = LOGGING_ATOMIC_LOAD_ACQ(&logging_urings);
+       for (; u; u = u->next) {
+           logging_uring_flush(u);
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int LOGGING_URING_OPEN(log_uring_t *u),
+   {
+       struct stat st;
+       void *buf;
+       pthread_t tid;
+       int none = 0;
+       u->opened = -1;
+       if (posix_memalign(&buf, 4096, (size_t)LOGGING_CONF_URING_BUFFERS
+                          * LOGGING_CONF_URING_BUFFER) != 0) {
+           return 0;
+       }
+       u->buf = (char *)buf;
+       u->fd = open(u->path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+       if (u->fd < 0 || fstat(u->fd, &st) != 0) {
+           return 0;
+       }
+       u->offset = (uint64_t)st.st_size;
+       if (!LOGGING_URING_SETUP(u)) {
+           pthread_mutex_init(&u->lock, NULL);
+           pthread_cond_init(&u->cond, NULL);
+           if (pthread_create(&tid, NULL, LOGGING_URING_THREAD, u) != 0) {
+               return 0;
+           }
+           pthread_detach(tid);
+       }
+       u->opened = 1;
+       u->next = LOGGING_ATOMIC_LOAD(&logging_urings);
+       while (!LOGGING_ATOMIC_CAS(&logging_urings, &u->next, u));
+       if (LOGGING_ATOMIC_CAS(&logging_uring_exit, &none, 1)) {
+           atexit(LOGGING_URING_EXIT);
+       }
+       if (u->linger > 0) {
+           u->ticker.dir = u;
+           u->ticker.due = LOGGING_URING_DUE;
+           LOGGING_LINGER_REGISTER(&u->ticker, u->linger);
+       }
+       return 1;
+   }
+   )
+/// write
+   LOGGING_FUNC_DEF(
+   void logging_uring_write(void *dir, const void *data, size_t size),
+   {
+       log_uring_t *u = (log_uring_t *)dir;
+       const char *p = (const char *)data;
+       struct timeval tv;
+       int64_t now;
+
+       gettimeofday(&tv, NULL);
+       now = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+       LOGGING_URING_LOCK(u);
+       if (u->opened == 0) {
+           LOGGING_URING_OPEN(u);
+       }
+       if (u->opened < 0) {
+           ++u->errors;
+           LOGGING_URING_UNLOCK(u);
+           return;
+       }
+       if (u->used == 0) {
+           u->first = now;
+       }
+       while (size > 0) {
+           size_t n = LOGGING_CONF_URING_BUFFER - u->used;
+           n = n < size ? n : size;
+           memcpy(LOGGING_URING_BUF(u, u->current) + u->used, p, n);
+           u->used += n;
+           p += n;
+           size -= n;
+           if (u->used == LOGGING_CONF_URING_BUFFER) {
+               LOGGING_URING_SUBMIT(u);
+               u->first = now;
+           }
+       }
+       if (!logging_dir_more
+           && (logging_dir_level <= LOGGING_CONF_URING_FLUSH_LEVEL
+               || now - u->first >= u->linger)) {
+           LOGGING_URING_SUBMIT(u);
+       }
+       LOGGING_URING_UNLOCK(u);
+   }
+   )
+   /* Submit the buffer of u if it lingered, unless a writer has u. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_URING_DUE(void *dir, int64_t now),
+   {
+       log_uring_t *u = (log_uring_t *)dir;
+       int none = 0;
+       if (LOGGING_ATOMIC_CAS(&u->busy, &none, 1)) {
+           if (u->used > 0 && now - u->first >= u->linger) {
+               LOGGING_URING_SUBMIT(u);
+           }
+           LOGGING_URING_UNLOCK(u);
+       }
+   }
+   )
+   /* Submit what is buffered in u, and wait until all is written. */
+   LOGGING_FUNC_DEF(
+   void logging_uring_flush(log_uring_t *u),
+   {
+       LOGGING_URING_LOCK(u);
+       if (u->opened > 0) {
+           LOGGING_URING_SUBMIT(u);
+           for (int i = 0; i < LOGGING_CONF_URING_BUFFERS; ++i) {
+               LOGGING_URING_WAIT(u, i);
+           }
+       }
+       LOGGING_URING_UNLOCK(u);
+   }
+   )
+# endif
+
+/******************************************************************************/
+// Dynamic Logging Format
+/******************************************************************************/
+/// Format Config String
+# ifndef LOGGING_CONF_DYNAMIC_LOG_FORMAT
+#  define LOGGING_GET_FORMAT_CONF_STR(x)
+# else
+#  ifdef LOGGING_LOG_MODULE
+#   define LOGGING_GET_MODULE_FORMAT_CONF_STR(pstr) do \
+    { \
+        *(pstr) = getenv(LOGGING_LOG_MODULE "_LOGGING_LOG_FORMAT"); \
+        LOGGING_PRINTF("%s module format conf str: %p\n", \
+                       LOGGING_LOG_MODULE, *(pstr)); \
+    } while (0)
+
+#  else
+#   define LOGGING_GET_MODULE_FORMAT_CONF_STR(pstr)
+#  endif
+#  define LOGGING_GET_FORMAT_CONF_STR(pstr) do \
+   { \
+       LOGGING_GET_MODULE_FORMAT_CONF_STR(pstr); \
+       if (*(pstr) != NULL) break; \
+       *(pstr) = getenv("LOGGING_LOG_FORMAT"); \
+       LOGGING_PRINTF("format conf str: %p\n", *(pstr)); \
+   } while (0)
+# endif
+
+/// Static Format Config
+LOGGING_FUNC_DEF(
+void LOGGING_INIT_FORMAT_STATIC(struct log_record *r, struct log_logger *l),
+{
+    LOGGING_PRINTF("logger format count: %d\n", l->format_count);
+    for (int i = 0; i < l->format_count; ++i) {
+        LOGGING_PRINTF("%s format init\n", l->formats[i].name);
+        l->formats[i].init(r, l);
+    }
+}
+)
+/// Dynamic Format Config
+LOGGING_FUNC_DCL(log_format_init_t
+    LOGGING_LOGGER_GET_FORMAT(struct log_logger *l, const char *name))
+LOGGING_FUNC_DEF(
+void LOGGING_INIT_FORMAT_DYNAMIC(struct log_record *r, struct log_logger *l),
+{
+    const char *fname = l->format_conf;
+    LOGGING_CONFIG_FORMAT(r, fname);
+    if (fname == NULL) {
+        LOGGING_INIT_FORMAT_STATIC(r, l);
+        return;
+    }
+    LOGGING_PRINTF("FORMAT_CONF_STR: %s\n", fname);
+
+    log_format_init_t init;
+    while (fname && strlen(fname) >= 4) {
+        init = LOGGING_LOGGER_GET_FORMAT(l, fname);
+        if (init) {
+            init(r, l);
+        }
+        fname = strpbrk(fname, " ");
+        fname = fname != NULL ? fname+1 : fname;
+    }
+}
+)
+
+/// Interface
+# ifdef LOGGING_CONF_DYNAMIC_LOG_FORMAT
+#  define LOGGING_INIT_FORMAT LOGGING_INIT_FORMAT_DYNAMIC
+# else
+#  define LOGGING_INIT_FORMAT LOGGING_INIT_FORMAT_STATIC
+# endif
+
+/******************************************************************************/
+// Logging Logger Functions
+/******************************************************************************/
+/// logger_get_caller_context
+# ifdef LOGGING_LOG_LEVELFLAG
+#  define LOGGING_LOGGER_GET_LEVELFLAG(l) do \
+   { \
+     const char *lvl_flag[] = { \
+         "", LOGGING_ERROR_FLAG, LOGGING_WARN_FLAG, \
+         LOGGING_INFO_FLAG, LOGGING_DEBUG_FLAG, \
+     }; \
+     (l)->levelflag = lvl_flag[(l)->level]; \
+   } while (0)
+# else
+#  define LOGGING_LOGGER_GET_LEVELFLAG(l) (l)->levelflag = NULL;
+# endif
+# ifdef LOGGING_LOG_MODULE
+#  define LOGGING_LOGGER_GET_MODULE(l) (l)->name = LOGGING_LOG_MODULE;
+# else
+#  define LOGGING_LOGGER_GET_MODULE(l) (l)->name = NULL;
+# endif
+# define LOGGING_LOGGER_GET_CALLER_CONTEXT(l) do \
+  { \
+    LOGGING_LOGGER_GET_MODULE(l); \
+    LOGGING_LOGGER_GET_LEVELFLAG(l); \
+    (l)->fileline = __FILE__ "(" LOGGING_STR(__LINE__) ")"; \
+    (l)->function = __FUNCTION__; \
+    (l)->flie = __FILE__; \
+    (l)->line = __LINE__; \
+  } while (0)
+/// logger_add_format
+LOGGING_FUNC_DEF(
+int LOGGING_LOGGER_ADD_FORMAT(struct log_logger *l,
+                               const char *name, log_format_init_t init),
+{
+    if (l->format_count < LOGGING_LOG_LOGGER_FORMAT_COUNT) {
+        l->formats[l->format_count].name = name;
+        l->formats[l->format_count].init = init;
+        l->format_count += 1;
+        LOGGING_PRINTF("logger add format: %s, %p\n", name, init);
+        return !0;
+    }
+    return 0;
+}
+)
+/// logger_get_format
+LOGGING_FUNC_DEF(
+log_format_init_t LOGGING_LOGGER_GET_FORMAT(struct log_logger *l,
+                                            const char *name),
+{
+    for (int i = 0; i < l->format_count; ++i) {
+        if (*(uint32_t *)name == *(uint32_t *)(l->formats[i].name)) {
+            LOGGING_PRINTF("%s init found\n", l->formats[i].name);
+            return l->formats[i].init;
+        }
+    }
+    return NULL;
+}
+)
+/// logger_add_builtin_format
+/*
+  This should be a macro function so that we can add builtin according to user
+  configuration.
+*/
+# define LOGGING_LOGGER_ADD_BUILTIN_FORMAT(l) do \
+{ \
+    LOGGING_LEVELFLAG_BUILTIN(l); \
+    LOGGING_DATETIME_BUILTIN(l); \
+    LOGGING_TIME_BUILTIN(l); \
+    LOGGING_MONOTIME_BUILTIN(l); \
+    LOGGING_SEQN_BUILTIN(l); \
+    LOGGING_PROCID_BUILTIN(l); \
+    LOGGING_THRDID_BUILTIN(l); \
+    LOGGING_MODULE_BUILTIN(l); \
+    LOGGING_FILELINE_BUILTIN(l); \
+    LOGGING_FUNCTION_BUILTIN(l); \
+    LOGGING_BTRC_BUILTIN(l); \
+} while (0)
+
+/// logger_add_custom_format
+# ifdef LOGGING_CONF_DYNAMIC_LOG_FORMAT
+#  ifdef LOGGING_LOGGER_ADD_CUSTOM_FORMAT_AS_FUNCTION
+    extern void LOGGING_LOGGER_ADD_CUSTOM_FORMAT(log_logger_t *l);
+#  elif !defined(LOGGING_LOGGER_ADD_CUSTOM_FORMAT)
+#   define LOGGING_LOGGER_ADD_CUSTOM_FORMAT(l)
+#  endif
+# else
+#  define LOGGING_LOGGER_ADD_CUSTOM_FORMAT(l)
+# endif
+/// init_logger
+# define LOGGING_INIT_LOGGER(l, LEVEL) do \
+  { \
+      memset(l, 0, sizeof(struct log_logger)); \
+      (l)->level = LEVEL; \
+      LOGGING_LOGGER_GET_CALLER_CONTEXT(l); \
+      LOGGING_LOGGER_ADD_BUILTIN_FORMAT(l); \
+      LOGGING_LOGGER_ADD_CUSTOM_FORMAT(l); \
+      LOGGING_GET_FORMAT_CONF_STR(&l->format_conf); \
+  } while (0)
+
+/******************************************************************************/
+// Logging Format Builder
+/******************************************************************************/
+# if defined(LOGGING_FEAT_WITH_FORMAT)
+/// get_format
+#  ifdef LOGGING_EVIL_MODE
+    LOGGING_FUNC_DEF(
+    void LOGGING_GET_FORMAT(log_record_t *r, log_format_data_t fs[], int *fl),
+    {
+        log_format_t *fmt = (r)->fmt;
+        int i = 0;
+        while (fmt) {
+            LOGGING_PRINTF("format %p ", fmt);
+            LOGGING_PRINTF("add %s\n", fmt->name);
+            fs[i].format = fmt->format; fs[i].data = (void *)fmt; i++;
+            fmt = fmt->next;
+        }
+        *(fl) = i;
+    }
+    )
+#  else
+    LOGGING_FUNC_DEF(
+    void LOGGING_GET_FORMAT(log_record_t *r, log_format_data_t fs[], int *fl),
+    {
+        log_format_t *fmt = r->fmt;
+        log_format_format_t *fmters = (log_format_format_t *)fmt;
+        for (int i = 0; i < fmt->count; ++i) {
+            fs[i].format = fmters[-1-i]; fs[i].data = (void *)r->fmt;
+            LOGGING_PRINTF("format: %p\n", fs[i]);
+        }
+        *(fl) = fmt->count;
+    }
+    )
+#  endif
+/// build_format
+#  ifndef LOGGING_LOG_JSON
+#   define FORMAT_SPACE " "
+#   define FORMAT_COLON ":" FORMAT_SPACE
+#   define LOGGING_LOG_SEPERATOR_FMT "%s"
+#   define LOGGING_LOG_SEPERATOR_VAL(r) , ((log_record_t *)(r))->seperator
+#   define LOGGING_FORMAT_OPEN(r) 0
+#   define LOGGING_FORMAT_SEPERATOR_ALWAYS 0
+#  else
+#   define FORMAT_SPACE ","
+#   define FORMAT_COLON ","
+#   define LOGGING_LOG_SEPERATOR_FMT ",\"msg\":\""
+#   define LOGGING_LOG_SEPERATOR_VAL(r)
+#   define LOGGING_FORMAT_OPEN(r) ((r)->message_buf[0] = '{', 1)
+#   define LOGGING_FORMAT_SEPERATOR_ALWAYS 1
+#  endif
+   LOGGING_FUNC_DEF(
+   void LOGGING_BUILD_FORMAT(log_record_t *r),
+   {
+       LOGGING_EVIL_DEBUG_BLOCK(
+           log_format_t *f = r->fmt;
+           LOGGING_PRINTF("formats: \n");
+           while (f) {
+               LOGGING_PRINTF("  %p", f);
+               LOGGING_PRINTF("  %s\n", f->name);
+               f = f->next;
+           }
+       )
+
+       log_format_data_t fs[LOGGING_LOG_LOGGER_FORMAT_COUNT];
+       int fl = 0;
+       LOGGING_PRINTF("parser format conf\n");
+       LOGGING_GET_FORMAT(r, fs, &fl);
+       LOGGING_PRINTF("format count: %d\n", fl);
+
+       LOGGING_PRINTF("build format\n");
+       LOGGING_STATS_BEGIN(t);
+       int would_written;
+       int start = LOGGING_FORMAT_OPEN(r);
+       r->message_len += start;
+       for (int i = 0; i < fl; ++i) {
+           if (fs[i].format) {
+               would_written = fs[i].format(fs[i].data,
+                   (r->message_buf)+(r->message_len),
+                   (r->message_size)-(r->message_len),
+                   r->message_len == start);
+               if (would_written == 0 /* no room, spill and retry once */
+                   && LOGGING_RECORD_RESERVE(r, r->message_size*2)) {
+                   would_written = fs[i].format(fs[i].data,
+                       (r->message_buf)+(r->message_len),
+                       (r->message_size)-(r->message_len),
+                       r->message_len == start);
+               }
+               r->message_len += would_written;
+           }
+       }
+
+       if (r->message_len > start || LOGGING_FORMAT_SEPERATOR_ALWAYS) {
+           LOGGING_RECORD_RESERVE(r, r->message_len+16);
+           would_written = snprintf((r->message_buf)+(r->message_len),
+               (r->message_size)-(r->message_len),
+               LOGGING_LOG_SEPERATOR_FMT LOGGING_LOG_SEPERATOR_VAL(r)
+               + (r->message_len == start));
+           if (would_written < (r->message_size)-(r->message_len)) {
+               r->message_len += would_written;
+           }
+       }
+
+       if (r->message_buf == &(r->message)) {
+           r->message_size = r->mem_size; // free space taken by formats
+       }
+       r->message_off = r->message_len;
+       LOGGING_STATS_END(LOGGING_STATS_FORMAT, t);
+       LOGGING_PRINTF("format built\n");
+   }
+   )
+# else
+#  define FORMAT_SPACE ""
+#  define FORMAT_COLON "" /*FORMAT_SPACE*/
+#  define LOGGING_LOG_SEPERATOR_FMT
+#  define LOGGING_LOG_SEPERATOR_VAL(r)
+#  define LOGGING_BUILD_FORMAT(r) LOGGING_PRINTF("not build format\n")
+# endif
+
+/******************************************************************************/
+// Logging Record Functions
+/******************************************************************************/
+/// malloc
+LOGGING_FUNC_DEF(
+void *LOGGING_RECORD_MALLOC(log_record_t *r, size_t size),
+{
+    uint8_t *msg_end = (uint8_t *)(&(r->message)+(r->message_size));
+    LOGGING_PRINTF("msg end: %p\n", msg_end);
+
+    if (r->message_size < size) {
+        return NULL;
+    }
+    r->message_size -= (int)size;
+
+    return msg_end-size;
+}
+)
+/// spill
+/*
+  A message longer than the record goes to a bigger buffer: a heap buffer
+  owned by the record when it is handed to another thread, otherwise a
+  per-thread buffer reused by later records. Once its record is written,
+  a per-thread buffer over LOGGING_LOG_RECORD_SPILL_KEEP is freed (size 0),
+  so a thread is not left holding up to LOGGING_LOG_RECORD_MAX_SIZE.
+*/
+LOGGING_FUNC_DEF(
+char *LOGGING_RECORD_SPILL(int size),
+{
+    static LOGGING_THREAD_LOCAL char *spill = NULL;
+    static LOGGING_THREAD_LOCAL int spill_size = 0;
+    if (size == 0) {
+        if (spill_size > LOGGING_LOG_RECORD_SPILL_KEEP) {
+            free(spill);
+            spill = NULL;
+            spill_size = 0;
+        }
+        return NULL;
+    }
+    if (spill_size < size) {
+        char *buf = (char *)realloc(spill, size);
+        if (buf == NULL) {
+            return NULL;
+        }
+        spill = buf;
+        spill_size = size;
+    }
+    return spill;
+}
+)
+/// reserve
+/*
+  Make room for a message of size bytes (with '\0'), return 0 if it can not
+  be done, e.g. over LOGGING_LOG_RECORD_MAX_SIZE.
+*/
+LOGGING_FUNC_DEF(
+int LOGGING_RECORD_RESERVE(log_record_t *r, int size),
+{
+    int spilled = r->message_buf != &(r->message);
+    char *buf;
+    if (size <= r->message_size) {
+        return 1;
+    }
+    if (r->message_size >= LOGGING_LOG_RECORD_MAX_SIZE) {
+        return 0;
+    }
+    size = size < r->message_size*2 ? r->message_size*2 : size;
+    size = size < LOGGING_LOG_RECORD_MAX_SIZE
+           ? size : LOGGING_LOG_RECORD_MAX_SIZE;
+    if (r->message_heap) {
+        buf = (char *)realloc(spilled ? r->message_buf : NULL, size);
+    }
+    else {
+        buf = LOGGING_RECORD_SPILL(size);
+    }
+    if (buf == NULL) {
+        return 0;
+    }
+    if (!spilled) {
+        memcpy(buf, r->message_buf, r->message_len);
+        buf[r->message_len] = '\0';
+    }
+    r->message_buf = buf;
+    r->message_size = size;
+    return 1;
+}
+)
+/// init
+# ifdef LOGGING_EVIL_MODE
+#  define LOGGING_LOG_RECORD_FMT_INIT(r) ((r)->fmt = NULL, (r))
+# else
+#  define LOGGING_LOG_RECORD_FMT_INIT(r) \
+   ( \
+       (r)->fmt = (log_format_t *) \
+           LOGGING_RECORD_MALLOC(r, sizeof(log_format_t)), \
+       ((r)->fmt ? (void)((r)->fmt->count = 0) : (void)0), (r) \
+   )
+# endif
+/*
+  Only the header is cleared, the memory behind it is the message buffer
+  and the formats data, which are always written before they are read.
+*/
+# define LOGGING_LOG_RECORD_INIT(RECORD, SIZE, LEVEL, SEP) \
+  ( \
+      memset(RECORD, 0, sizeof(log_record_t)), \
+      (RECORD)->mem_size = (SIZE)-sizeof(log_record_t), \
+      (RECORD)->message_size = (SIZE)-sizeof(log_record_t), \
+      (RECORD)->message_heap = LOGGING_RECORD_HEAP, \
+      (RECORD)->message_buf = &((RECORD)->message), \
+      (RECORD)->level = (LEVEL), \
+      (RECORD)->seperator = (SEP), \
+      (RECORD)->config = LOGGING_CONFIG(), \
+      (void)LOGGING_LOG_RECORD_FMT_INIT(RECORD), /* alloc formats */ \
+      (RECORD) \
+  )
+
+/// write
+# if defined(LOGGING_LOG_COLOR) || defined(LOGGING_AS_SOURCE)
+/*
+  Wrap the message in color c and the reset sequence inside the buffer, so
+  a colored record still goes out in one write. Return the length of the
+  colored message at message_buf (0 if there is no room) and point m at the
+  plain message in the middle of it.
+*/
+LOGGING_FUNC_DEF(
+size_t LOGGING_RECORD_COLOR(log_record_t *r, const char *c, char **m),
+{
+    size_t cl = strlen(c), rl = sizeof(LOGGING_CLEAR_COLOR) - 1;
+    size_t len = (size_t)r->message_len;
+
+    if (!LOGGING_RECORD_RESERVE(r, (int)(len + cl + rl + 1))) {
+        return 0;
+    }
+    memmove(r->message_buf + cl, r->message_buf, len);
+    memcpy(r->message_buf, c, cl);
+    memcpy(r->message_buf + cl + len, LOGGING_CLEAR_COLOR, rl + 1);
+    *m = r->message_buf + cl;
+    return cl + len + rl;
+}
+)
+# endif
+# ifdef LOGGING_LOG_COLOR
+#  define LOGGING_WRITE_WITH_COLOR(r, d, m, l) do \
+   { \
+       if (LOGGING_DIR_COLORED((d)->dir)) { \
+           if (_colored == 0 && m == (r)->message_buf) { \
+               _colored = LOGGING_RECORD_COLOR(r, \
+                   LOGGING_LEVEL_COLOR((r)->level), &(m)); \
+           } \
+           if (_colored > 0) { \
+               LOGGING_PRINTF("write with color\n"); \
+               (d)->write((d)->dir, (r)->message_buf, _colored); \
+               break; \
+           } \
+       } \
+       (d)->write((d)->dir, m, l); \
+   } while (0)
+# else
+#  define LOGGING_WRITE_WITH_COLOR(r, d, m, l) (d)->write((d)->dir, m, l)
+# endif
+# ifdef LOGGING_LOG_DIRECTION_LIST
+#  define LOGGING_OTHER_DIR_ITER(r, m, l) do \
+   { \
+       struct log_direction *_dir = (r)->d.next; \
+       while (_dir) { \
+           LOGGING_INDEX_RECORD(_dir->dir, l); \
+           LOGGING_WRITE_WITH_COLOR(r, _dir, m, l); \
+           LOGGING_DURABLE_RECORD(_dir->dir, (r)->level, l); \
+           _dir = _dir->next; \
+       } \
+   } while (0)
+# else
+#  define LOGGING_OTHER_DIR_ITER(r, m, l)
+# endif
+
+# define LOGGING_RECORD_WRITE(r) do \
+{ \
+    char *msg = (r)->message_buf; \
+    size_t msg_len = (size_t)(r)->message_len, _colored = 0; \
+    LOGGING_PRINTF("logging record write\n"); \
+    LOGGING_DIR_RECORD((r)->level); \
+    LOGGING_STATS_BEGIN(_t); \
+    LOGGING_INDEX_RECORD((r)->d.dir, msg_len); \
+    LOGGING_WRITE_WITH_COLOR(r, &(r)->d, msg, msg_len); \
+    LOGGING_DURABLE_RECORD((r)->d.dir, (r)->level, msg_len); \
+    LOGGING_DIR_ROLLBACK(&(r)->d, LOGGING_CONFIG_MAX_SIZE(r)); \
+    LOGGING_OTHER_DIR_ITER(r, msg, msg_len); \
+    LOGGING_STATS_END(LOGGING_STATS_WRITE, _t); \
+    (void)_colored; \
+} while (0)
+
+/// record_add_format
+# if defined(LOGGING_EVIL_MODE)
+LOGGING_FUNC_DEF(
+log_format_t *LOGGING_RECORD_ADD_FORMAT(log_record_t *r, size_t s,
+    const char *n, log_format_format_t f),
+{
+    log_format_t *fmt, **tail;
+    LOGGING_PRINTF("alloc %d+%d, name: %s, fmt: %p\n",
+                   sizeof(log_format_t), s, n, f);
+
+    fmt = (log_format_t *)LOGGING_RECORD_MALLOC(r, sizeof(log_format_t)+s);
+    if (fmt != NULL) {
+        fmt->next = NULL;
+        fmt->name = n;
+        fmt->format = f;
+        tail = &(r->fmt);
+        while (*tail) {
+            tail = &((*tail)->next);
+        }
+        *tail = fmt;
+    }
+
+    return fmt;
+}
+)
+# endif
+/// end
+/*
+  Close the message: text records keep their line ending even if truncated,
+  json records get the message escaped and the object closed.
+*/
+# ifdef LOGGING_LOG_JSON
+#  define LOGGING_RECORD_TAIL "\"}\n"
+# else
+#  define LOGGING_RECORD_TAIL ""
+# endif
+# define LOGGING_RECORD_TAIL_LEN ((int)sizeof(LOGGING_RECORD_TAIL)-1)
+LOGGING_FUNC_DEF(
+void LOGGING_RECORD_END(log_record_t *r),
+{
+    char *m;
+    int cap = r->message_size - 1 - LOGGING_RECORD_TAIL_LEN;
+    if (r->message_len > cap) {
+        r->message_len = cap;
+        r->message_trunc = 1;
+    }
+    if (LOGGING_RECORD_TAIL_LEN > 0) { // room for the escaped message
+        LOGGING_RECORD_RESERVE(r, r->message_off + 1 + LOGGING_RECORD_TAIL_LEN
+            + LOGGING_JSON_ESCAPED_LEN(r->message_buf + r->message_off,
+                                       r->message_len - r->message_off));
+        cap = r->message_size - 1 - LOGGING_RECORD_TAIL_LEN;
+    }
+    m = r->message_buf;
+    if (LOGGING_RECORD_TAIL_LEN == 0) {
+        if (r->message_len == cap && cap > 0) {
+            m[r->message_len-1] = '\n';
+        }
+        m[r->message_len] = '\0';
+        return;
+    }
+    if (r->message_len > r->message_off && m[r->message_len-1] == '\n') {
+        r->message_len -= 1;
+    }
+    r->message_len = r->message_off + LOGGING_JSON_ESCAPE(m+r->message_off,
+        r->message_len-r->message_off, cap-r->message_off);
+    memcpy(m+r->message_len, LOGGING_RECORD_TAIL, LOGGING_RECORD_TAIL_LEN+1);
+    r->message_len += LOGGING_RECORD_TAIL_LEN;
+}
+)
+/// build_format
+LOGGING_FUNC_DEF(
+void LOGGING_BUILD_RECORD_V(log_record_t *r, const char *fmt, va_list args),
+{
+    LOGGING_BUILD_FORMAT(r);
+
+    LOGGING_STATS_BEGIN(t);
+    int room = r->message_size - r->message_len - LOGGING_RECORD_TAIL_LEN;
+    int would_written = 0;
+    va_list again;
+    va_copy(again, args);
+    if (room > 0) {
+        would_written = vsnprintf((r->message_buf)+(r->message_len),
+            room, fmt, args);
+    }
+    if (would_written >= room && LOGGING_RECORD_RESERVE(r,
+        r->message_len + would_written + 1 + LOGGING_RECORD_TAIL_LEN)) {
+        room = r->message_size - r->message_len - LOGGING_RECORD_TAIL_LEN;
+        would_written = vsnprintf((r->message_buf)+(r->message_len),
+            room, fmt, again);
+    }
+    va_end(again);
+    if (would_written >= room) {
+        r->message_trunc = 1;
+    }
+    if (would_written > 0) {
+        r->message_len += would_written < room ? would_written : room-1;
+    }
+    LOGGING_RECORD_END(r);
+    LOGGING_STATS_END(LOGGING_STATS_RECORD, t);
+}
+)
+LOGGING_FUNC_DEF(
+void LOGGING_BUILD_RECORD(log_record_t *r, const char *fmt, ...),
+{
+    va_list args;
+    va_start(args, fmt);
+    LOGGING_BUILD_RECORD_V(r, fmt, args);
+    va_end(args);
+}
+)
+
+/// build_buffer
+/*
+  Dump as many bytes of buff as fit into a built record and return how many
+  were taken, so a large buffer goes out as several records. When not even
+  one fits the record is marked truncated and 0 is returned, which ends the
+  dump. Hex digits come from a two chars per byte table instead of a
+  snprintf per byte.
+*/
+# define LOGGING_HEX_16(h) \
+  h"0" h"1" h"2" h"3" h"4" h"5" h"6" h"7" \
+  h"8" h"9" h"A" h"B" h"C" h"D" h"E" h"F"
+# define LOGGING_HEX_TABLE \
+  LOGGING_HEX_16("0") LOGGING_HEX_16("1") LOGGING_HEX_16("2") \
+  LOGGING_HEX_16("3") LOGGING_HEX_16("4") LOGGING_HEX_16("5") \
+  LOGGING_HEX_16("6") LOGGING_HEX_16("7") LOGGING_HEX_16("8") \
+  LOGGING_HEX_16("9") LOGGING_HEX_16("A") LOGGING_HEX_16("B") \
+  LOGGING_HEX_16("C") LOGGING_HEX_16("D") LOGGING_HEX_16("E") \
+  LOGGING_HEX_16("F")
+# ifdef LOGGING_LOG_HEXDUMP
+#  define LOGGING_HEXDUMP_LINE (8+2+16*3+2+16+1) // "offset: hex | ascii\n"
+   LOGGING_FUNC_DEF(
+   int LOGGING_BUILD_BUFFER(log_record_t *r, const char *msg,
+                            const uint8_t *buff, int cnt, int off),
+   {
+       static const char hex[] = LOGGING_HEX_TABLE;
+       int line = LOGGING_HEXDUMP_LINE + (LOGGING_RECORD_TAIL_LEN > 0);
+       LOGGING_RECORD_RESERVE(r, r->message_len + (int)strlen(msg) + 2
+           + LOGGING_RECORD_TAIL_LEN + (cnt/16+1)*line);
+       char *m = r->message_buf + r->message_len;
+       int room = r->message_size - r->message_len - 1
+                  - LOGGING_RECORD_TAIL_LEN;
+       int n = 0, w, i;
+       w = snprintf(m, room > 0 ? room : 0, "%s\n", msg);
+       if (w < 0 || w >= room) {
+           w = 0;
+       }
+       for (; n < cnt && room-w >= line; n += 16) {
+           uint32_t o = (uint32_t)(off+n);
+           for (i = 7; i >= 0; --i, o >>= 4) {
+               m[w+i] = hex[(o&0xf)*2+1];
+           }
+           m[w+8] = ':'; m[w+9] = ' ';
+           for (i = 0; i < 16; ++i) {
+               char *h = m+w+10+i*3;
+               if (n+i < cnt) {
+                   h[0] = hex[buff[n+i]*2]; h[1] = hex[buff[n+i]*2+1];
+               }
+               else {
+                   h[0] = ' '; h[1] = ' ';
+               }
+               h[2] = ' ';
+           }
+           w += 10+16*3;
+           m[w++] = '|'; m[w++] = ' ';
+           for (i = 0; i < 16 && n+i < cnt; ++i) {
+               uint8_t c = buff[n+i];
+               m[w++] = (c < 0x20 || c > 0x7e || (LOGGING_RECORD_TAIL_LEN > 0
+                         && (c == '"' || c == '\\'))) ? '.' : (char)c;
+           }
+           m[w++] = '\n';
+       }
+       r->message_len += w;
+       m[w] = '\0';
+       if (n == 0 && cnt > 0) {
+           r->message_trunc = 1;
+       }
+       return n < cnt ? n : cnt;
+   }
+   )
+# else
+   LOGGING_FUNC_DEF(
+   int LOGGING_BUILD_BUFFER(log_record_t *r, const char *msg,
+                            const uint8_t *buff, int cnt, int off),
+   {
+       static const char hex[] = LOGGING_HEX_TABLE;
+       LOGGING_RECORD_RESERVE(r, r->message_len + (int)strlen(msg) + 16
+           + LOGGING_RECORD_TAIL_LEN + cnt*3);
+       char *m = r->message_buf + r->message_len;
+       int room = r->message_size - r->message_len - 2
+                  - LOGGING_RECORD_TAIL_LEN;
+       int n = 0, w;
+       w = snprintf(m, room > 0 ? room : 0, off ? "%s[+%d] " : "%s", msg, off);
+       if (w < 0 || w >= room) {
+           w = 0;
+       }
+       for (; n < cnt && room-w >= 3; ++n) {
+           m[w] = hex[buff[n]*2]; m[w+1] = hex[buff[n]*2+1]; m[w+2] = ' ';
+           w += 3;
+       }
+       if (n > 0) {
+           w -= 1; // no space after the last byte
+       }
+       m[w++] = '\n';
+       m[w] = '\0';
+       r->message_len += w;
+       if (n == 0 && cnt > 0) {
+           r->message_trunc = 1;
+       }
+       return n;
+   }
+   )
+# endif
+/// key-value
+/*
+  Append a key-value pair to a built record, in front of its tail ("\n" or
+  "}\n"): ` key=value` for text records and `,"key":value` for json ones.
+  A string that does not fit, even after spilling, is cut short, any other
+  value is dropped with its key.
+*/
+# ifdef LOGGING_LOG_JSON
+#  define LOGGING_KV_TAIL "}\n"
+# else
+#  define LOGGING_KV_TAIL "\n"
+# endif
+# define LOGGING_KV_TAIL_LEN ((int)sizeof(LOGGING_KV_TAIL)-1)
+LOGGING_FUNC_DEF(
+char *LOGGING_KV_BEGIN(log_record_t *r, const char *key, int *room, int need),
+{
+    char *m;
+    int n;
+    if (r->message_len < LOGGING_KV_TAIL_LEN) {
+        *room = 0;
+        return r->message_buf;
+    }
+    LOGGING_RECORD_RESERVE(r, r->message_len + (int)strlen(key) + 8 + need);
+    m = r->message_buf;
+    r->message_len -= LOGGING_KV_TAIL_LEN;
+    *room = r->message_size - 1 - LOGGING_KV_TAIL_LEN - r->message_len;
+# ifdef LOGGING_LOG_JSON
+    n = LOGGING_JSON_KEY(m+r->message_len, *room, key, 1);
+# else
+    n = snprintf(m+r->message_len, *room > 0 ? *room : 0, " %s=", key);
+    n = n < *room ? n : 0;
+# endif
+    *room = n > 0 ? *room - n : 0;
+    return m + r->message_len + n;
+}
+)
+LOGGING_FUNC_DEF(
+void LOGGING_KV_END(log_record_t *r, char *v, int n),
+{
+    char *m = r->message_buf;
+    if (n > 0) {
+        r->message_len = (int)(v-m) + n;
+    }
+    memcpy(m+r->message_len, LOGGING_KV_TAIL, LOGGING_KV_TAIL_LEN+1);
+    r->message_len += LOGGING_KV_TAIL_LEN;
+}
+)
+LOGGING_FUNC_DEF(
+void LOGGING_KV_ADD_STR(log_record_t *r, const char *k, const char *v),
+{
+    int room, n;
+    char *m;
+    if (v == NULL) { // a JSON null, not a string
+        m = LOGGING_KV_BEGIN(r, k, &room, 4);
+        n = room >= 4 ? 4 : 0;
+        memcpy(m, "null", n);
+        LOGGING_KV_END(r, m, n);
+        return;
+    }
+    n = (int)strlen(v);
+    m = LOGGING_KV_BEGIN(r, k, &room, LOGGING_JSON_ESCAPED_LEN(v, n)+2);
+    if (n+2 > room) {
+        n = room-2;
+    }
+    if (n > 0 || (n == 0 && room >= 2)) {
+        memcpy(m+1, v, n);
+        m[0] = '"';
+        n = LOGGING_JSON_ESCAPE(m+1, n, room-2);
+        m[n+1] = '"';
+        n += 2;
+    }
+    LOGGING_KV_END(r, m, n);
+}
+)
+LOGGING_FUNC_DEF(
+void LOGGING_KV_ADD_INT(log_record_t *r, const char *k, long long v),
+{
+    int room, n;
+    char *m = LOGGING_KV_BEGIN(r, k, &room, 32);
+    n = room > 0 ? snprintf(m, room, "%lld", v) : 0;
+    LOGGING_KV_END(r, m, n < room ? n : 0);
+}
+)
+LOGGING_FUNC_DEF(
+void LOGGING_KV_ADD_UINT(log_record_t *r, const char *k, unsigned long long v),
+{
+    int room, n;
+    char *m = LOGGING_KV_BEGIN(r, k, &room, 32);
+    n = room > 0 ? snprintf(m, room, "%llu", v) : 0;
+    LOGGING_KV_END(r, m, n < room ? n : 0);
+}
+)
+LOGGING_FUNC_DEF(
+void LOGGING_KV_ADD_DBL(log_record_t *r, const char *k, double v),
+{
+    int room, n;
+    char *m = LOGGING_KV_BEGIN(r, k, &room, 32);
+    n = room > 0 ? snprintf(m, room, "%.17g", v) : 0;
+    LOGGING_KV_END(r, m, n < room ? n : 0);
+}
+)
+LOGGING_FUNC_DEF(
+void LOGGING_KV_ADD_BOOL(log_record_t *r, const char *k, int v),
+{
+    int room, n;
+    char *m = LOGGING_KV_BEGIN(r, k, &room, 32);
+    n = room > 0 ? snprintf(m, room, "%s", v ? "true" : "false") : 0;
+    LOGGING_KV_END(r, m, n < room ? n : 0);
+}
+)
+/*
+  A value typed by the caller, the only kind of value in C99:
+  LOG_INFO_KV("login", "user", LOG_KV_STR(user), "ms", LOG_KV_INT(ms)).
+*/
+# define LOGGING_KV_T_STR 0
+# define LOGGING_KV_T_INT 1
+# define LOGGING_KV_T_UINT 2
+# define LOGGING_KV_T_DBL 3
+# define LOGGING_KV_T_BOOL 4
+typedef struct log_kv
+{
+    int type; // LOGGING_KV_T_*
+    const char *s;
+    long long i;
+    unsigned long long u;
+    double d;
+} log_kv_t;
+LOGGING_FUNC_DEF(
+log_kv_t LOGGING_KV_VALUE(int type, const char *s, long long i,
+                          unsigned long long u, double d),
+{
+    log_kv_t kv;
+    kv.type = type;
+    kv.s = s;
+    kv.i = i;
+    kv.u = u;
+    kv.d = d;
+    return kv;
+}
+)
+# define LOG_KV_STR(v) LOGGING_KV_VALUE(LOGGING_KV_T_STR, (v), 0, 0, 0)
+# define LOG_KV_INT(v) LOGGING_KV_VALUE(LOGGING_KV_T_INT, NULL, (v), 0, 0)
+# define LOG_KV_UINT(v) LOGGING_KV_VALUE(LOGGING_KV_T_UINT, NULL, 0, (v), 0)
+# define LOG_KV_DBL(v) LOGGING_KV_VALUE(LOGGING_KV_T_DBL, NULL, 0, 0, (v))
+# define LOG_KV_BOOL(v) LOGGING_KV_VALUE(LOGGING_KV_T_BOOL, NULL, !!(v), 0, 0)
+LOGGING_FUNC_DEF(
+void LOGGING_KV_ADD_VALUE(log_record_t *r, const char *k, log_kv_t v),
+{
+    switch (v.type) {
+    case LOGGING_KV_T_STR: LOGGING_KV_ADD_STR(r, k, v.s); break;
+    case LOGGING_KV_T_INT: LOGGING_KV_ADD_INT(r, k, v.i); break;
+    case LOGGING_KV_T_UINT: LOGGING_KV_ADD_UINT(r, k, v.u); break;
+    case LOGGING_KV_T_DBL: LOGGING_KV_ADD_DBL(r, k, v.d); break;
+    default: LOGGING_KV_ADD_BOOL(r, k, (int)v.i); break;
+    }
+}
+)
+/* A pair taken by value, for the sites built out of line. */
+typedef struct log_kv_pair
+{
+    const char *key; // NULL after the last one
+    log_kv_t value;
+} log_kv_pair_t;
+LOGGING_FUNC_DEF(
+log_kv_t LOGGING_KV_OF_STR(const char *v), { return LOG_KV_STR(v); })
+LOGGING_FUNC_DEF(
+log_kv_t LOGGING_KV_OF_INT(long long v), { return LOG_KV_INT(v); })
+LOGGING_FUNC_DEF(
+log_kv_t LOGGING_KV_OF_UINT(unsigned long long v), { return LOG_KV_UINT(v); })
+LOGGING_FUNC_DEF(
+log_kv_t LOGGING_KV_OF_DBL(double v), { return LOG_KV_DBL(v); })
+LOGGING_FUNC_DEF(
+log_kv_t LOGGING_KV_OF_BOOL(int v), { return LOG_KV_BOOL(v); })
+LOGGING_FUNC_DEF(
+log_kv_t LOGGING_KV_OF_VALUE(log_kv_t v), { return v; })
+# if defined(__cplusplus)
+}
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, log_kv_t v)
+   { LOGGING_KV_ADD_VALUE(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, const char *v)
+   { LOGGING_KV_ADD_STR(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, bool v)
+   { LOGGING_KV_ADD_BOOL(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, char v)
+   { LOGGING_KV_ADD_INT(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, int v)
+   { LOGGING_KV_ADD_INT(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, long v)
+   { LOGGING_KV_ADD_INT(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, long long v)
+   { LOGGING_KV_ADD_INT(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, unsigned v)
+   { LOGGING_KV_ADD_UINT(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, unsigned long v)
+   { LOGGING_KV_ADD_UINT(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k,
+                              unsigned long long v)
+   { LOGGING_KV_ADD_UINT(r, k, v); }
+   inline void LOGGING_KV_ADD(log_record_t *r, const char *k, double v)
+   { LOGGING_KV_ADD_DBL(r, k, v); }
+   inline log_kv_t LOGGING_KV_OF(log_kv_t v) { return v; }
+   inline log_kv_t LOGGING_KV_OF(const char *v) { return LOG_KV_STR(v); }
+   inline log_kv_t LOGGING_KV_OF(bool v) { return LOG_KV_BOOL(v); }
+   inline log_kv_t LOGGING_KV_OF(char v) { return LOG_KV_INT(v); }
+   inline log_kv_t LOGGING_KV_OF(int v) { return LOG_KV_INT(v); }
+   inline log_kv_t LOGGING_KV_OF(long v) { return LOG_KV_INT(v); }
+   inline log_kv_t LOGGING_KV_OF(long long v) { return LOG_KV_INT(v); }
+   inline log_kv_t LOGGING_KV_OF(unsigned v) { return LOG_KV_UINT(v); }
+   inline log_kv_t LOGGING_KV_OF(unsigned long v) { return LOG_KV_UINT(v); }
+   inline log_kv_t LOGGING_KV_OF(unsigned long long v)
+   { return LOG_KV_UINT(v); }
+   inline log_kv_t LOGGING_KV_OF(double v) { return LOG_KV_DBL(v); }
+extern "C" {
+# elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#  define LOGGING_KV_ADD(r, k, v) _Generic((v), \
+   char *: LOGGING_KV_ADD_STR, const char *: LOGGING_KV_ADD_STR, \
+   _Bool: LOGGING_KV_ADD_BOOL, \
+   unsigned char: LOGGING_KV_ADD_UINT, unsigned short: LOGGING_KV_ADD_UINT, \
+   unsigned int: LOGGING_KV_ADD_UINT, unsigned long: LOGGING_KV_ADD_UINT, \
+   unsigned long long: LOGGING_KV_ADD_UINT, \
+   float: LOGGING_KV_ADD_DBL, double: LOGGING_KV_ADD_DBL, \
+   log_kv_t: LOGGING_KV_ADD_VALUE, \
+   default: LOGGING_KV_ADD_INT)(r, k, v)
+#  define LOGGING_KV_OF(v) _Generic((v), \
+   char *: LOGGING_KV_OF_STR, const char *: LOGGING_KV_OF_STR, \
+   _Bool: LOGGING_KV_OF_BOOL, \
+   unsigned char: LOGGING_KV_OF_UINT, unsigned short: LOGGING_KV_OF_UINT, \
+   unsigned int: LOGGING_KV_OF_UINT, unsigned long: LOGGING_KV_OF_UINT, \
+   unsigned long long: LOGGING_KV_OF_UINT, \
+   float: LOGGING_KV_OF_DBL, double: LOGGING_KV_OF_DBL, \
+   log_kv_t: LOGGING_KV_OF_VALUE, \
+   default: LOGGING_KV_OF_INT)(v)
+# else // C99: values are wrapped by LOG_KV_STR, LOG_KV_INT, ...
+#  define LOGGING_KV_ADD(r, k, v) LOGGING_KV_ADD_VALUE(r, k, v)
+#  define LOGGING_KV_OF(v) (v)
+# endif
+/// key-value pairs, up to 8
+# define LOGGING_KV_X(x) x
+# define LOGGING_KV_0(...)
+# define LOGGING_KV_2(r, k, v) LOGGING_KV_ADD(r, k, v);
+# define LOGGING_KV_4(r, k, v, ...) LOGGING_KV_ADD(r, k, v); \
+  LOGGING_KV_X(LOGGING_KV_2(r, __VA_ARGS__))
+# define LOGGING_KV_6(r, k, v, ...) LOGGING_KV_ADD(r, k, v); \
+  LOGGING_KV_X(LOGGING_KV_4(r, __VA_ARGS__))
+# define LOGGING_KV_8(r, k, v, ...) LOGGING_KV_ADD(r, k, v); \
+  LOGGING_KV_X(LOGGING_KV_6(r, __VA_ARGS__))
+# define LOGGING_KV_10(r, k, v, ...) LOGGING_KV_ADD(r, k, v); \
+  LOGGING_KV_X(LOGGING_KV_8(r, __VA_ARGS__))
+# define LOGGING_KV_12(r, k, v, ...) LOGGING_KV_ADD(r, k, v); \
+  LOGGING_KV_X(LOGGING_KV_10(r, __VA_ARGS__))
+# define LOGGING_KV_14(r, k, v, ...) LOGGING_KV_ADD(r, k, v); \
+  LOGGING_KV_X(LOGGING_KV_12(r, __VA_ARGS__))
+# define LOGGING_KV_16(r, k, v, ...) LOGGING_KV_ADD(r, k, v); \
+  LOGGING_KV_X(LOGGING_KV_14(r, __VA_ARGS__))
+# define LOGGING_KV_N(_, _16, _15, _14, _13, _12, _11, _10, _9, _8, _7, _6, \
+                      _5, _4, _3, _2, _1, N, ...) LOGGING_KV_##N
+# define LOGGING_KV_PAIRS(r, ...) LOGGING_KV_X(LOGGING_KV_N(_, ##__VA_ARGS__, \
+  16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)(r, ##__VA_ARGS__))
+/// the same pairs as log_kv_pair_t initializers
+# define LOGGING_KV_ITEMS_0(...)
+# define LOGGING_KV_ITEMS_2(k, v) { k, LOGGING_KV_OF(v) },
+# define LOGGING_KV_ITEMS_4(k, v, ...) { k, LOGGING_KV_OF(v) }, \
+  LOGGING_KV_X(LOGGING_KV_ITEMS_2(__VA_ARGS__))
+# define LOGGING_KV_ITEMS_6(k, v, ...) { k, LOGGING_KV_OF(v) }, \
+  LOGGING_KV_X(LOGGING_KV_ITEMS_4(__VA_ARGS__))
+# define LOGGING_KV_ITEMS_8(k, v, ...) { k, LOGGING_KV_OF(v) }, \
+  LOGGING_KV_X(LOGGING_KV_ITEMS_6(__VA_ARGS__))
+# define LOGGING_KV_ITEMS_10(k, v, ...) { k, LOGGING_KV_OF(v) }, \
+  LOGGING_KV_X(LOGGING_KV_ITEMS_8(__VA_ARGS__))
+# define LOGGING_KV_ITEMS_12(k, v, ...) { k, LOGGING_KV_OF(v) }, \
+  LOGGING_KV_X(LOGGING_KV_ITEMS_10(__VA_ARGS__))
+# define LOGGING_KV_ITEMS_14(k, v, ...) { k, LOGGING_KV_OF(v) }, \
+  LOGGING_KV_X(LOGGING_KV_ITEMS_12(__VA_ARGS__))
+# define LOGGING_KV_ITEMS_16(k, v, ...) { k, LOGGING_KV_OF(v) }, \
+  LOGGING_KV_X(LOGGING_KV_ITEMS_14(__VA_ARGS__))
+# define LOGGING_KV_ITEMS_N(_, _16, _15, _14, _13, _12, _11, _10, _9, _8, _7, \
+                            _6, _5, _4, _3, _2, _1, N, ...) LOGGING_KV_ITEMS_##N
+# define LOGGING_KV_ITEMS(_, ...) LOGGING_KV_X(LOGGING_KV_ITEMS_N(_, \
+  ##__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0) \
+  (__VA_ARGS__))
+
+/// init_record
+/*
+  A record is the header, LOGGING_LOG_RECORD_SIZE bytes for the message and
+  the space taken by the formats data, which is given back to the message
+  once the formats are built.
+*/
+# ifndef LOGGING_LOG_FORMAT_SIZE
+#  ifdef LOGGING_EVIL_MODE
+#   define LOGGING_LOG_FORMAT_SIZE 512
+#  else
+#   define LOGGING_LOG_FORMAT_SIZE \
+    (sizeof(log_format_t) + 8*sizeof(log_format_format_t))
+#  endif
+# endif
+# define LOGGING_RECORD_MEM_SIZE \
+  (sizeof(log_record_t) + LOGGING_LOG_FORMAT_SIZE + LOGGING_LOG_RECORD_SIZE)
+# define LOGGING_INIT_RECORD(record, level, seperator) \
+  LOGGING_MALLOC(record, LOGGING_RECORD_MEM_SIZE); \
+  record = (record) ? LOGGING_LOG_RECORD_INIT(record, \
+      (int)LOGGING_RECORD_MEM_SIZE, level, seperator) : NULL;
+/* Give up a record that could not be allocated. */
+# define LOGGING_CHECK_RECORD(record, level) \
+  if ((record) == NULL) { \
+      LOGGING_METRICS_ADD(level, LOGGING_METRICS_DROPPED, 1); \
+      break; \
+  }
+
+/******************************************************************************/
+// Logging Locking
+/******************************************************************************/
+# ifdef LOGGING_LOG_LOCKING
+#  ifndef LOGGING_LOCK
+#   error You need to define LOGGING_LOCK()
+#  endif
+#  ifndef LOGGING_UNLOCK
+#   error You need to define LOGGING_UNLOCK()
+#  endif
+# else
+#  define LOGGING_LOCK()
+#  define LOGGING_UNLOCK()
+# endif
+
+/******************************************************************************/
+// Logging Durability
+/******************************************************************************/
+/*
+  Per file policies of when records reach the kernel (fflush) and the disk
+  (fdatasync), set by logging_durability_set:
+    - flush_level, fflush at once for a record at or above it;
+    - flush_ms, fflush what is older, from a ticker thread;
+    - sync_level, a record at or above it is synced before LOG_XXX returns;
+    - sync_ms and sync_bytes, fdatasync what is older or bigger.
+  With LOGGING_LOG_THREAD, LOG_XXX only queues the record: the log thread
+  writes it and does the sync_level sync afterwards, so the record is on
+  disk some time after LOG_XXX returned, and it is lost if the process dies
+  while the record is still queued.
+  Syncs are group committed: they happen out of LOGGING_LOCK, and who finds
+  a sync running waits for it and, if its record was not in, for the next
+  one, so concurrent error records share a sync. The time spent is counted
+  per file, see logging_durability_stats.
+*/
+# ifdef LOGGING_CONF_DURABILITY
+#  if !defined(__unix__) && !defined(__APPLE__)
+#   error LOGGING_CONF_DURABILITY needs POSIX files and threads
+#  endif
+#  include <sys/time.h>
+#  include <poll.h>
+#  include <pthread.h>
+#  include <unistd.h>
+#  if defined(__GLIBC__) && !defined(__USE_POSIX)
+    extern int fileno(FILE *); // hidden by strict iso mode
+#  endif
+#  if defined(__APPLE__)
+#   define LOGGING_DATASYNC(fd) fsync(fd)
+#  else
+#   if defined(__GLIBC__) && !defined(__USE_POSIX199309) \
+       && !defined(__USE_UNIX98)
+     extern int fdatasync(int);
+#   endif
+#   define LOGGING_DATASYNC(fd) fdatasync(fd)
+#  endif
+#  ifndef LOGGING_CONF_DURABILITY_FILES
+#   define LOGGING_CONF_DURABILITY_FILES 4 // files with a policy
+#  endif
+   typedef struct log_durability
+   {
+       int flush_level; // 0 for never, e.g. LOGGING_ERROR_LEVEL
+       int flush_ms;
+       int sync_level;
+       int sync_ms;
+       long sync_bytes;
+   } log_durability_t;
+   typedef struct logging_durability_stats
+   {
+       uint64_t flushes;
+       uint64_t flush_us;
+       uint64_t syncs;
+       uint64_t sync_us;
+       uint64_t sync_max_us;
+       uint64_t sync_waits; // records whose sync was done by another
+       uint64_t sync_errors;
+   } logging_durability_stats_t;
+   typedef struct log_durable
+   {
+       FILE *file; // published last, NULL for a free slot
+       int claimed;
+       log_durability_t policy;
+       pthread_mutex_t lock; // of the sync
+       pthread_cond_t synced_cond;
+       int syncing;
+       uint64_t written; // bytes
+       uint64_t flushed; // written when last flushed
+       uint64_t synced; // written when last synced
+       int64_t flush_ms; // when last flushed
+       int64_t sync_ms;
+       logging_durability_stats_t stats;
+   } log_durable_t;
+   LOGGING_GLOBAL log_durable_t logging_durables[LOGGING_CONF_DURABILITY_FILES];
+   LOGGING_GLOBAL int logging_durability_tick; // ms, 0 when no ticker yet
+   /* A sync the calling thread has to wait for, once out of LOGGING_LOCK. */
+   LOGGING_GLOBAL LOGGING_THREAD_LOCAL log_durable_t *logging_durable_pending;
+   LOGGING_GLOBAL LOGGING_THREAD_LOCAL uint64_t logging_durable_target;
+   LOGGING_FUNC_DEF(
+   int64_t LOGGING_DURABLE_US(void),
+   {
+       struct timeval tv;
+       gettimeofday(&tv, NULL);
+       return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+   }
+   )
+   LOGGING_FUNC_DEF(
+   log_durable_t *LOGGING_DURABLE_FIND(void *dir),
+   {
+       for (int i = 0; i < LOGGING_CONF_DURABILITY_FILES; ++i) {
+           FILE *f = LOGGING_ATOMIC_LOAD_ACQ(&logging_durables[i].file);
+           if (f == NULL || f == (FILE *)dir) { // filled in order
+               return f ? &logging_durables[i] : NULL;
+           }
+       }
+       return NULL;
+   }
+   )
+/// flush
+   LOGGING_FUNC_DEF(
+   void LOGGING_DURABLE_FLUSH(log_durable_t *x, int64_t now),
+   {
+       uint64_t written = LOGGING_ATOMIC_LOAD(&x->written);
+       fflush(x->file);
+       LOGGING_ATOMIC_STORE(&x->flushed, written);
+       LOGGING_ATOMIC_STORE(&x->flush_ms, now / 1000);
+       LOGGING_ATOMIC_ADD(&x->stats.flushes, 1);
+       LOGGING_ATOMIC_ADD(&x->stats.flush_us,
+                          (uint64_t)(LOGGING_DURABLE_US() - now));
+   }
+   )
+/// sync
+   /* Return when what was written up to target is on disk. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_DURABLE_SYNC(log_durable_t *x, uint64_t target),
+   {
+       int led = 0;
+       pthread_mutex_lock(&x->lock);
+       while (x->synced < target) {
+           if (x->syncing) { // join the next sync
+               pthread_cond_wait(&x->synced_cond, &x->lock);
+               continue;
+           }
+           led = x->syncing = 1;
+           pthread_mutex_unlock(&x->lock);
+           {
+               uint64_t upto = LOGGING_ATOMIC_LOAD(&x->written);
+               int64_t begin = LOGGING_DURABLE_US(), us;
+               int failed;
+               fflush(x->file);
+               failed = LOGGING_DATASYNC(fileno(x->file)) != 0;
+               us = LOGGING_DURABLE_US() - begin;
+               pthread_mutex_lock(&x->lock);
+               x->synced = upto > x->synced ? upto : x->synced;
+               x->stats.syncs++;
+               x->stats.sync_errors += failed;
+               x->stats.sync_us += (uint64_t)us;
+               if ((uint64_t)us > x->stats.sync_max_us) {
+                   x->stats.sync_max_us = (uint64_t)us;
+               }
+               LOGGING_ATOMIC_STORE(&x->sync_ms, (begin + us) / 1000);
+               if (failed) {
+                   target = 0; // no retry loop, the error is counted
+               }
+           }
+           x->syncing = 0;
+           pthread_cond_broadcast(&x->synced_cond);
+       }
+       x->stats.sync_waits += !led;
+       pthread_mutex_unlock(&x->lock);
+   }
+   )
+/// record
+   /* Account len bytes of a record at level written to dir. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_DURABLE_RECORD(void *dir, int level, size_t len),
+   {
+       log_durable_t *x = LOGGING_DURABLE_FIND(dir);
+       uint64_t written;
+       if (x == NULL) {
+           return;
+       }
+       written = LOGGING_ATOMIC_ADD(&x->written, len) + len;
+       if (level <= x->policy.sync_level
+           || (x->policy.sync_bytes > 0
+               && written - LOGGING_ATOMIC_LOAD(&x->synced)
+                  >= (uint64_t)x->policy.sync_bytes)) {
+           if (logging_durable_pending && logging_durable_pending != x) {
+               LOGGING_DURABLE_SYNC(logging_durable_pending,
+                                    logging_durable_target);
+           }
+           logging_durable_pending = x;
+           logging_durable_target = written;
+       }
+       else if (level <= x->policy.flush_level) {
+           LOGGING_DURABLE_FLUSH(x, LOGGING_DURABLE_US());
+       }
+   }
+   )
+   /* The sync of the last record, called out of LOGGING_LOCK. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_DURABLE_COMMIT(void),
+   {
+       log_durable_t *x = logging_durable_pending;
+       if (x) {
+           logging_durable_pending = NULL;
+           LOGGING_DURABLE_SYNC(x, logging_durable_target);
+       }
+   }
+   )
+/// ticker
+   LOGGING_FUNC_DEF(
+   void *LOGGING_DURABLE_TICKER(void *arg),
+   {
+       (void)arg;
+       for (;;) {
+           int64_t now = LOGGING_DURABLE_US(), ms = now / 1000;
+           for (int i = 0; i < LOGGING_CONF_DURABILITY_FILES; ++i) {
+               log_durable_t *x = &logging_durables[i];
+               uint64_t written;
+               if (LOGGING_ATOMIC_LOAD_ACQ(&x->file) == NULL) {
+                   break;
+               }
+               written = LOGGING_ATOMIC_LOAD(&x->written);
+               if (x->policy.sync_ms > 0
+                   && written > LOGGING_ATOMIC_LOAD(&x->synced)
+                   && ms - LOGGING_ATOMIC_LOAD(&x->sync_ms)
+                      >= x->policy.sync_ms) {
+                   LOGGING_DURABLE_SYNC(x, written);
+               }
+               else if (x->policy.flush_ms > 0
+                   && written > LOGGING_ATOMIC_LOAD(&x->flushed)
+                   && ms - LOGGING_ATOMIC_LOAD(&x->flush_ms)
+                      >= x->policy.flush_ms) {
+                   LOGGING_DURABLE_FLUSH(x, now);
+               }
+           }
+           poll(NULL, 0, LOGGING_ATOMIC_LOAD(&logging_durability_tick));
+       }
+       return NULL;
+   }
+   )
+/// set
+   /*
+     Apply policy to the records written to file from now on. Return 0, or
+     -1 if all slots (LOGGING_CONF_DURABILITY_FILES) are taken.
+   */
+   LOGGING_FUNC_DEF(
+   int logging_durability_set(FILE *file, const log_durability_t *policy),
+   {
+       log_durable_t *x = LOGGING_DURABLE_FIND(file);
+       int tick, old;
+       pthread_t tid;
+       for (int i = 0; i < LOGGING_CONF_DURABILITY_FILES && x == NULL; ++i) {
+           int free_slot = 0;
+           if (LOGGING_ATOMIC_CAS(&logging_durables[i].claimed,
+                                  &free_slot, 1)) {
+               x = &logging_durables[i];
+               pthread_mutex_init(&x->lock, NULL);
+               pthread_cond_init(&x->synced_cond, NULL);
+               x->flush_ms = x->sync_ms = LOGGING_DURABLE_US() / 1000;
+               x->policy = *policy;
+               LOGGING_ATOMIC_STORE_REL(&x->file, file);
+           }
+       }
+       if (x == NULL) {
+           return -1;
+       }
+       x->policy = *policy;
+       tick = policy->flush_ms > 0 ? policy->flush_ms : 0;
+       if (policy->sync_ms > 0 && (tick == 0 || policy->sync_ms < tick)) {
+           tick = policy->sync_ms;
+       }
+       if (tick == 0) {
+           return 0;
+       }
+       old = LOGGING_ATOMIC_LOAD(&logging_durability_tick);
+       while ((old == 0 || tick < old)
+              && !LOGGING_ATOMIC_CAS(&logging_durability_tick, &old, tick));
+       if (old == 0 && pthread_create(&tid, NULL, LOGGING_DURABLE_TICKER,
+                                      NULL) == 0) {
+           pthread_detach(tid);
+       }
+       return 0;
+   }
+   )
+   /* Copy the counters of file, return -1 if it has no policy. */
+   LOGGING_FUNC_DEF(
+   int logging_durability_stats(FILE *file, logging_durability_stats_t *out),
+   {
+       log_durable_t *x = LOGGING_DURABLE_FIND(file);
+       if (x == NULL) {
+           return -1;
+       }
+       pthread_mutex_lock(&x->lock);
+       *out = x->stats;
+       out->flushes = LOGGING_ATOMIC_LOAD(&x->stats.flushes);
+       out->flush_us = LOGGING_ATOMIC_LOAD(&x->stats.flush_us);
+       pthread_mutex_unlock(&x->lock);
+       return 0;
+   }
+   )
+# else
+#  define LOGGING_DURABLE_RECORD(dir, level, len)
+#  define LOGGING_DURABLE_COMMIT()
+# endif
+
+/******************************************************************************/
+// Logging Thread Buffer
+/******************************************************************************/
+/*
+  Synchronous writes without a writer thread nor a lock per record: each
+  thread appends its records to a buffer of its own, which goes to the
+  direction in one locked write when it is full, when its oldest record is
+  LOGGING_CONF_THREAD_BUFFER_MS old, when a record at or above
+  LOGGING_CONF_THREAD_BUFFER_LEVEL comes, when the direction changes, at
+  thread exit and at exit. A flush, and the linger ticker every
+  LOGGING_CONF_THREAD_BUFFER_MS, also take the stale buffers of threads
+  which stopped logging, each under the lock of the module which filled
+  it. Buffers are never freed, a thread reuses the one of an exited
+  thread.
+*/
+# ifdef LOGGING_CONF_THREAD_BUFFER
+#  if !defined(__unix__) && !defined(__APPLE__)
+#   error LOGGING_CONF_THREAD_BUFFER needs POSIX threads
+#  endif
+#  ifdef LOGGING_LOG_THREAD
+#   error LOGGING_CONF_THREAD_BUFFER replaces LOGGING_LOG_THREAD
+#  endif
+#  ifdef LOGGING_CONF_SYSLOG
+#   error LOGGING_CONF_SYSLOG batches its datagrams by itself
+#  endif
+#  include <pthread.h>
+#  include <sched.h>
+#  include <sys/time.h>
+#  ifndef LOGGING_CONF_THREAD_BUFFER_SIZE
+#   define LOGGING_CONF_THREAD_BUFFER_SIZE (16*1024)
+#  endif
+#  ifndef LOGGING_CONF_THREAD_BUFFER_MS
+#   define LOGGING_CONF_THREAD_BUFFER_MS 200
+#  endif
+#  ifndef LOGGING_CONF_THREAD_BUFFER_LEVEL
+#   define LOGGING_CONF_THREAD_BUFFER_LEVEL LOGGING_WARN_LEVEL
+#  endif
+   typedef struct log_thread_buffer
+   {
+       struct log_thread_buffer *next; // every buffer
+       int busy; // its thread appending or anyone flushing
+       int dead; // its thread exited
+       void (*flush)(struct log_thread_buffer *b); // of its module, b busy
+       struct log_direction d;
+       const struct log_config *config;
+       int level; // the most severe of the records
+       int64_t first; // ms of the oldest record
+       size_t used;
+       char buf[LOGGING_CONF_THREAD_BUFFER_SIZE];
+   } log_thread_buffer_t;
+   LOGGING_GLOBAL log_thread_buffer_t *logging_thread_buffers;
+   LOGGING_GLOBAL LOGGING_THREAD_LOCAL log_thread_buffer_t *logging_thread_buffer;
+   LOGGING_GLOBAL pthread_key_t logging_thread_buffer_key;
+   LOGGING_GLOBAL int logging_thread_buffer_init; // 1 initializing, 2 done
+   LOGGING_GLOBAL log_linger_t logging_thread_buffer_ticker;
+#  define LOGGING_THREAD_BUFFER_NOW(now) do \
+   { \
+       struct timeval _tv; \
+       gettimeofday(&_tv, NULL); \
+       now = (int64_t)_tv.tv_sec * 1000 + _tv.tv_usec / 1000; \
+   } while (0)
+   LOGGING_FUNC_DEF(
+   int LOGGING_THREAD_BUFFER_TRY(log_thread_buffer_t *b),
+   {
+       int idle = 0;
+       return LOGGING_ATOMIC_CAS(&b->busy, &idle, 1);
+   }
+   )
+/// exit
+   LOGGING_FUNC_DEF(
+   void LOGGING_THREAD_BUFFER_EXIT(void *p),
+   {
+       log_thread_buffer_t *b = (log_thread_buffer_t *)p;
+       while (!LOGGING_THREAD_BUFFER_TRY(b)) {
+           sched_yield();
+       }
+       if (b->used) {
+           b->flush(b);
+       }
+       logging_thread_buffer = NULL; // a later record takes a new one
+       LOGGING_ATOMIC_STORE_REL(&b->busy, 0);
+       LOGGING_ATOMIC_STORE_REL(&b->dead, 1);
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_THREAD_BUFFER_ATEXIT(void),
+   {
+       log_thread_buffer_t *b = LOGGING_ATOMIC_LOAD_ACQ(&logging_thread_buffers);
+       for (; b; b = b->next) {
+           int i = 0;
+           while (!LOGGING_THREAD_BUFFER_TRY(b) && ++i < 1000) {
+               sched_yield(); // a thread still logging, do not wait forever
+           }
+           if (i < 1000) {
+               if (b->used) {
+                   b->flush(b);
+               }
+               LOGGING_ATOMIC_STORE_REL(&b->busy, 0);
+           }
+       }
+   }
+   )
+/// stale
+   /* Flush the buffers with a record older than the linger, if not busy. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_THREAD_BUFFER_DUE(void *dir, int64_t now),
+   {
+       log_thread_buffer_t *b;
+       (void)dir;
+       b = LOGGING_ATOMIC_LOAD_ACQ(&logging_thread_buffers);
+       for (; b; b = b->next) {
+           if (LOGGING_ATOMIC_LOAD(&b->used)
+               && now - b->first >= LOGGING_CONF_THREAD_BUFFER_MS
+               && LOGGING_THREAD_BUFFER_TRY(b)) {
+               if (b->used) {
+                   b->flush(b);
+               }
+               LOGGING_ATOMIC_STORE_REL(&b->busy, 0);
+           }
+       }
+   }
+   )
+/// new
+   /* The buffer of the calling thread. */
+   LOGGING_FUNC_DEF(
+   log_thread_buffer_t *LOGGING_THREAD_BUFFER_NEW(void),
+   {
+       log_thread_buffer_t *b;
+       int state = 0, dead;
+       if (LOGGING_ATOMIC_CAS(&logging_thread_buffer_init, &state, 1)) {
+           pthread_key_create(&logging_thread_buffer_key,
+                              LOGGING_THREAD_BUFFER_EXIT);
+           atexit(LOGGING_THREAD_BUFFER_ATEXIT);
+           logging_thread_buffer_ticker.due = LOGGING_THREAD_BUFFER_DUE;
+           LOGGING_LINGER_REGISTER(&logging_thread_buffer_ticker,
+                                   LOGGING_CONF_THREAD_BUFFER_MS);
+           LOGGING_ATOMIC_STORE_REL(&logging_thread_buffer_init, 2);
+       }
+       while (LOGGING_ATOMIC_LOAD_ACQ(&logging_thread_buffer_init) != 2) {
+           sched_yield();
+       }
+       for (b = LOGGING_ATOMIC_LOAD_ACQ(&logging_thread_buffers); b;
+            b = b->next) {
+           dead = 1;
+           if (LOGGING_ATOMIC_CAS(&b->dead, &dead, 0)) {
+               break;
+           }
+       }
+       if (b == NULL) {
+           if ((b = (log_thread_buffer_t *)calloc(1, sizeof(*b))) == NULL) {
+               return NULL;
+           }
+           b->next = LOGGING_ATOMIC_LOAD(&logging_thread_buffers);
+           while (!LOGGING_ATOMIC_CAS(&logging_thread_buffers, &b->next, b));
+       }
+       pthread_setspecific(logging_thread_buffer_key, b);
+       return logging_thread_buffer = b;
+   }
+   )
+/// write
+   /* Write b to its direction(s), under LOGGING_LOCK. */
+   static inline void LOGGING_THREAD_BUFFER_WRITE(log_thread_buffer_t *b)
+   {
+       struct log_direction *dir;
+       LOGGING_INDEX_RECORD(b->d.dir, b->used);
+       LOGGING_DIR_RECORD(b->level);
+       b->d.write(b->d.dir, b->buf, b->used);
+       LOGGING_DURABLE_RECORD(b->d.dir, b->level, b->used);
+       LOGGING_DIR_ROLLBACK(&b->d, LOGGING_CONFIG_MAX_SIZE(b));
+       for (dir = b->d.next; dir; dir = dir->next) {
+           dir->write(dir->dir, b->buf, b->used);
+           LOGGING_DURABLE_RECORD(dir->dir, b->level, b->used);
+       }
+       LOGGING_CONFIG_UNHOLD(b->config);
+       b->config = NULL;
+       b->used = 0;
+   }
+   /* Write b, which is busy, under the lock of this module. */
+   static inline void LOGGING_THREAD_BUFFER_LOCKED(log_thread_buffer_t *b)
+   {
+       LOGGING_STATS_BEGIN(_t);
+       LOGGING_LOCK();
+       LOGGING_STATS_END(LOGGING_STATS_LOCK, _t);
+       if (b->used) {
+           LOGGING_THREAD_BUFFER_WRITE(b);
+       }
+       LOGGING_UNLOCK();
+       LOGGING_DURABLE_COMMIT();
+   }
+   /* Flush b, which is busy, and the buffers other threads left stale. */
+   static inline void LOGGING_THREAD_BUFFER_FLUSH(log_thread_buffer_t *b)
+   {
+       int64_t now;
+       LOGGING_THREAD_BUFFER_NOW(now);
+       if (b->used) {
+           b->flush(b);
+       }
+       LOGGING_THREAD_BUFFER_DUE(NULL, now);
+   }
+/// append
+   /*
+     Append r to the buffer of the calling thread, return 0 if r does not
+     fit in any buffer and has to be written as it is.
+   */
+   static inline int LOGGING_THREAD_BUFFER_APPEND(log_record_t *r)
+   {
+       log_thread_buffer_t *b = logging_thread_buffer;
+       char *m = r->message_buf;
+       size_t len = (size_t)r->message_len;
+       int64_t now;
+       int mixed = 0; // directions not all colored, or none
+#  ifdef LOGGING_LOG_COLOR
+       struct log_direction *dir;
+       int colored;
+#  endif
+       if (b == NULL
+           && (b = LOGGING_THREAD_BUFFER_NEW()) == NULL) {
+           return 0;
+       }
+       while (!LOGGING_THREAD_BUFFER_TRY(b)) { // taken by a stale flush
+           sched_yield();
+       }
+#  ifdef LOGGING_LOG_COLOR
+       /*
+         The same bytes go to every direction: colored if they all are
+         terminals, else written as it is, colored per direction.
+       */
+       colored = LOGGING_DIR_COLORED(r->d.dir);
+       for (dir = r->d.next; dir && !mixed; dir = dir->next) {
+           mixed = LOGGING_DIR_COLORED(dir->dir) != colored;
+       }
+       if (colored) { // at most, if the color fits the record
+           len += strlen(LOGGING_LEVEL_COLOR(r->level))
+                + sizeof(LOGGING_CLEAR_COLOR) - 1;
+       }
+#  endif
+       if (b->used && (mixed || b->used + len > sizeof(b->buf)
+           || b->d.dir != r->d.dir || b->d.write != r->d.write
+           || b->d.next != r->d.next || b->config != r->config)) {
+           LOGGING_THREAD_BUFFER_FLUSH(b);
+       }
+       if (mixed || len > sizeof(b->buf)) {
+           LOGGING_ATOMIC_STORE_REL(&b->busy, 0);
+           return 0;
+       }
+#  ifdef LOGGING_LOG_COLOR
+       len = (size_t)r->message_len;
+       if (colored && (colored = (int)LOGGING_RECORD_COLOR(r,
+                           LOGGING_LEVEL_COLOR(r->level), &m)) > 0) {
+           m = r->message_buf;
+           len = (size_t)colored;
+       }
+#  endif
+       LOGGING_THREAD_BUFFER_NOW(now);
+       if (b->used == 0) {
+           b->flush = LOGGING_THREAD_BUFFER_LOCKED;
+           b->d = r->d;
+           b->config = r->config;
+           LOGGING_CONFIG_HOLD(b->config); // past the record
+           b->level = r->level;
+           b->first = now;
+       }
+       b->level = r->level < b->level ? r->level : b->level;
+       memcpy(b->buf + b->used, m, len);
+       LOGGING_ATOMIC_STORE(&b->used, b->used + len);
+       if (r->level <= LOGGING_CONF_THREAD_BUFFER_LEVEL
+           || now - b->first >= LOGGING_CONF_THREAD_BUFFER_MS) {
+           LOGGING_THREAD_BUFFER_FLUSH(b);
+       }
+       LOGGING_ATOMIC_STORE_REL(&b->busy, 0);
+       return 1;
+   }
+   /* Write what the calling thread has buffered now. */
+   static inline void logging_thread_flush(void)
+   {
+       log_thread_buffer_t *b = logging_thread_buffer;
+       if (b) {
+           while (!LOGGING_THREAD_BUFFER_TRY(b)) {
+               sched_yield();
+           }
+           LOGGING_THREAD_BUFFER_FLUSH(b);
+           LOGGING_ATOMIC_STORE_REL(&b->busy, 0);
+       }
+   }
+# endif
+
+/******************************************************************************/
+// Logging Threading
+/******************************************************************************/
+# ifdef LOGGING_LOG_THREAD
+#  ifndef LOGGING_LOG_RECORD_LIST
+#   error You need to define a log_record_t * as LOGGING_LOG_RECORD_LIST
+#  else
+    extern log_record_t *LOGGING_LOG_RECORD_LIST;
+#  endif
+#  ifndef LOGGING_LOG_LOCKING
+#   error You need to enable LOGGING_LOG_LOCKING
+#  endif
+/// send record to process thread
+#  define LOGGING_WRITE_RECORD(r) do \
+   { \
+       LOGGING_METRICS_RECORD(r); \
+       LOGGING_CONFIG_HOLD((r)->config); /* freed by the thread loop */ \
+       LOGGING_CONFIG_RELEASE((r)->config); \
+       LOGGING_STATS_BEGIN(_t); \
+       LOGGING_LOCK(); \
+       LOGGING_STATS_END(LOGGING_STATS_LOCK, _t); \
+       LOGGING_STATS_STAMP(r); \
+       if (LOGGING_LOG_RECORD_LIST == NULL) { \
+           (r)->next = (r); \
+           (r)->prev = (r); \
+       } \
+       else { \
+           (r)->next = LOGGING_LOG_RECORD_LIST; \
+           LOGGING_LOG_RECORD_LIST->prev->next = (r); \
+           (r)->prev = LOGGING_LOG_RECORD_LIST->prev; \
+           LOGGING_LOG_RECORD_LIST->prev = (r); \
+       } \
+       LOGGING_LOG_RECORD_LIST = (r); \
+       LOGGING_UNLOCK(); \
+   } while (0)
+#  define LOGGING_MALLOC(ptr, size) ptr = (log_record_t*)malloc(size);
+#  define LOGGING_FREE(ptr) do \
+   { \
+       LOGGING_CONFIG_UNHOLD((ptr)->config); \
+       if ((ptr)->message_buf != &((ptr)->message)) { \
+           free((ptr)->message_buf); \
+       } \
+       free(ptr); \
+   } while (0)
+#  define LOGGING_RECORD_HEAP 1
+/// process thread body
+#  define LOGGING_THREAD_LOOP(record_list) do \
+   { \
+       log_record *tail_record; \
+       int _more; \
+       LOGGING_LOCK(); \
+       if ((record_list) == NULL) { \
+           LOGGING_UNLOCK(); \
+           break; \
+       } \
+       tail_record = (record_list)->prev; \
+       tail_record->prev->next = (record_list); \
+       (record_list)->prev = tail_record->prev; \
+       tail_record->next = NULL; \
+       tail_record->prev = NULL; \
+       if ((record_list)->next == NULL && (record_list)->prev == NULL) { \
+           (record_list) = NULL; \
+       } \
+       _more = (record_list) != NULL; \
+       LOGGING_UNLOCK(); \
+       LOGGING_DIR_MORE(_more); \
+       LOGGING_STATS_END(LOGGING_STATS_QUEUE, tail_record->stamp); \
+       LOGGING_BTRC_SYMBOLIZE(tail_record); \
+       LOGGING_RECORD_WRITE(tail_record); \
+       LOGGING_DURABLE_COMMIT(); \
+       LOGGING_FREE(tail_record); \
+       (void)_more; \
+   } while (0)
+# elif defined(LOGGING_CONF_THREAD_BUFFER)
+/// append to the thread's buffer, or directly write a record too long for it
+#  define LOGGING_WRITE_RECORD(log_record) do \
+   { \
+       LOGGING_METRICS_RECORD(log_record); \
+       LOGGING_BTRC_SYMBOLIZE(log_record); \
+       if (!LOGGING_THREAD_BUFFER_APPEND(log_record)) { \
+           LOGGING_STATS_BEGIN(_t); \
+           LOGGING_LOCK(); \
+           LOGGING_STATS_END(LOGGING_STATS_LOCK, _t); \
+           LOGGING_RECORD_WRITE(log_record); \
+           LOGGING_UNLOCK(); \
+           LOGGING_DURABLE_COMMIT(); \
+       } \
+       LOGGING_FREE(log_record); \
+   } while (0)
+#  define LOGGING_MALLOC(ptr, size) \
+   log_record_t mem[((size)+sizeof(log_record_t)-1)/sizeof(log_record_t)]; \
+   ptr = mem
+#  define LOGGING_FREE(ptr) do \
+   { \
+       LOGGING_CONFIG_RELEASE((ptr)->config); \
+       if ((ptr)->message_buf != &((ptr)->message)) { \
+           LOGGING_RECORD_SPILL(0); \
+       } \
+   } while (0)
+#  define LOGGING_RECORD_HEAP 0
+#  define LOGGING_THREAD_LOOP(dummy)
+# else
+/// directly write
+#  define LOGGING_WRITE_RECORD(log_record) do \
+   { \
+       LOGGING_METRICS_RECORD(log_record); \
+       LOGGING_BTRC_SYMBOLIZE(log_record); \
+       LOGGING_STATS_BEGIN(_t); \
+       LOGGING_LOCK(); \
+       LOGGING_STATS_END(LOGGING_STATS_LOCK, _t); \
+       LOGGING_RECORD_WRITE(log_record); \
+       LOGGING_UNLOCK(); \
+       LOGGING_DURABLE_COMMIT(); \
+       LOGGING_FREE(log_record); \
+   } while (0)
+#  define LOGGING_MALLOC(ptr, size) \
+   log_record_t mem[((size)+sizeof(log_record_t)-1)/sizeof(log_record_t)]; \
+   ptr = mem
+#  define LOGGING_FREE(ptr) do \
+   { \
+       LOGGING_CONFIG_RELEASE((ptr)->config); \
+       if ((ptr)->message_buf != &((ptr)->message)) { \
+           LOGGING_RECORD_SPILL(0); \
+       } \
+   } while (0)
+#  define LOGGING_RECORD_HEAP 0
+#  define LOGGING_THREAD_LOOP(dummy)
+# endif
+
+/******************************************************************************/
+// Dynamic Logging Level
+/******************************************************************************/
+/*
+  The level of a module comes from the configuration file's or else the
+  LOGGING_LEVELS rules, e.g.
+  "*=2,net.*=4,net.tcp=3", where the most specific rule wins, or else from
+  LOGGING_LOG_LEVEL; <module>_LOGGING_LOG_LEVEL can only lower it. It is
+  resolved the first time the module logs and cached in a per module slot,
+  later checks are a single load whatever the number of rules.
+*/
+# if defined(LOGGING_CONF_DYNAMIC_LOG_LEVEL) || defined(LOGGING_AS_SOURCE)
+#  ifndef LOGGING_CONF_LEVEL_RULES
+#   define LOGGING_CONF_LEVEL_RULES 64
+#  endif
+typedef struct log_level_rule
+{
+    char name[64]; // "*", "net.*" or "net.tcp"
+    int level;
+} log_level_rule_t;
+typedef struct log_levels
+{
+    int count;
+    log_level_rule_t rule[LOGGING_CONF_LEVEL_RULES];
+} log_levels_t;
+typedef struct log_module
+{
+    const char *name;
+    int level; // -1 until resolved
+    int registered;
+    struct log_module *next;
+} log_module_t;
+   LOGGING_GLOBAL log_levels_t *logging_levels;
+   LOGGING_GLOBAL log_module_t *logging_modules;
+   LOGGING_FUNC_DEF(
+   int LOGGING_LEVEL_VALUE(const char *s, size_t len),
+   {
+       const char *names[] = { "off", "error", "warn", "info", "debug" };
+       for (int i = 0; i < 5; ++i) {
+           if (strlen(names[i]) == len && strncmp(names[i], s, len) == 0) {
+               return i;
+           }
+       }
+       return (len > 0 && s[0] >= '0' && s[0] <= '9') ? atoi(s) : -1;
+   }
+   )
+   /* Parse "name=level,..." into malloced rules, NULL on a bad spec. */
+   LOGGING_FUNC_DEF(
+   log_levels_t *logging_levels_parse(const char *spec),
+   {
+       log_levels_t *ls = (log_levels_t *)calloc(1, sizeof(log_levels_t));
+       const char *p = spec, *eq, *end;
+       while (ls && *p) {
+           log_level_rule_t *rule = &ls->rule[ls->count];
+           while (*p == ',' || *p == ' ') {
+               ++p;
+           }
+           if (*p == '\0') {
+               break;
+           }
+           end = p + strcspn(p, ", ");
+           eq = (const char *)memchr(p, '=', (size_t)(end - p));
+           if (eq == NULL || eq == p || (size_t)(eq - p) >= sizeof(rule->name)
+               || ls->count == LOGGING_CONF_LEVEL_RULES
+               || (rule->level = LOGGING_LEVEL_VALUE(eq+1,
+                       (size_t)(end-eq-1))) < 0) {
+               free(ls);
+               return NULL;
+           }
+           memcpy(rule->name, p, (size_t)(eq - p));
+           rule->name[eq - p] = '\0';
+           ++ls->count;
+           p = end;
+       }
+       return ls;
+   }
+   )
+   /*
+     The level of the most specific rule for name, -1 if none. "net.*"
+     covers net and everything under it, "net.tcp" only itself and beats
+     "net.*", "*" covers all; the later of two equal rules wins.
+   */
+   LOGGING_FUNC_DEF(
+   int logging_levels_lookup(const log_levels_t *ls, const char *name),
+   {
+       int level = -1, best = -1;
+       for (int i = 0; ls && i < ls->count; ++i) {
+           const char *rule = ls->rule[i].name;
+           size_t len = strlen(rule);
+           int score = -1;
+           if (strcmp(rule, "*") == 0) {
+               score = 0;
+           }
+           else if (len >= 2 && strcmp(rule+len-2, ".*") == 0) {
+               if (strncmp(rule, name, len-2) == 0
+                   && (name[len-2] == '\0' || name[len-2] == '.')) {
+                   score = (int)len * 2;
+               }
+           }
+           else if (strcmp(rule, name) == 0) {
+               score = (int)len * 2 + 1;
+           }
+           if (score >= best && score >= 0) {
+               best = score;
+               level = ls->rule[i].level;
+           }
+       }
+       return level;
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int LOGGING_MODULE_RESOLVE(log_module_t *m),
+   {
+       log_levels_t *ls = LOGGING_ATOMIC_LOAD_ACQ(&logging_levels), *none;
+       const log_config_t *cfg = LOGGING_CONFIG();
+       const char *env;
+       char key[128];
+       int level, registered = 0;
+       if (cfg && cfg->levels) { // the configuration file's rules
+           ls = cfg->levels;
+       }
+       else if (ls == NULL && (env = getenv("LOGGING_LEVELS")) != NULL) {
+           if ((ls = logging_levels_parse(env)) != NULL) {
+               none = NULL;
+               if (!LOGGING_ATOMIC_CAS(&logging_levels, &none, ls)) {
+                   free(ls); // parsed by another thread
+                   ls = none;
+               }
+           }
+       }
+       if ((level = logging_levels_lookup(ls, m->name)) < 0) {
+           env = getenv("LOGGING_LOG_LEVEL");
+           level = env ? atoi(env) : LOGGING_DEBUG_LEVEL;
+       }
+       if (m->name[0]) {
+           snprintf(key, sizeof(key), "%s_LOGGING_LOG_LEVEL", m->name);
+           if ((env = getenv(key)) != NULL && atoi(env) < level) {
+               level = atoi(env);
+           }
+       }
+       if (LOGGING_ATOMIC_CAS(&m->registered, &registered, 1)) {
+           m->next = LOGGING_ATOMIC_LOAD(&logging_modules);
+           while (!LOGGING_ATOMIC_CAS(&logging_modules, &m->next, m));
+       }
+       LOGGING_ATOMIC_STORE(&m->level, level);
+       LOGGING_CONFIG_RELEASE(cfg);
+       return level;
+   }
+   )
+# endif
+# ifdef LOGGING_CONF_DYNAMIC_LOG_LEVEL
+   /* The level of this translation unit's module. */
+   static inline int LOGGING_MODULE_LEVEL(void)
+   {
+       static log_module_t module = { LOGGING_MODULE_NAME, -1, 0, NULL };
+       int level = LOGGING_ATOMIC_LOAD(&module.level);
+       return level >= 0 ? level : LOGGING_MODULE_RESOLVE(&module);
+   }
+#  define LOGGING_DYNAMIC_LOG_LEVEL_CHECK(l) \
+   if (LOGGING_MODULE_LEVEL() < (l)) { \
+       LOGGING_METRICS_ADD(l, LOGGING_METRICS_FILTERED, 1); \
+       break; \
+   }
+# else
+#  define LOGGING_DYNAMIC_LOG_LEVEL_CHECK(l)
+# endif
+
+/******************************************************************************/
+// Logging Configuration Reload
+/******************************************************************************/
+/*
+  A configuration file of "key = value" lines, '#' starting a comment:
+    levels = *=info,net.*=debug    rules as in LOGGING_LEVELS
+    format = LVFG TIME MODU        needs LOGGING_CONF_DYNAMIC_LOG_FORMAT
+    file = /var/log/app.log        or stdout, stderr
+    max_size = 64M                 rollback limit, K, M or G suffixed
+  is parsed and validated as a whole, then published with one release store.
+  A record takes the pointer once, so it sees either the old or the new
+  configuration and never a lock. It publishes the configuration it took in
+  its thread's slot, which only a reload reads, and a record queued to the
+  log thread or a thread buffer counts itself in it. A replaced one is
+  freed, and its file closed, by a later reload or the watch thread once no
+  slot nor count holds it anymore.
+*/
+# ifdef LOGGING_CONF_RELOAD
+#  if !defined(__unix__) && !defined(__APPLE__)
+#   error LOGGING_CONF_RELOAD needs POSIX signals and threads
+#  endif
+#  include <ctype.h>
+#  include <errno.h>
+#  include <signal.h>
+#  include <poll.h>
+#  include <pthread.h>
+#  include <sched.h>
+#  include <unistd.h>
+#  ifdef LOGGING_CONF_INDEX
+#   define LOGGING_CONFIG_INDEX(file, path) logging_index_attach(file, path)
+#   define LOGGING_CONFIG_UNINDEX(file) logging_index_detach(file)
+#  else
+#   define LOGGING_CONFIG_INDEX(file, path)
+#   define LOGGING_CONFIG_UNINDEX(file)
+#  endif
+#  ifndef LOGGING_CONF_RELOAD_RECLAIM_MS
+#   define LOGGING_CONF_RELOAD_RECLAIM_MS 1000 // retry freeing replaced ones
+#  endif
+/*
+  Where the kernel can have every thread of the process pass a barrier, a
+  reload does it between publishing and reading the slots, so that a
+  record orders its slot before the pointer with a compiler barrier only.
+*/
+#  if defined(__linux) && defined(__GNUC__)
+#   include <sys/syscall.h>
+#   if defined(__GLIBC__) && !defined(__USE_MISC)
+     extern long syscall(long, ...); // hidden by strict iso mode
+#   endif
+#  endif
+#  if defined(__linux) && defined(__GNUC__) && defined(SYS_membarrier)
+#   define LOGGING_MEMBARRIER_EXPEDITED (1 << 3) // CMD_PRIVATE_EXPEDITED
+#   define LOGGING_MEMBARRIER_REGISTER (1 << 4) // and its REGISTER, Linux 4.14
+#   define LOGGING_CONFIG_BARRIER_INIT() \
+    (syscall(SYS_membarrier, LOGGING_MEMBARRIER_REGISTER, 0) == 0 ? 1 : -1)
+#   define LOGGING_CONFIG_BARRIER() do \
+   { \
+       if (LOGGING_ATOMIC_LOAD(&logging_config_barrier) > 0) { \
+           (void)syscall(SYS_membarrier, LOGGING_MEMBARRIER_EXPEDITED, 0); \
+       } \
+       else { \
+           LOGGING_ATOMIC_FENCE(); \
+       } \
+   } while (0)
+#   define LOGGING_CONFIG_READ_BARRIER() do \
+   { \
+       if (LOGGING_ATOMIC_LOAD(&logging_config_barrier) > 0) { \
+           __atomic_signal_fence(__ATOMIC_SEQ_CST); \
+       } \
+       else { \
+           LOGGING_ATOMIC_FENCE(); \
+       } \
+   } while (0)
+#  else
+#   define LOGGING_CONFIG_BARRIER_INIT() (-1)
+#   define LOGGING_CONFIG_BARRIER() LOGGING_ATOMIC_FENCE()
+#   define LOGGING_CONFIG_READ_BARRIER() LOGGING_ATOMIC_FENCE()
+#  endif
+   LOGGING_GLOBAL int logging_config_loading; // serializes reloads
+   /* 1 with the process barrier, -1 without, set before the first load. */
+   LOGGING_GLOBAL int logging_config_barrier;
+/// acquire
+   LOGGING_GLOBAL pthread_key_t logging_config_slot_key;
+   LOGGING_GLOBAL int logging_config_slot_init; // 1 initializing, 2 done
+   LOGGING_FUNC_DEF(
+   void LOGGING_CONFIG_SLOT_EXIT(void *p),
+   {
+       log_config_slot_t *s = (log_config_slot_t *)p;
+       LOGGING_ATOMIC_STORE(&s->held, NULL);
+       s->nesting = 0;
+       logging_config_slot = NULL; // a later record takes a new one
+       LOGGING_ATOMIC_STORE_REL(&s->dead, 1);
+   }
+   )
+   /* The slot of the calling thread, one of an exited thread if any. */
+   LOGGING_FUNC_DEF(
+   log_config_slot_t *LOGGING_CONFIG_SLOT(void),
+   {
+       log_config_slot_t *s;
+       int state = 0, dead;
+       if (LOGGING_ATOMIC_CAS(&logging_config_slot_init, &state, 1)) {
+           pthread_key_create(&logging_config_slot_key,
+                              LOGGING_CONFIG_SLOT_EXIT);
+           LOGGING_ATOMIC_STORE_REL(&logging_config_slot_init, 2);
+       }
+       while (LOGGING_ATOMIC_LOAD_ACQ(&logging_config_slot_init) != 2) {
+           sched_yield();
+       }
+       for (s = LOGGING_ATOMIC_LOAD_ACQ(&logging_config_slots); s;
+            s = s->next) {
+           dead = 1;
+           if (LOGGING_ATOMIC_CAS(&s->dead, &dead, 0)) {
+               break;
+           }
+       }
+       if (s == NULL) {
+           if ((s = (log_config_slot_t *)calloc(1, sizeof(*s))) == NULL) {
+               return NULL;
+           }
+           s->next = LOGGING_ATOMIC_LOAD(&logging_config_slots);
+           while (!LOGGING_ATOMIC_CAS(&logging_config_slots, &s->next, s));
+       }
+       pthread_setspecific(logging_config_slot_key, s);
+       return logging_config_slot = s;
+   }
+   )
+   /*
+     The current configuration, in the thread's slot until
+     LOGGING_CONFIG_RELEASE. The slot is stored before the pointer is read
+     again, which a reload publishes before it reads the slots, so either
+     the reload sees the slot or the record a newer pointer. A record built
+     while another one is, by its arguments, takes that one's. Without
+     memory for a slot, it's the environment's.
+   */
+   LOGGING_FUNC_DEF(
+   const log_config_t *LOGGING_CONFIG_ACQUIRE(void),
+   {
+       log_config_slot_t *s = logging_config_slot;
+       const log_config_t *cfg;
+       if (s == NULL && (s = LOGGING_CONFIG_SLOT()) == NULL) {
+           return NULL;
+       }
+       if (s->nesting++) {
+           return s->held;
+       }
+       for (;;) {
+           cfg = LOGGING_ATOMIC_LOAD_ACQ(&logging_config);
+           LOGGING_ATOMIC_STORE(&s->held, cfg);
+           LOGGING_CONFIG_READ_BARRIER(); // the slot before the pointer again
+           if (LOGGING_ATOMIC_LOAD_ACQ(&logging_config) == cfg) {
+               return cfg;
+           }
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_CONFIG_LEAVE(void),
+   {
+       log_config_slot_t *s = logging_config_slot;
+       if (s && s->nesting > 0 && --s->nesting == 0) {
+           LOGGING_ATOMIC_STORE_REL(&s->held, NULL);
+       }
+   }
+   )
+/// parse
+   LOGGING_FUNC_DEF(
+   char *LOGGING_CONFIG_TRIM(char *s),
+   {
+       char *end = s + strlen(s);
+       while (isspace((unsigned char)*s)) {
+           ++s;
+       }
+       while (end > s && isspace((unsigned char)end[-1])) {
+           *--end = '\0';
+       }
+       return s;
+   }
+   )
+   LOGGING_FUNC_DEF(
+   long LOGGING_CONFIG_SIZE(const char *s),
+   {
+       const char *units = "KMG", *u;
+       char *end;
+       long size = strtol(s, &end, 10);
+       if (*end && (u = strchr(units, toupper((unsigned char)*end))) != NULL) {
+           for (long i = 0; i <= u - units; ++i) {
+               size *= 1024;
+           }
+           ++end;
+       }
+       return size > 0 && *end == '\0' ? size : -1;
+   }
+   )
+#  ifdef LOGGING_CONF_DYNAMIC_LOG_FORMAT
+   /* Whether every name of s is a format a record of this build knows. */
+   LOGGING_FUNC_DEF(
+   int LOGGING_CONFIG_FORMAT_VALID(const char *s),
+   {
+       log_logger_t _l, *l = &_l;
+       size_t len;
+       LOGGING_INIT_LOGGER(l, LOGGING_DEBUG_LEVEL); // builtin and custom
+       for (; *s; s += len + (s[len] == ' ')) {
+           len = strcspn(s, " ");
+           if (len != 4 || LOGGING_LOGGER_GET_FORMAT(l, s) == NULL) {
+               return 0;
+           }
+       }
+       return 1;
+   }
+   )
+#  else
+#   define LOGGING_CONFIG_FORMAT_VALID(s) 0
+#  endif
+   /* Parses and validates path into a new configuration, NULL on error. */
+   LOGGING_FUNC_DEF(
+   log_config_t *logging_config_parse(const char *path,
+                                      const log_config_t *old),
+   {
+       log_config_t *cfg;
+       FILE *f = fopen(path, "r");
+       char line[512], *key, *value, *eq;
+       int no = 0, bad = 0;
+       if (f == NULL) {
+           fprintf(stderr, "logging: %s: cannot open\n", path);
+           return NULL;
+       }
+       if ((cfg = (log_config_t *)calloc(1, sizeof(log_config_t))) == NULL) {
+           fclose(f);
+           return NULL;
+       }
+       while (!bad && fgets(line, sizeof(line), f)) {
+           ++no;
+           line[strcspn(line, "#\r\n")] = '\0';
+           key = LOGGING_CONFIG_TRIM(line);
+           if (*key == '\0') {
+               continue;
+           }
+           if ((eq = strchr(key, '=')) == NULL) {
+               bad = 1;
+               break;
+           }
+           *eq = '\0';
+           key = LOGGING_CONFIG_TRIM(key);
+           value = LOGGING_CONFIG_TRIM(eq + 1);
+           if (strcmp(key, "levels") == 0) {
+               free(cfg->levels);
+               bad = (cfg->levels = logging_levels_parse(value)) == NULL;
+           }
+           else if (strcmp(key, "format") == 0) {
+               bad = strlen(value) >= sizeof(cfg->format)
+                  || !LOGGING_CONFIG_FORMAT_VALID(value);
+               strcpy(cfg->format, bad ? "" : value);
+           }
+           else if (strcmp(key, "file") == 0) {
+               bad = *value == '\0' || strlen(value) >= sizeof(cfg->path);
+               strcpy(cfg->path, bad ? "" : value);
+           }
+           else if (strcmp(key, "max_size") == 0) {
+               bad = (cfg->max_size = LOGGING_CONFIG_SIZE(value)) < 0;
+           }
+           else {
+               bad = 1;
+           }
+       }
+       fclose(f);
+       if (!bad && cfg->path[0]) {
+           if (strcmp(cfg->path, "stdout") == 0) {
+               cfg->file = stdout;
+           }
+           else if (strcmp(cfg->path, "stderr") == 0) {
+               cfg->file = stderr;
+           }
+           else if (old && old->file && strcmp(old->path, cfg->path) == 0) {
+               cfg->file = old->file;
+           }
+           else if ((cfg->file = fopen(cfg->path, "a")) == NULL) {
+               fprintf(stderr, "logging: %s: cannot open\n", cfg->path);
+               bad = 1;
+           }
+           else {
+               LOGGING_CONFIG_INDEX(cfg->file, cfg->path);
+           }
+       }
+       if (bad) {
+           if (no) {
+               fprintf(stderr, "logging: %s:%d: invalid setting\n", path, no);
+           }
+           free(cfg->levels);
+           free(cfg);
+           return NULL;
+       }
+       return cfg;
+   }
+   )
+/// reclaim
+   /* Free c, replaced and held by nothing, and close what only it used. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_CONFIG_FREE(const log_config_t *cur, log_config_t *c),
+   {
+       const log_config_t *o;
+       FILE *f = c->file;
+       for (o = cur; o && f; o = o->retired) { // shared with another one
+           if (o != c && o->file == f) {
+               f = NULL;
+           }
+       }
+       if (f && f != stdout && f != stderr) {
+           LOGGING_CONFIG_UNINDEX(f);
+           fclose(f);
+       }
+       free(c->levels);
+       free(c);
+   }
+   )
+   /*
+     Free the replaced configurations nothing holds anymore, with reloads
+     serialized. Return how many are still held.
+   */
+   /* Whether a slot or a count holds c. */
+   LOGGING_FUNC_DEF(
+   int LOGGING_CONFIG_HELD(const log_config_t *c),
+   {
+       const log_config_slot_t *s;
+       for (s = LOGGING_ATOMIC_LOAD_ACQ(&logging_config_slots); s;
+            s = s->next) {
+           if (LOGGING_ATOMIC_LOAD_ACQ(&s->held) == c) {
+               return 1;
+           }
+       }
+       return LOGGING_ATOMIC_LOAD_ACQ(&c->refs) != 0; // counted, then left
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int LOGGING_CONFIG_RECLAIM(void),
+   {
+       log_config_t *cur = LOGGING_ATOMIC_LOAD_ACQ(&logging_config), **p, *c;
+       int held = 0;
+       if (cur == NULL) {
+           return 0;
+       }
+       LOGGING_CONFIG_BARRIER(); // the publication before the slots
+       for (p = &cur->retired; (c = *p) != NULL; ) {
+           if (LOGGING_CONFIG_HELD(c)) {
+               p = &c->retired;
+               ++held;
+           }
+           else {
+               *p = c->retired;
+               LOGGING_CONFIG_FREE(cur, c);
+           }
+       }
+       return held;
+   }
+   )
+/// apply
+   /* Loads and applies path, the current configuration stays on error. */
+   LOGGING_FUNC_DEF(
+   int logging_config_load(const char *path),
+   {
+       log_config_t *old, *cfg;
+       int idle = 0;
+       while (!LOGGING_ATOMIC_CAS(&logging_config_loading, &idle, 1)) {
+           idle = 0;
+           sched_yield();
+       }
+       if (logging_config_barrier == 0) { // before anything is published
+           LOGGING_ATOMIC_STORE_REL(&logging_config_barrier,
+                                    LOGGING_CONFIG_BARRIER_INIT());
+       }
+       old = LOGGING_ATOMIC_LOAD_ACQ(&logging_config);
+       if ((cfg = logging_config_parse(path, old)) == NULL) {
+           LOGGING_ATOMIC_STORE_REL(&logging_config_loading, 0);
+           return -1;
+       }
+       cfg->retired = old;
+       cfg->generation = old ? old->generation + 1 : 1;
+       LOGGING_ATOMIC_STORE_REL(&logging_config, cfg);
+       if (old && old->file && old->file != cfg->file) {
+           fflush(old->file); // closed once no record holds it
+       }
+       for (log_module_t *m = LOGGING_ATOMIC_LOAD_ACQ(&logging_modules);
+            m; m = m->next) {
+           LOGGING_MODULE_RESOLVE(m);
+       }
+       LOGGING_CONFIG_RECLAIM();
+       LOGGING_ATOMIC_STORE_REL(&logging_config_loading, 0);
+       return 0;
+   }
+   )
+   /* Free the replaced configurations released since the last reload. */
+   LOGGING_FUNC_DEF(
+   int logging_config_reclaim(void),
+   {
+       int idle = 0, held;
+       if (!LOGGING_ATOMIC_CAS(&logging_config_loading, &idle, 1)) {
+           return 1; // a reload does it
+       }
+       held = LOGGING_CONFIG_RECLAIM();
+       LOGGING_ATOMIC_STORE_REL(&logging_config_loading, 0);
+       return held;
+   }
+   )
+/// watch
+#  if defined(__linux__)
+#   include <sys/inotify.h>
+   LOGGING_FUNC_DEF(
+   int LOGGING_CONFIG_NOTIFY(const char *path),
+   {
+       char dir[256] = ".";
+       const char *slash = strrchr(path, '/');
+       int fd;
+       if (slash && (size_t)(slash - path) < sizeof(dir)) {
+           memcpy(dir, path, (size_t)(slash - path));
+           dir[slash == path ? 1 : slash - path] = '\0';
+       }
+       if ((fd = inotify_init()) >= 0
+           && inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+           close(fd);
+           fd = -1;
+       }
+       return fd;
+   }
+   )
+   /* Whether the events pending on fd touched the file of path. */
+   LOGGING_FUNC_DEF(
+   int LOGGING_CONFIG_CHANGED(int fd, const char *path),
+   {
+       union {
+           struct inotify_event e;
+           char buf[4096];
+       } u;
+       const char *base = strrchr(path, '/');
+       ssize_t n = read(fd, u.buf, sizeof(u.buf));
+       int changed = 0;
+       base = base ? base + 1 : path;
+       for (ssize_t off = 0; off + (ssize_t)sizeof(u.e) <= n; ) {
+           const struct inotify_event *e =
+               (const struct inotify_event *)(u.buf + off);
+           changed |= e->len && strcmp(e->name, base) == 0;
+           off += (ssize_t)(sizeof(struct inotify_event) + e->len);
+       }
+       return changed;
+   }
+   )
+#  else
+#   define LOGGING_CONFIG_NOTIFY(path) (-1) // SIGHUP only
+#   define LOGGING_CONFIG_CHANGED(fd, path) 0
+#  endif
+typedef struct log_config_watch
+{
+    int signals; // read end of the SIGHUP pipe
+    int notify; // -1 without inotify
+    char path[256];
+} log_config_watch_t;
+   LOGGING_GLOBAL volatile sig_atomic_t logging_config_signal_fd; // fd + 1
+   LOGGING_FUNC_DEF(
+   void LOGGING_CONFIG_SIGNALED(int sig),
+   {
+       int fd = (int)logging_config_signal_fd - 1, err = errno;
+       signal(sig, LOGGING_CONFIG_SIGNALED); // reset by the System V signal()
+       if (fd >= 0 && write(fd, "", 1) < 0) {
+           // full, a reload is pending anyway
+       }
+       errno = err;
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void *LOGGING_CONFIG_THREAD(void *arg),
+   {
+       log_config_watch_t *w = (log_config_watch_t *)arg;
+       struct pollfd fds[2];
+       char c;
+       fds[0].fd = w->signals;
+       fds[1].fd = w->notify; // ignored by poll if -1
+       fds[0].events = fds[1].events = POLLIN;
+       for (;;) {
+           int reload = 0, wait = logging_config_reclaim()
+                                  ? LOGGING_CONF_RELOAD_RECLAIM_MS : -1;
+           if (poll(fds, 2, wait) <= 0) {
+               continue;
+           }
+           if (fds[0].revents & POLLIN) {
+               reload = read(fds[0].fd, &c, 1) > 0;
+           }
+           if (fds[1].revents & POLLIN) {
+               reload |= LOGGING_CONFIG_CHANGED(fds[1].fd, w->path);
+           }
+           if (reload) {
+               logging_config_load(w->path);
+           }
+       }
+       return NULL;
+   }
+   )
+   /*
+     Loads path, then reloads it from a detached thread whenever the file is
+     rewritten (Linux) or SIGHUP arrives. -1 if it can't be loaded or
+     watched, or is already watched.
+   */
+   LOGGING_FUNC_DEF(
+   int logging_config_watch(const char *path),
+   {
+       log_config_watch_t *w;
+       pthread_t tid;
+       int fds[2];
+       if (logging_config_signal_fd != 0 || strlen(path) >= sizeof(w->path)
+           || (w = (log_config_watch_t *)malloc(sizeof(*w))) == NULL) {
+           return -1;
+       }
+       strcpy(w->path, path);
+       w->notify = LOGGING_CONFIG_NOTIFY(path); // before loading, not to miss
+       if (logging_config_load(path) != 0 || pipe(fds) != 0) {
+           if (w->notify >= 0) {
+               close(w->notify);
+           }
+           free(w);
+           return -1;
+       }
+       w->signals = fds[0];
+       if (pthread_create(&tid, NULL, LOGGING_CONFIG_THREAD, w) != 0) {
+           close(fds[0]);
+           close(fds[1]);
+           if (w->notify >= 0) {
+               close(w->notify);
+           }
+           free(w);
+           return -1;
+       }
+       pthread_detach(tid);
+       logging_config_signal_fd = fds[1] + 1;
+       signal(SIGHUP, LOGGING_CONFIG_SIGNALED);
+       return 0;
+   }
+   )
+# endif
+
+/******************************************************************************/
+// Logging Slow Path
+/******************************************************************************/
+/*
+  With LOGGING_CONF_SLOW_PATH a LOG_LEVEL site is its level checks and one
+  call to logging_log with a static descriptor, the record is built out of
+  line. The direction, which may name locals, is taken at the site, the
+  record is built and written by one function per translation unit, with
+  the caller's configuration: module and formats, but also the record
+  allocation, locking, threading, color and rollback size, which a prebuilt
+  library can not know. LOG_XXX_KV and LOG_BUFFER sites call their own
+  function of the translation unit directly, with the pairs as an array.
+*/
+# if defined(__GNUC__)
+#  define LOGGING_COLD __attribute__((cold, noinline, unused))
+# elif defined(_MSC_VER)
+#  define LOGGING_COLD __declspec(noinline)
+# else
+#  define LOGGING_COLD
+# endif
+# ifdef LOGGING_EVIL_MODE
+#  define LOGGING_COLD_FUNC_DEF(SIGNATURE, ...) \
+   LOGGING_FUNC_DEF(LOGGING_COLD SIGNATURE, __VA_ARGS__)
+# else
+#  define LOGGING_COLD_FUNC_DEF(SIGNATURE, ...) \
+   static LOGGING_COLD SIGNATURE __VA_ARGS__ // not inline, by definition
+# endif
+typedef struct log_call
+{
+    int level;
+    int line;
+    const char *file;
+    const char *fileline;
+    const char *function;
+    void (*log)(const struct log_call *c, const log_direction_t *d,
+                const char *fmt, va_list args); // its unit's LOGGING_CALL_LOG
+    void *site; // log_site_t, NULL without call sites
+} log_call_t;
+# if defined(LOGGING_CONF_SLOW_PATH) || defined(LOGGING_AS_SOURCE)
+   LOGGING_COLD_FUNC_DEF(
+   void logging_log(const log_call_t *c,
+                                 const log_direction_t *d,
+                                 const char *fmt, ...),
+   {
+       va_list args;
+       va_start(args, fmt);
+       c->log(c, d, fmt, args);
+       va_end(args);
+   }
+   )
+# endif
+# ifdef LOGGING_CONF_SLOW_PATH
+   /*
+     The caller's side of a site, one function per kind of site for every
+     site of the translation unit. A record may live in the frame, so each
+     one builds and writes it itself.
+   */
+#  define LOGGING_CALL_RECORD(r, c, d, sep) \
+   log_logger_t _l, *l = &_l; \
+   LOGGING_INIT_RECORD(r, (c)->level, sep); \
+   LOGGING_CHECK_RECORD(r, (c)->level); \
+   memset(l, 0, sizeof(struct log_logger)); \
+   l->level = (c)->level; \
+   l->fileline = (c)->fileline; \
+   l->function = (c)->function; \
+   l->flie = (c)->file; \
+   l->line = (c)->line; \
+   LOGGING_LOGGER_GET_MODULE(l); \
+   LOGGING_LOGGER_GET_LEVELFLAG(l); \
+   LOGGING_LOGGER_ADD_BUILTIN_FORMAT(l); \
+   LOGGING_LOGGER_ADD_CUSTOM_FORMAT(l); \
+   LOGGING_GET_FORMAT_CONF_STR(&l->format_conf); \
+   (r)->d = *(d); \
+   LOGGING_CONFIG_DIRECTION(r); \
+   LOGGING_INIT_FORMAT(r, l)
+#  define LOGGING_CALL_WRITE(c, r) do \
+   { \
+       if ((c)->site) { \
+           LOGGING_SITE_PROFILE_AT((log_site_t *)(c)->site, r); \
+       } \
+       LOGGING_WRITE_RECORD(r); \
+   } while (0)
+   /* LOG_LEVEL, called back by logging_log. */
+   static LOGGING_COLD void LOGGING_CALL_LOG(const log_call_t *c,
+                                             const log_direction_t *d,
+                                             const char *fmt, va_list args)
+   {
+       do {
+           log_record_t *r;
+           LOGGING_CALL_RECORD(r, c, d, FORMAT_COLON);
+           LOGGING_BUILD_RECORD_V(r, fmt, args);
+           LOGGING_CALL_WRITE(c, r);
+       } while (0);
+   }
+   /* LOG_LEVEL_KV, the pairs ending with a NULL key. */
+   static LOGGING_COLD void LOGGING_CALL_KV(const log_call_t *c,
+                                            const log_direction_t *d,
+                                            const char *msg,
+                                            const log_kv_pair_t *kv)
+   {
+       do {
+           log_record_t *r;
+           LOGGING_CALL_RECORD(r, c, d, FORMAT_COLON);
+           LOGGING_BUILD_RECORD(r, "%s\n", msg);
+           for (; kv->key; ++kv) {
+               LOGGING_KV_ADD_VALUE(r, kv->key, kv->value);
+           }
+           LOGGING_CALL_WRITE(c, r);
+       } while (0);
+   }
+   /* A site writing its message itself through build: the C++ API. */
+   static LOGGING_COLD void LOGGING_CALL_BUILD(const log_call_t *c,
+       const log_direction_t *d,
+       void (*build)(log_record_t *r, const void *arg), const void *arg)
+   {
+       do {
+           log_record_t *r;
+           LOGGING_CALL_RECORD(r, c, d, FORMAT_COLON);
+           LOGGING_BUILD_FORMAT(r);
+           build(r, arg);
+           LOGGING_RECORD_END(r);
+           LOGGING_CALL_WRITE(c, r);
+       } while (0);
+   }
+   /* LOG_BUFFER, split in as many records as it takes. */
+   static LOGGING_COLD void LOGGING_CALL_BUFFER(const log_call_t *c,
+                                                const log_direction_t *d,
+                                                const char *msg,
+                                                const uint8_t *buff, int cnt)
+   {
+       int off = 0, n;
+       do {
+           log_record_t *r;
+           LOGGING_CALL_RECORD(r, c, d, FORMAT_SPACE);
+           LOGGING_BUILD_FORMAT(r);
+           n = LOGGING_BUILD_BUFFER(r, msg, buff+off, cnt-off, off);
+           off = n > 0 ? off + n : cnt; /* none fit: truncated */
+           LOGGING_RECORD_END(r);
+           LOGGING_CALL_WRITE(c, r);
+       } while (off < cnt);
+   }
+#  ifdef LOGGING_FEAT_SITES
+#   define LOGGING_CALL_SITE ((void *)&_site)
+#  else
+#   define LOGGING_CALL_SITE NULL
+#  endif
+#  define LOGGING_CALL_DEF(lvl) \
+   static const log_call_t _call = { lvl, __LINE__, __FILE__, \
+       __FILE__ "(" LOGGING_STR(__LINE__) ")", __FUNCTION__, \
+       LOGGING_CALL_LOG, LOGGING_CALL_SITE }; \
+   log_direction_t _d = { LOGGING_DIRECTION_NEXT, \
+                          (void *)(LOGGING_DIRECTION), LOGGING_DIR_WRITE }
+# endif
+
+/******************************************************************************/
+// Logging Change Detection
+/******************************************************************************/
+/*
+  LOG_IF_CHANGED keeps a 64-bit hash of the watched value per call site
+  (or per thread and site) instead of a copy, and moves it on with a
+  compare-exchange, so of threads seeing the same change one logs it. An
+  all-zero value hashes to 0, the initial hash, as the copy used to start
+  zeroed. LOG_IF_CHANGED_VALUE also keeps a typed snapshot, swapped under
+  a lock word only on a change, to print the old and the new value.
+*/
+# if defined(__unix__) || defined(__APPLE__)
+#  include <sched.h>
+#  define LOGGING_CHANGED_YIELD() sched_yield()
+# elif defined(_WIN32) || defined(_WIN64)
+#  include <windows.h>
+#  define LOGGING_CHANGED_YIELD() SwitchToThread()
+# else
+#  define LOGGING_CHANGED_YIELD()
+# endif
+# define LOGGING_CHANGED_K1 0x9e3779b97f4a7c15ULL
+# define LOGGING_CHANGED_K2 0xff51afd7ed558ccdULL
+   LOGGING_FUNC_DEF(
+   uint64_t LOGGING_CHANGED_HASH(const void *p, size_t n),
+   {
+       const unsigned char *s = (const unsigned char *)p;
+       uint64_t h = 0, w;
+       size_t i;
+
+       for (i = 0; i + 8 <= n; i += 8) {
+           memcpy(&w, s + i, 8);
+           h = (h ^ w) * LOGGING_CHANGED_K1;
+           h ^= h >> 29;
+       }
+       if (i < n) {
+           w = 0;
+           memcpy(&w, s + i, n - i);
+           h = (h ^ w) * LOGGING_CHANGED_K1;
+           h ^= h >> 29;
+       }
+       h = (h ^ (h >> 33)) * LOGGING_CHANGED_K2;
+       return h ^ (h >> 33);
+   }
+   )
+   /* Move *seen from its value on to h, true for the one thread doing so. */
+   LOGGING_FUNC_DEF(
+   int LOGGING_CHANGED(uint64_t *seen, uint64_t h),
+   {
+       uint64_t old = LOGGING_ATOMIC_LOAD(seen);
+       return old != h && LOGGING_ATOMIC_CAS(seen, &old, h);
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_CHANGED_LOCK(int *lock),
+   {
+       int unlocked = 0;
+       while (!LOGGING_ATOMIC_CAS(lock, &unlocked, 1)) {
+           unlocked = 0;
+           LOGGING_CHANGED_YIELD(); // the holder may be descheduled
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_CHANGED_UNLOCK(int *lock),
+   {
+       LOGGING_ATOMIC_STORE_REL(lock, 0);
+   }
+   )
+
+// Macro Entry
+# ifdef LOGGING_CONF_SLOW_PATH
+#  define LOG_LEVEL(level, fmt, ...) do \
+{ \
+    LOGGING_SITE_DEF(level); \
+    LOGGING_SITE_CHECK(); \
+    LOGGING_DYNAMIC_LOG_LEVEL_CHECK(level); \
+    LOGGING_CALL_DEF(level); \
+    logging_log(&_call, &_d, fmt "\n", ##__VA_ARGS__); \
+} while (0)
+# else
+#  define LOG_LEVEL(level, fmt, ...) do \
+{ \
+    LOGGING_SITE_DEF(level); \
+    LOGGING_SITE_CHECK(); \
+    LOGGING_DYNAMIC_LOG_LEVEL_CHECK(level); \
+    log_record_t *r; \
+    log_logger_t _l, *l = &_l; \
+    LOGGING_INIT_RECORD(r, level, FORMAT_COLON); \
+    LOGGING_CHECK_RECORD(r, level); \
+    LOGGING_INIT_LOGGER(l, level); \
+    LOGGING_INIT_DIRECTION(r, l); \
+    LOGGING_INIT_FORMAT(r, l); \
+    LOGGING_BUILD_RECORD(r, fmt "\n", ##__VA_ARGS__); \
+    LOGGING_SITE_PROFILE(r); \
+    LOGGING_WRITE_RECORD(r); \
+} while (0)
+# endif
+# ifdef LOGGING_CONF_SLOW_PATH
+#  define LOG_LEVEL_KV(level, msg, ...) do \
+{ \
+    LOGGING_SITE_DEF(level); \
+    LOGGING_SITE_CHECK(); \
+    LOGGING_DYNAMIC_LOG_LEVEL_CHECK(level); \
+    LOGGING_CALL_DEF(level); \
+    const log_kv_pair_t _kv[] = { \
+        LOGGING_KV_ITEMS(_, ##__VA_ARGS__) { NULL, LOG_KV_BOOL(0) } \
+    }; \
+    LOGGING_CALL_KV(&_call, &_d, msg, _kv); \
+} while (0)
+# else
+#  define LOG_LEVEL_KV(level, msg, ...) do \
+{ \
+    LOGGING_SITE_DEF(level); \
+    LOGGING_SITE_CHECK(); \
+    LOGGING_DYNAMIC_LOG_LEVEL_CHECK(level); \
+    log_record_t *r; \
+    log_logger_t _l, *l = &_l; \
+    LOGGING_INIT_RECORD(r, level, FORMAT_COLON); \
+    LOGGING_CHECK_RECORD(r, level); \
+    LOGGING_INIT_LOGGER(l, level); \
+    LOGGING_INIT_DIRECTION(r, l); \
+    LOGGING_INIT_FORMAT(r, l); \
+    LOGGING_BUILD_RECORD(r, "%s\n", msg); \
+    LOGGING_KV_PAIRS(r, ##__VA_ARGS__) \
+    LOGGING_SITE_PROFILE(r); \
+    LOGGING_WRITE_RECORD(r); \
+} while (0)
+# endif
+
+/******************************************************************************/
+// Logging Timers
+/******************************************************************************/
+/*
+  With LOGGING_CONF_TIMERS, LOG_SCOPE_TIMER and LOG_TIMER_BEGIN/END time a
+  section with the cycle counter into per-thread log-linear histograms, 8
+  buckets per power of 2, one per timer and thread, written only by their
+  thread. Every LOGGING_CONF_TIMERS_MS, the first timer ending after the
+  deadline logs one record per timer that ran since the last report, with
+  its count and percentiles, at LOGGING_CONF_TIMERS_LEVEL. The cycle rate
+  is calibrated against the monotonic clock, over the whole run so far.
+*/
+# define LOGGING_TIMER_SUB_BITS 3
+# define LOGGING_TIMER_SUBS (1 << LOGGING_TIMER_SUB_BITS)
+# define LOGGING_TIMER_BUCKETS ((64 - LOGGING_TIMER_SUB_BITS + 1) \
+                                * LOGGING_TIMER_SUBS)
+# ifndef LOGGING_CONF_TIMERS_MS
+#  define LOGGING_CONF_TIMERS_MS 10000
+# endif
+# ifndef LOGGING_CONF_TIMERS_LEVEL
+#  define LOGGING_CONF_TIMERS_LEVEL LOGGING_INFO_LEVEL
+# endif
+# ifndef LOGGING_CONF_TIMERS_MAX // timers of the process, others are ignored
+#  define LOGGING_CONF_TIMERS_MAX 64
+# endif
+# define LOGGING_TIMERS_CALIBRATE (1 << 22) // cycles before the first rate
+typedef struct log_timer
+{
+    const char *name;
+    const char *file;
+    int line;
+    int state; // 0 new, 1 registering, 2 registered
+    int id;
+    struct log_timer *next;
+    uint64_t *last; // the buckets at the previous report
+} log_timer_t;
+typedef struct log_timer_hist
+{
+    uint64_t bucket[LOGGING_TIMER_BUCKETS];
+} log_timer_hist_t;
+typedef struct log_timer_node
+{
+    struct log_timer_node *next;
+    log_timer_hist_t *hist[LOGGING_CONF_TIMERS_MAX]; // by timer id
+} log_timer_node_t;
+typedef struct log_timer_scope
+{
+    log_timer_t *timer;
+    uint64_t begin;
+} log_timer_scope_t;
+# define LOGGING_TIMER_INIT(name) { name, __FILE__, __LINE__, 0, 0, NULL, NULL }
+# if defined(LOGGING_CONF_TIMERS) || defined(LOGGING_AS_SOURCE)
+   LOGGING_GLOBAL log_timer_t *logging_timers;
+   LOGGING_GLOBAL log_timer_node_t *logging_timer_nodes;
+   LOGGING_GLOBAL int logging_timers_count;
+   LOGGING_GLOBAL uint64_t logging_timers_deadline; // cycles, 0 to start
+   LOGGING_GLOBAL uint64_t logging_timers_c0; // cycles at the start
+   LOGGING_GLOBAL int64_t logging_timers_ns0; // monotonic ns at the start
+   /* Bucket of v cycles: exact below 8, then 8 per power of 2. */
+   LOGGING_FUNC_DEF(
+   int LOGGING_TIMER_BUCKET(uint64_t v),
+   {
+       int e = 0;
+       if (v < LOGGING_TIMER_SUBS) {
+           return (int)v;
+       }
+       LOGGING_STATS_LOG2(e, v);
+       return (e - LOGGING_TIMER_SUB_BITS + 1) * LOGGING_TIMER_SUBS
+              + (int)((v >> (e - LOGGING_TIMER_SUB_BITS))
+                      & (LOGGING_TIMER_SUBS - 1));
+   }
+   )
+   /* The highest value in cycles of bucket b. */
+   LOGGING_FUNC_DEF(
+   uint64_t LOGGING_TIMER_BOUND(int b),
+   {
+       int e = b / LOGGING_TIMER_SUBS - 1 + LOGGING_TIMER_SUB_BITS;
+       uint64_t sub = (uint64_t)(b % LOGGING_TIMER_SUBS);
+       if (b < LOGGING_TIMER_SUBS) {
+           return (uint64_t)b;
+       }
+       return ((LOGGING_TIMER_SUBS + sub + 1) << (e - LOGGING_TIMER_SUB_BITS))
+              - 1;
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int LOGGING_TIMER_REGISTER(log_timer_t *t),
+   {
+       int state = 0;
+       if (LOGGING_ATOMIC_CAS(&t->state, &state, 1)) {
+           t->id = LOGGING_ATOMIC_ADD(&logging_timers_count, 1);
+           t->next = LOGGING_ATOMIC_LOAD(&logging_timers);
+           while (!LOGGING_ATOMIC_CAS(&logging_timers, &t->next, t));
+           LOGGING_ATOMIC_STORE_REL(&t->state, 2);
+       }
+       while (LOGGING_ATOMIC_LOAD_ACQ(&t->state) != 2); // another thread's
+       return t->id;
+   }
+   )
+   /*
+     Take the deadline, so that one thread at a time reports, and return
+     it, to be put back or moved on.
+   */
+   LOGGING_FUNC_DEF(
+   uint64_t LOGGING_TIMERS_CLAIM(void),
+   {
+       uint64_t d = LOGGING_ATOMIC_LOAD_ACQ(&logging_timers_deadline);
+       while (d == UINT64_MAX
+              || !LOGGING_ATOMIC_CAS(&logging_timers_deadline, &d, UINT64_MAX)) {
+           d = LOGGING_ATOMIC_LOAD_ACQ(&logging_timers_deadline);
+       }
+       return d;
+   }
+   )
+   /* Log the timers that ran since the last report, with the deadline taken. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_TIMERS_REPORT(uint64_t now),
+   {
+       double ns = (double)(LOGGING_MONOTIME() - logging_timers_ns0)
+                 / (double)(now - logging_timers_c0 ? now - logging_timers_c0
+                                                    : 1); // per cycle
+       log_timer_t *t = LOGGING_ATOMIC_LOAD_ACQ(&logging_timers);
+       uint64_t merged[LOGGING_TIMER_BUCKETS];
+
+       for (; t; t = t->next) {
+           log_timer_node_t *n = LOGGING_ATOMIC_LOAD_ACQ(&logging_timer_nodes);
+           uint64_t count = 0, seen = 0, pct[3] = { 0, 0, 0 }, max = 0;
+           const double at[3] = { 0.5, 0.9, 0.99 };
+           int p = 0;
+           if (t->id >= LOGGING_CONF_TIMERS_MAX) {
+               continue;
+           }
+           if (t->last == NULL && (t->last = (uint64_t *)calloc(
+                   LOGGING_TIMER_BUCKETS, sizeof(uint64_t))) == NULL) {
+               return;
+           }
+           memset(merged, 0, sizeof(merged));
+           for (; n; n = n->next) {
+               log_timer_hist_t *h = LOGGING_ATOMIC_LOAD_ACQ(&n->hist[t->id]);
+               for (int b = 0; h && b < LOGGING_TIMER_BUCKETS; ++b) {
+                   merged[b] += LOGGING_ATOMIC_LOAD(&h->bucket[b]);
+               }
+           }
+           for (int b = 0; b < LOGGING_TIMER_BUCKETS; ++b) {
+               uint64_t d = merged[b] - t->last[b];
+               t->last[b] = merged[b];
+               merged[b] = d; // of this period
+               count += d;
+           }
+           if (count == 0) {
+               continue;
+           }
+           for (int b = 0; b < LOGGING_TIMER_BUCKETS; ++b) {
+               seen += merged[b];
+               while (p < 3 && (double)seen >= at[p] * (double)count) {
+                   pct[p++] = LOGGING_TIMER_BOUND(b);
+               }
+               max = merged[b] ? LOGGING_TIMER_BOUND(b) : max;
+           }
+           if (LOGGING_CONF_TIMERS_LEVEL <= LOGGING_LOG_LEVEL) {
+               LOG_LEVEL(LOGGING_CONF_TIMERS_LEVEL, "timer %s: count=%llu "
+                   "p50=%.0fns p90=%.0fns p99=%.0fns max=%.0fns (%s:%d)",
+                   t->name, (unsigned long long)count, (double)pct[0] * ns,
+                   (double)pct[1] * ns, (double)pct[2] * ns,
+                   (double)max * ns, t->file, t->line);
+           }
+       }
+   }
+   )
+   /*
+     Past the deadline: calibrate the cycle counter the first time, then
+     report and set the next one.
+   */
+   LOGGING_FUNC_DEF(
+   void LOGGING_TIMERS_TICK(uint64_t now),
+   {
+       uint64_t d = LOGGING_ATOMIC_LOAD(&logging_timers_deadline);
+       double per_ms;
+       if (now < d || d == UINT64_MAX
+           || !LOGGING_ATOMIC_CAS(&logging_timers_deadline, &d, UINT64_MAX)) {
+           return;
+       }
+       if (d == 0) {
+           logging_timers_c0 = now;
+           logging_timers_ns0 = LOGGING_MONOTIME();
+           LOGGING_ATOMIC_STORE_REL(&logging_timers_deadline,
+                                    now + LOGGING_TIMERS_CALIBRATE);
+           return;
+       }
+       if (d != logging_timers_c0 + LOGGING_TIMERS_CALIBRATE) { // not the first
+           LOGGING_TIMERS_REPORT(now);
+       }
+       per_ms = (double)(now - logging_timers_c0) * 1e6
+              / (double)(LOGGING_MONOTIME() - logging_timers_ns0 + 1);
+       LOGGING_ATOMIC_STORE_REL(&logging_timers_deadline,
+           now + (uint64_t)(per_ms * LOGGING_CONF_TIMERS_MS));
+   }
+   )
+   /* Add a sample of cycles to the calling thread's histogram of t. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_TIMER_ADD(log_timer_t *t, uint64_t begin),
+   {
+       static LOGGING_THREAD_LOCAL log_timer_node_t *self;
+       uint64_t now = LOGGING_CYCLES();
+       log_timer_hist_t *h;
+       int id = LOGGING_ATOMIC_LOAD_ACQ(&t->state) == 2
+              ? t->id : LOGGING_TIMER_REGISTER(t);
+       int b = LOGGING_TIMER_BUCKET(now - begin);
+       if (id >= LOGGING_CONF_TIMERS_MAX) {
+           return;
+       }
+       if (self == NULL) {
+           self = (log_timer_node_t *)calloc(1, sizeof(*self));
+           if (self == NULL) {
+               return;
+           }
+           self->next = LOGGING_ATOMIC_LOAD(&logging_timer_nodes);
+           while (!LOGGING_ATOMIC_CAS(&logging_timer_nodes, &self->next,
+                                      self));
+       }
+       if ((h = self->hist[id]) == NULL) {
+           if ((h = (log_timer_hist_t *)calloc(1, sizeof(*h))) == NULL) {
+               return;
+           }
+           LOGGING_ATOMIC_STORE_REL(&self->hist[id], h);
+       }
+       LOGGING_ATOMIC_STORE(&h->bucket[b], h->bucket[b] + 1);
+       if (now >= LOGGING_ATOMIC_LOAD(&logging_timers_deadline)) {
+           LOGGING_TIMERS_TICK(now);
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_TIMER_SCOPE_END(log_timer_scope_t *s),
+   {
+       LOGGING_TIMER_ADD(s->timer, s->begin);
+   }
+   )
+   /* Log the timers that ran since the last report now, e.g. at exit. */
+   LOGGING_FUNC_DEF(
+   void logging_timers_report(void),
+   {
+       uint64_t d = LOGGING_TIMERS_CLAIM();
+       if (d != 0) {
+           LOGGING_TIMERS_REPORT(LOGGING_CYCLES());
+       }
+       LOGGING_ATOMIC_STORE_REL(&logging_timers_deadline, d);
+   }
+   )
+# endif
+# ifdef LOGGING_CONF_TIMERS
+#  define LOGGING__CAT(a, b) a##b
+#  define LOGGING_CAT(a, b) LOGGING__CAT(a, b)
+#  ifdef __cplusplus
+}
+   struct log_timer_guard
+   {
+       log_timer_scope_t s;
+       log_timer_guard(log_timer_t *t)
+       {
+           s.timer = t;
+           s.begin = LOGGING_CYCLES();
+       }
+       ~log_timer_guard() { LOGGING_TIMER_SCOPE_END(&s); }
+   };
+extern "C" {
+#   define LOG_SCOPE_TIMER(name) \
+    static log_timer_t LOGGING_CAT(_timer_, __LINE__) = \
+        LOGGING_TIMER_INIT(name); \
+    log_timer_guard LOGGING_CAT(_timer_guard_, __LINE__)( \
+        &LOGGING_CAT(_timer_, __LINE__))
+#  elif defined(__GNUC__)
+#   define LOG_SCOPE_TIMER(name) \
+    static log_timer_t LOGGING_CAT(_timer_, __LINE__) = \
+        LOGGING_TIMER_INIT(name); \
+    __attribute__((cleanup(LOGGING_TIMER_SCOPE_END))) \
+    log_timer_scope_t LOGGING_CAT(_timer_scope_, __LINE__) = \
+        { &LOGGING_CAT(_timer_, __LINE__), LOGGING_CYCLES() }
+#  else
+#   define LOG_SCOPE_TIMER(name) \
+    LOG_SCOPE_TIMER_needs_cxx_or_the_gnu_cleanup_attribute
 #  endif
+#  define LOG_TIMER_BEGIN(id) uint64_t _timer_begin_##id = LOGGING_CYCLES()
+#  define LOG_TIMER_END(id) do \
+   { \
+       static log_timer_t _timer = LOGGING_TIMER_INIT(#id); \
+       LOGGING_TIMER_ADD(&_timer, _timer_begin_##id); \
+   } while (0)
 # else
-#  define LOGGING_LOGGER_ADD_CUSTOM_FORMAT(l)
+#  define LOG_SCOPE_TIMER(name)
+#  define LOG_TIMER_BEGIN(id)
+#  define LOG_TIMER_END(id)
 # endif
-/// init_logger
-# define LOGGING_INIT_LOGGER(l, LEVEL) do \
-  { \
-      memset(l, 0, sizeof(struct log_logger)); \
-      (l)->level = LEVEL; \
-      LOGGING_LOGGER_GET_CALLER_CONTEXT(l); \
-      LOGGING_LOGGER_ADD_BUILTIN_FORMAT(l); \
-      LOGGING_LOGGER_ADD_CUSTOM_FORMAT(l); \
-      LOGGING_GET_FORMAT_CONF_STR(&l->format_conf); \
-  } while (0)
 
 /******************************************************************************/
-// Logging Format Builder
+// Logging Signal Safe
 /******************************************************************************/
-# if defined(LOGGING_FEAT_WITH_FORMAT)
-/// get_format
-#  ifdef LOGGING_EVIL_MODE
-    LOGGING_FUNC_DEF(
-    void LOGGING_GET_FORMAT(log_record_t *r, log_format_data_t fs[], int *fl),
-    {
-        log_format_t *fmt = (r)->fmt;
-        int i = 0;
-        while (fmt) {
-            LOGGING_PRINTF("format %p ", fmt);
-            LOGGING_PRINTF("add %s\n", fmt->name);
-            fs[i].format = fmt->format; fs[i].data = (void *)fmt; i++;
-            fmt = fmt->next;
-        }
-        *(fl) = i;
-    }
-    )
+/*
+  With LOGGING_CONF_SIGNAL_SAFE, LOG_SIGNAL_SAFE logs from a signal
+  handler, where the code interrupted may hold the lock, the heap or a
+  FILE. Its record is formatted by a formatter of its own, integers,
+  pointers and strings only, into one of LOGGING_CONF_SIGNAL_SLOTS static
+  buffers taken by a compare-exchange, and written whole with write(2) to
+  the fds resolved beforehand, stderr's if none were. Nothing is locked,
+  allocated or flushed: the record may come out before records still in a
+  FILE's buffer or queued in threading mode.
+*/
+# if defined(LOGGING_CONF_SIGNAL_SAFE) && !defined(__unix__) \
+     && !defined(__APPLE__)
+#  error LOGGING_CONF_SIGNAL_SAFE needs write(2)
+# endif
+# if (defined(LOGGING_CONF_SIGNAL_SAFE) || defined(LOGGING_AS_SOURCE)) \
+     && (defined(__unix__) || defined(__APPLE__))
+#  include <errno.h>
+#  include <unistd.h>
+#  include <time.h>
+#  include <sched.h> // struct timespec in strict iso mode
+#  if defined(__GLIBC__) && !defined(__USE_POSIX199309)
+    extern int clock_gettime(int, struct timespec *);
+#  endif
+#  if defined(__GLIBC__) && !defined(__USE_POSIX)
+    extern int fileno(FILE *);
+#  endif
+#  ifndef CLOCK_REALTIME
+#   define CLOCK_REALTIME 0
+#  endif
+#  ifndef CLOCK_MONOTONIC
+#   define CLOCK_MONOTONIC 1
+#  endif
+#  if defined(__linux)
+#   include <sys/syscall.h>
+#   if defined(__GLIBC__) && !defined(__USE_MISC)
+     extern long syscall(long, ...); // hidden by strict iso mode
+#   endif
+#   define LOGGING_SIGNAL_GETTID() (uint64_t)syscall(SYS_gettid)
 #  else
-    LOGGING_FUNC_DEF(
-    void LOGGING_GET_FORMAT(log_record_t *r, log_format_data_t fs[], int *fl),
-    {
-        log_format_t *fmt = r->fmt;
-        log_format_format_t *fmters = (log_format_format_t *)fmt;
-        for (int i = 0; i < fmt->count; ++i) {
-            fs[i].format = fmters[-1-i]; fs[i].data = (void *)r->fmt;
-            LOGGING_PRINTF("format: %p\n", fs[i]);
-        }
-        *(fl) = fmt->count;
-    }
-    )
+#   define LOGGING_SIGNAL_GETTID() (uint64_t)0
 #  endif
-/// build_format
-#  define FORMAT_SPACE " "
-#  define FORMAT_COLON ":" FORMAT_SPACE
-#  define LOGGING_LOG_SEPERATOR_FMT "%s"
-#  define LOGGING_LOG_SEPERATOR_VAL(r) , ((log_record_t *)(r))->seperator
+#  if defined(LOGGING_LOG_SEQN) || defined(LOGGING_AS_SOURCE)
+#   define LOGGING_SIGNAL_SEQN() LOGGING_SEQN_SIGNAL_SAFE()
+#  else
+#   define LOGGING_SIGNAL_SEQN() (uint64_t)0
+#  endif
+#  ifndef LOGGING_CONF_SIGNAL_SLOTS
+#   define LOGGING_CONF_SIGNAL_SLOTS 4
+#  endif
+#  ifndef LOGGING_CONF_SIGNAL_SIZE
+#   define LOGGING_CONF_SIGNAL_SIZE 1024
+#  endif
+#  ifndef LOGGING_CONF_SIGNAL_FDS
+#   define LOGGING_CONF_SIGNAL_FDS 8
+#  endif
+#  define LOGGING_SIGNAL_F_LEVELFLAG 0x001
+#  define LOGGING_SIGNAL_F_TIME 0x002
+#  define LOGGING_SIGNAL_F_MONOTIME 0x004
+#  define LOGGING_SIGNAL_F_SEQN 0x008
+#  define LOGGING_SIGNAL_F_PROCID 0x010
+#  define LOGGING_SIGNAL_F_THRDID 0x020
+#  define LOGGING_SIGNAL_F_MODULE 0x040
+#  define LOGGING_SIGNAL_F_FILELINE 0x080
+#  define LOGGING_SIGNAL_F_FUNCTION 0x100
+#  define LOGGING_SIGNAL_F_JSON 0x200
+   typedef struct log_signal_site
+   {
+       int fields; // LOGGING_SIGNAL_F_*, of the caller's configuration
+       const char *levelflag;
+       const char *module;
+       const char *fileline;
+       const char *function;
+   } log_signal_site_t;
+   typedef struct log_signal_buf
+   {
+       char *begin;
+       char *p;
+       char *end;
+   } log_signal_buf_t;
+   LOGGING_GLOBAL int logging_signal_fds[LOGGING_CONF_SIGNAL_FDS];
+   LOGGING_GLOBAL int logging_signal_nfds;
+   LOGGING_GLOBAL int logging_signal_busy[LOGGING_CONF_SIGNAL_SLOTS];
+   LOGGING_GLOBAL char
+       logging_signal_slots[LOGGING_CONF_SIGNAL_SLOTS][LOGGING_CONF_SIGNAL_SIZE];
+   LOGGING_GLOBAL uint64_t logging_signal_dropped; // no slot was free
+
+/// fds
+   /* Also write the records to fd, registered before the handlers run. */
    LOGGING_FUNC_DEF(
-   void LOGGING_BUILD_FORMAT(log_record_t *r),
+   int logging_signal_fd(int fd),
    {
-       LOGGING_EVIL_DEBUG_BLOCK(
-           log_format_t *f = r->fmt;
-           LOGGING_PRINTF("formats: \n");
-           while (f) {
-               LOGGING_PRINTF("  %p", f);
-               LOGGING_PRINTF("  %s\n", f->name);
-               f = f->next;
+       int i, n = LOGGING_ATOMIC_LOAD(&logging_signal_nfds);
+       for (i = 0; i < n; ++i) {
+           if (logging_signal_fds[i] == fd) {
+               return 0;
            }
-       )
-
-       log_format_data_t fs[10];
-       int fl = 0;
-       LOGGING_PRINTF("parser format conf\n");
-       LOGGING_GET_FORMAT(r, fs, &fl);
-       LOGGING_PRINTF("format count: %d\n", fl);
-
-       LOGGING_PRINTF("build format\n");
-       int would_written;
-       for (int i = 0; i < fl; ++i) {
-           if (fs[i].format) {
-               would_written = fs[i].format(fs[i].data,
-                   (&(r->message))+(r->message_len),
-                   (r->message_size)-(r->message_len),
-                   !r->message_len);
-               r->message_len += would_written;
+       }
+       if (fd < 0 || n == LOGGING_CONF_SIGNAL_FDS) {
+           return -1;
+       }
+       logging_signal_fds[n] = fd;
+       LOGGING_ATOMIC_STORE_REL(&logging_signal_nfds, n + 1);
+       return 0;
+   }
+   )
+   LOGGING_FUNC_DEF(
+   int logging_signal_file(FILE *f),
+   {
+       return f ? logging_signal_fd(fileno(f)) : -1;
+   }
+   )
+   /* Forget the fds, e.g. before registering a reopened file's. */
+   LOGGING_FUNC_DEF(
+   void logging_signal_fd_clear(void),
+   {
+       LOGGING_ATOMIC_STORE_REL(&logging_signal_nfds, 0);
+   }
+   )
+   /* The fds of d and its list written by fw, i.e. FILE * directions. */
+   LOGGING_FUNC_DEF(
+   int logging_signal_directions(const log_direction_t *d,
+       void (*fw)(void *dir, const void *data, size_t size)),
+   {
+       int n = 0;
+       for (; d; d = d->next) {
+           if (fw && d->write == fw) {
+               n += logging_signal_file((FILE *)d->dir) == 0;
            }
        }
+       return n;
+   }
+   )
 
-       if (r->message_len > 0) {
-           would_written = snprintf((&(r->message))+(r->message_len),
-               (r->message_size)-(r->message_len),
-               LOGGING_LOG_SEPERATOR_FMT LOGGING_LOG_SEPERATOR_VAL(r));
-           // assert(would_written < format_size)
-           r->message_len += would_written;
+/// format
+   LOGGING_FUNC_DEF(
+   void LOGGING_SIGNAL_PUTC(log_signal_buf_t *b, char c),
+   {
+       if (b->p < b->end) {
+           *b->p++ = c;
        }
-
-       r->message_size = r->mem_size; // free space taken by formats
-       LOGGING_PRINTF("format built\n");
    }
    )
-# else
-#  define FORMAT_SPACE ""
-#  define FORMAT_COLON "" /*FORMAT_SPACE*/
-#  define LOGGING_LOG_SEPERATOR_FMT
-#  define LOGGING_LOG_SEPERATOR_VAL(r)
-#  define LOGGING_BUILD_FORMAT(r) LOGGING_PRINTF("not build format\n")
-# endif
-
-/******************************************************************************/
-// Logging Record Functions
-/******************************************************************************/
-/// malloc
-LOGGING_FUNC_DEF(
-void *LOGGING_RECORD_MALLOC(log_record_t *r, size_t size),
-{
-    uint8_t *msg_end = (uint8_t *)(&(r->message)+(r->message_size));
-    LOGGING_PRINTF("msg end: %p\n", msg_end);
-
-    if (r->message_size < size) {
-        return NULL;
-    }
-    r->message_size -= (int)size;
-
-    return msg_end-size;
-}
-)
-/// init
-# ifdef LOGGING_EVIL_MODE
-#  define LOGGING_LOG_RECORD_FMT_INIT(r) ((r)->fmt = NULL, (r))
-# else
-#  define LOGGING_LOG_RECORD_FMT_INIT(r) \
-   ( \
-       (r)->fmt = (log_format_t *) \
-           LOGGING_RECORD_MALLOC(r, sizeof(log_format_t)), (r) \
+   /* At most n chars of s, all of them if n < 0. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_SIGNAL_PUTS(log_signal_buf_t *b, const char *s, int n),
+   {
+       for (; *s && n != 0 && b->p < b->end; --n) {
+           *b->p++ = *s++;
+       }
+   }
    )
-# endif
-# define LOGGING_LOG_RECORD_INIT(RECORD, SIZE, LEVEL, SEP) \
-  ( \
-      memset(RECORD, 0, SIZE), \
-      (RECORD)->mem_size = (SIZE)-sizeof(log_record_t), \
-      (RECORD)->message_size = (SIZE)-sizeof(log_record_t), \
-      (RECORD)->level = (LEVEL), \
-      (RECORD)->seperator = (SEP), \
-      LOGGING_LOG_RECORD_FMT_INIT(RECORD), /* alloc space for formats */ \
-      (RECORD) \
-  )
+   /* v, or -v if neg, in base, padded to width by pad or after it. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_SIGNAL_PUTN(log_signal_buf_t *b, uint64_t v, int neg,
+                            int base, int upper, int width, char pad, int left),
+   {
+       const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+       char d[24];
+       int n = 0;
 
-/// write
-# ifdef LOGGING_LOG_DIRECTION_LIST
-#  define LOGGING_OTHER_DIR_ITER(r, m, l) do \
+       do {
+           d[n++] = digits[v % (unsigned)base];
+           v /= (unsigned)base;
+       } while (v);
+       width -= n + !!neg;
+       for (; !left && pad == ' ' && width > 0; --width) {
+           LOGGING_SIGNAL_PUTC(b, ' ');
+       }
+       if (neg) {
+           LOGGING_SIGNAL_PUTC(b, '-');
+       }
+       for (; !left && width > 0; --width) {
+           LOGGING_SIGNAL_PUTC(b, '0');
+       }
+       while (n > 0) {
+           LOGGING_SIGNAL_PUTC(b, d[--n]);
+       }
+       for (; width > 0; --width) {
+           LOGGING_SIGNAL_PUTC(b, ' ');
+       }
+   }
+   )
+#  define LOGGING_SIGNAL_L_INT 0
+#  define LOGGING_SIGNAL_L_CHAR 1
+#  define LOGGING_SIGNAL_L_SHORT 2
+#  define LOGGING_SIGNAL_L_LONG 3
+#  define LOGGING_SIGNAL_L_LLONG 4
+#  define LOGGING_SIGNAL_L_SIZE 5
+#  define LOGGING_SIGNAL_L_MAX 6
+#  define LOGGING_SIGNAL_L_PTRDIFF 7
+#  define LOGGING_SIGNAL_L_LDOUBLE 8
+   /* The next integer argument of length len, sign extended if sign. */
+   LOGGING_FUNC_DEF(
+   uint64_t LOGGING_SIGNAL_ARG(va_list *ap, int len, int sign),
    {
-       struct log_direction *dir = (r)->d.next;
-       while (dir) {
-           dir->write(dir->dir, m, l);
-           dir = dir->next;
+       switch (len) {
+       case LOGGING_SIGNAL_L_CHAR:
+           return sign ? (uint64_t)(signed char)va_arg(*ap, int)
+                       : (uint64_t)(unsigned char)va_arg(*ap, unsigned);
+       case LOGGING_SIGNAL_L_SHORT:
+           return sign ? (uint64_t)(short)va_arg(*ap, int)
+                       : (uint64_t)(unsigned short)va_arg(*ap, unsigned);
+       case LOGGING_SIGNAL_L_LONG:
+           return sign ? (uint64_t)va_arg(*ap, long)
+                       : (uint64_t)va_arg(*ap, unsigned long);
+       case LOGGING_SIGNAL_L_LLONG:
+           return sign ? (uint64_t)va_arg(*ap, long long)
+                       : (uint64_t)va_arg(*ap, unsigned long long);
+       case LOGGING_SIGNAL_L_SIZE:
+           return sign ? (uint64_t)(ptrdiff_t)va_arg(*ap, size_t)
+                       : (uint64_t)va_arg(*ap, size_t);
+       case LOGGING_SIGNAL_L_MAX:
+           return sign ? (uint64_t)va_arg(*ap, intmax_t)
+                       : (uint64_t)va_arg(*ap, uintmax_t);
+       case LOGGING_SIGNAL_L_PTRDIFF:
+           return (uint64_t)va_arg(*ap, ptrdiff_t);
+       default:
+           return sign ? (uint64_t)va_arg(*ap, int)
+                       : (uint64_t)va_arg(*ap, unsigned);
        }
    }
-# else
-#  define LOGGING_OTHER_DIR_ITER(r)
-# endif
-# ifdef LOGGING_LOG_COLOR
-#  define LOGGING_WRITE_WITH_COLOR(r, m, l) do \
-   { \
-       void *color[] = { \
-           LOGGING_CLEAR_COLOR, \
-           LOGGING_ERROR_COLOR, \
-           LOGGING_WARN_COLOR, \
-           LOGGING_INFO_COLOR, \
-           LOGGING_DEBUG_COLOR, \
-       }; \
-       LOGGING_PRINTF("write with color\n"); \
-       LOGGING_COLOR_SET(color[r->level]); \
-       (r)->d.write(r->d.dir, m, l); \
-       LOGGING_COLOR_SET(color[0]); \
-   } while (0)
-# else
-#  define LOGGING_WRITE_WITH_COLOR(r, m, l) (r)->d.write(r->d.dir, m, l)
-# endif
-
-# define LOGGING_RECORD_WRITE(r) do \
-{ \
-    char *msg = &((r)->message); \
-    size_t msg_len = strlen(msg); \
-    LOGGING_PRINTF("logging record write\n"); \
-    LOGGING_WRITE_WITH_COLOR(r, msg, msg_len); \
-    LOGGING_LOG_ROLLBACK((r)->d.dir); \
-    LOGGING_OTHER_DIR_ITER(r) \
-} while (0)
-
-/// record_add_format
-# if defined(LOGGING_EVIL_MODE)
-LOGGING_FUNC_DEF(
-log_format_t *LOGGING_RECORD_ADD_FORMAT(log_record_t *r, size_t s,
-    const char *n, log_format_format_t f),
-{
-    log_format_t *fmt, **tail;
-    LOGGING_PRINTF("alloc %d+%d, name: %s, fmt: %p\n",
-                   sizeof(log_format_t), s, n, f);
-
-    fmt = (log_format_t *)LOGGING_RECORD_MALLOC(r, sizeof(log_format_t)+s);
-    if (fmt != NULL) {
-        fmt->next = NULL;
-        fmt->name = n;
-        fmt->format = f;
-        tail = &(r->fmt);
-        while (*tail) {
-            tail = &((*tail)->next);
-        }
-        *tail = fmt;
-    }
+   )
+   /*
+     printf's d i u x X o p s c and %, with the flags - and 0, a width, a
+     precision for s (both may be *) and the lengths hh h l ll z j t. The
+     other conversions, e.g. floats, are copied as they are and their
+     argument skipped.
+   */
+   LOGGING_FUNC_DEF(
+   void LOGGING_SIGNAL_VFORMAT(log_signal_buf_t *b, const char *fmt,
+                               va_list *ap),
+   {
+       while (*fmt) {
+           const char *spec = fmt;
+           int left = 0, width = 0, prec = -1, len = LOGGING_SIGNAL_L_INT, n;
+           char pad = ' ', c[2] = { 0, 0 };
+           const char *s;
+           uint64_t v;
 
-    return fmt;
-}
-)
-# endif
-/// build_format
-LOGGING_FUNC_DEF(
-void LOGGING_BUILD_RECORD(log_record_t *r, const char *fmt, ...),
-{
-    LOGGING_BUILD_FORMAT(r);
+           if (*fmt != '%') {
+               LOGGING_SIGNAL_PUTC(b, *fmt++);
+               continue;
+           }
+           for (++fmt; *fmt && strchr("-0+ #", *fmt); ++fmt) {
+               left |= *fmt == '-';
+               pad = *fmt == '0' ? '0' : pad;
+           }
+           if (*fmt == '*') {
+               width = va_arg(*ap, int);
+               left |= width < 0;
+               width = width < 0 ? -width : width;
+               ++fmt;
+           }
+           for (; *fmt >= '0' && *fmt <= '9'; ++fmt) {
+               width = width * 10 + (*fmt - '0');
+           }
+           if (*fmt == '.') {
+               prec = *++fmt == '*' ? (++fmt, va_arg(*ap, int)) : 0;
+               for (; *fmt >= '0' && *fmt <= '9'; ++fmt) {
+                   prec = prec * 10 + (*fmt - '0');
+               }
+           }
+           pad = left ? ' ' : pad;
+           switch (*fmt) {
+           case 'h':
+               len = fmt[1] == 'h' ? (++fmt, LOGGING_SIGNAL_L_CHAR)
+                                   : LOGGING_SIGNAL_L_SHORT;
+               ++fmt;
+               break;
+           case 'l':
+               len = fmt[1] == 'l' ? (++fmt, LOGGING_SIGNAL_L_LLONG)
+                                   : LOGGING_SIGNAL_L_LONG;
+               ++fmt;
+               break;
+           case 'z': len = LOGGING_SIGNAL_L_SIZE; ++fmt; break;
+           case 'j': len = LOGGING_SIGNAL_L_MAX; ++fmt; break;
+           case 't': len = LOGGING_SIGNAL_L_PTRDIFF; ++fmt; break;
+           case 'L': len = LOGGING_SIGNAL_L_LDOUBLE; ++fmt; break;
+           }
+           switch (*fmt) {
+           case 'd': case 'i':
+               v = LOGGING_SIGNAL_ARG(ap, len, 1);
+               n = (int64_t)v < 0;
+               LOGGING_SIGNAL_PUTN(b, n ? 0 - v : v, n, 10, 0, width, pad,
+                                   left);
+               break;
+           case 'u': case 'x': case 'X': case 'o':
+               v = LOGGING_SIGNAL_ARG(ap, len, 0);
+               LOGGING_SIGNAL_PUTN(b, v, 0, *fmt == 'u' ? 10 : *fmt == 'o'
+                                   ? 8 : 16, *fmt == 'X', width, pad, left);
+               break;
+           case 'p':
+               v = (uint64_t)(uintptr_t)va_arg(*ap, void *);
+               LOGGING_SIGNAL_PUTS(b, "0x", -1);
+               LOGGING_SIGNAL_PUTN(b, v, 0, 16, 0, width - 2, pad, left);
+               break;
+           case 's': case 'c':
+               if (*fmt == 'c') {
+                   c[0] = (char)va_arg(*ap, int);
+                   s = c;
+                   prec = 1;
+               }
+               else {
+                   s = va_arg(*ap, const char *);
+                   s = s ? s : "(null)";
+               }
+               for (n = 0; s[n] && (prec < 0 || n < prec); ++n) {
+               }
+               for (; !left && width > n; --width) {
+                   LOGGING_SIGNAL_PUTC(b, ' ');
+               }
+               LOGGING_SIGNAL_PUTS(b, s, n);
+               for (; width > n; --width) {
+                   LOGGING_SIGNAL_PUTC(b, ' ');
+               }
+               break;
+           case '%':
+               LOGGING_SIGNAL_PUTC(b, '%');
+               break;
+           case 'n':
+               (void)va_arg(*ap, void *);
+               break;
+           case 'e': case 'E': case 'f': case 'F':
+           case 'g': case 'G': case 'a': case 'A':
+               if (len == LOGGING_SIGNAL_L_LDOUBLE) {
+                   (void)va_arg(*ap, long double);
+               }
+               else {
+                   (void)va_arg(*ap, double);
+               }
+               LOGGING_SIGNAL_PUTS(b, spec, (int)(fmt - spec) + 1);
+               break;
+           default:
+               LOGGING_SIGNAL_PUTS(b, spec, (int)(fmt - spec) + !!*fmt);
+               break;
+           }
+           fmt += !!*fmt;
+       }
+   }
+   )
+   /* The text separator or the JSON key of the next field. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_SIGNAL_KEY(log_signal_buf_t *b, int json, const char *key),
+   {
+       if (json) {
+           LOGGING_SIGNAL_PUTS(b, b->p - b->begin > 1 ? ",\"" : "\"", -1);
+           LOGGING_SIGNAL_PUTS(b, key, -1);
+           LOGGING_SIGNAL_PUTS(b, "\":", -1);
+       }
+       else if (b->p != b->begin) {
+           LOGGING_SIGNAL_PUTC(b, ' ');
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_SIGNAL_STRING(log_signal_buf_t *b, int json, const char *key,
+                              const char *v),
+   {
+       char *s;
+       LOGGING_SIGNAL_KEY(b, json, key);
+       if (json) {
+           LOGGING_SIGNAL_PUTC(b, '"');
+       }
+       s = b->p;
+       LOGGING_SIGNAL_PUTS(b, v, -1);
+       if (json) {
+           b->p = s + LOGGING_JSON_ESCAPE(s, (int)(b->p - s),
+                                          (int)(b->end - s) - 1);
+           LOGGING_SIGNAL_PUTC(b, '"');
+       }
+   }
+   )
+   /* v as "tag(v)" in text. */
+   LOGGING_FUNC_DEF(
+   void LOGGING_SIGNAL_NUMBER(log_signal_buf_t *b, int json, const char *key,
+                              const char *tag, uint64_t v),
+   {
+       LOGGING_SIGNAL_KEY(b, json, key);
+       if (!json) {
+           LOGGING_SIGNAL_PUTS(b, tag, -1);
+       }
+       LOGGING_SIGNAL_PUTN(b, v, 0, 10, 0, 0, ' ', 0);
+       if (!json) {
+           LOGGING_SIGNAL_PUTC(b, ')');
+       }
+   }
+   )
+   LOGGING_FUNC_DEF(
+   void LOGGING_SIGNAL_WRITE(int fd, const char *s, size_t n),
+   {
+       while (n > 0) {
+           ssize_t w = write(fd, s, n);
+           if (w < 0 && errno == EINTR) {
+               continue;
+           }
+           if (w <= 0) {
+               return;
+           }
+           s += w;
+           n -= (size_t)w;
+       }
+   }
+   )
 
-    va_list args;
-    va_start(args, fmt);
-    /* TODO: if message_len > message_size, than error */
-    r->message_len = vsnprintf(&(r->message)+(r->message_len),
-        (r->message_size)-(r->message_len), fmt, args);
-    va_end(args);
-}
-)
+/// log
+   /* Build the record in a free slot, then write it to every fd. */
+   LOGGING_FUNC_DEF(
+   void logging_signal_log(const log_signal_site_t *s, const char *fmt, ...),
+   {
+       int f = s->fields, json = !!(f & LOGGING_SIGNAL_F_JSON);
+       int i, n, slot = -1, idle, saved = errno;
+       log_signal_buf_t _b, *b = &_b;
+       struct timespec ts;
+       va_list args;
+       char *msg;
 
-/// init_record
-# define LOGGING_INIT_RECORD(record, level, seperator) \
-  LOGGING_MALLOC(record, LOGGING_LOG_RECORD_SIZE); \
-  record = LOGGING_LOG_RECORD_INIT(record, LOGGING_LOG_RECORD_SIZE, \
-                                   level, seperator);
+       /* a bounded spin, the holder may be the code this handler stopped */
+       for (i = 0; i < LOGGING_CONF_SIGNAL_SLOTS * 1024 && slot < 0; ++i) {
+           int k = i % LOGGING_CONF_SIGNAL_SLOTS;
+           idle = 0;
+           slot = LOGGING_ATOMIC_CAS(&logging_signal_busy[k], &idle, 1) ? k : -1;
+       }
+       if (slot < 0) {
+           LOGGING_ATOMIC_ADD(&logging_signal_dropped, 1);
+           return;
+       }
+       b->begin = b->p = logging_signal_slots[slot];
+       b->end = b->begin + LOGGING_CONF_SIGNAL_SIZE - 3; // for "\"}\n"
+       if (json) {
+           LOGGING_SIGNAL_PUTC(b, '{');
+       }
+       if (f & LOGGING_SIGNAL_F_LEVELFLAG) {
+           LOGGING_SIGNAL_STRING(b, json, "levelflag", s->levelflag);
+       }
+       if (f & LOGGING_SIGNAL_F_TIME) {
+           clock_gettime(CLOCK_REALTIME, &ts);
+           LOGGING_SIGNAL_KEY(b, json, "time");
+           LOGGING_SIGNAL_PUTS(b, json ? "" : "[", -1);
+           LOGGING_SIGNAL_PUTN(b, (uint64_t)ts.tv_sec, 0, 10, 0, 0, ' ', 0);
+           LOGGING_SIGNAL_PUTC(b, '.');
+           LOGGING_SIGNAL_PUTN(b, (uint64_t)ts.tv_nsec / 1000, 0, 10, 0, 6,
+                               '0', 0);
+           LOGGING_SIGNAL_PUTS(b, json ? "" : "]", -1);
+       }
+       if (f & LOGGING_SIGNAL_F_MONOTIME) {
+           clock_gettime(CLOCK_MONOTONIC, &ts);
+           LOGGING_SIGNAL_NUMBER(b, json, "mono", "mono(",
+               (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec);
+       }
+       if (f & LOGGING_SIGNAL_F_SEQN) {
+           LOGGING_SIGNAL_NUMBER(b, json, "seqn", "seq(",
+                                 LOGGING_SIGNAL_SEQN());
+       }
+       if (f & LOGGING_SIGNAL_F_PROCID) {
+           LOGGING_SIGNAL_NUMBER(b, json, "pid", "pid(", (uint64_t)getpid());
+       }
+       if (f & LOGGING_SIGNAL_F_THRDID) {
+           LOGGING_SIGNAL_NUMBER(b, json, "tid", "tid(",
+                                 LOGGING_SIGNAL_GETTID());
+       }
+       if (f & LOGGING_SIGNAL_F_MODULE) {
+           LOGGING_SIGNAL_STRING(b, json, "module", s->module);
+       }
+       if (f & LOGGING_SIGNAL_F_FILELINE) {
+           LOGGING_SIGNAL_STRING(b, json, "fileline", s->fileline);
+       }
+       if (f & LOGGING_SIGNAL_F_FUNCTION) {
+           LOGGING_SIGNAL_STRING(b, json, "function", s->function);
+       }
+       if (json) {
+           LOGGING_SIGNAL_KEY(b, json, "msg");
+           LOGGING_SIGNAL_PUTC(b, '"');
+       }
+       else if (b->p != b->begin) {
+           LOGGING_SIGNAL_PUTS(b, ": ", -1);
+       }
+       msg = b->p;
+       va_start(args, fmt);
+       LOGGING_SIGNAL_VFORMAT(b, fmt, &args);
+       va_end(args);
+       if (json) {
+           b->p = msg + LOGGING_JSON_ESCAPE(msg, (int)(b->p - msg),
+                                            (int)(b->end - msg));
+       }
+       b->end = b->begin + LOGGING_CONF_SIGNAL_SIZE;
+       LOGGING_SIGNAL_PUTS(b, json ? "\"}\n" : "\n", -1);
 
-/******************************************************************************/
-// Logging Locking
-/******************************************************************************/
-# ifdef LOGGING_LOG_LOCKING
-#  ifndef LOGGING_LOCK
-#   error You need to define LOGGING_LOCK()
+       n = LOGGING_ATOMIC_LOAD_ACQ(&logging_signal_nfds);
+       for (i = 0; i < (n ? n : 1); ++i) {
+           LOGGING_SIGNAL_WRITE(n ? logging_signal_fds[i] : STDERR_FILENO,
+                                b->begin, (size_t)(b->p - b->begin));
+       }
+       LOGGING_ATOMIC_STORE_REL(&logging_signal_busy[slot], 0);
+       errno = saved;
+   }
+   )
+# endif
+# if defined(LOGGING_CONF_SIGNAL_SAFE) \
+     && LOGGING_LOG_LEVEL >= LOGGING_ERROR_LEVEL
+   /* The caller's fields, checked when the record is built. */
+#  ifdef LOGGING_LOG_LEVELFLAG
+#   define LOGGING_SIGNAL_LEVELFLAG LOGGING_SIGNAL_F_LEVELFLAG
+#  else
+#   define LOGGING_SIGNAL_LEVELFLAG 0
 #  endif
-#  ifndef LOGGING_UNLOCK
-#   error You need to define LOGGING_UNLOCK()
+#  ifdef LOGGING_LOG_TIME
+#   define LOGGING_SIGNAL_TIME LOGGING_SIGNAL_F_TIME
+#  else
+#   define LOGGING_SIGNAL_TIME 0
 #  endif
-# else
-#  define LOGGING_LOCK()
-#  define LOGGING_UNLOCK()
-# endif
-
-/******************************************************************************/
-// Logging Threading
-/******************************************************************************/
-# ifdef LOGGING_LOG_THREAD
-#  ifndef LOGGING_LOG_RECORD_LIST
-#   error You need to define a log_record_t * as LOGGING_LOG_RECORD_LIST
+#  ifdef LOGGING_LOG_MONOTIME
+#   define LOGGING_SIGNAL_MONOTIME LOGGING_SIGNAL_F_MONOTIME
 #  else
-    extern log_record_t *LOGGING_LOG_RECORD_LIST;
+#   define LOGGING_SIGNAL_MONOTIME 0
 #  endif
-#  ifndef LOGGING_LOG_LOCKING
-#   error You need to enable LOGGING_LOG_LOCKING
+#  ifdef LOGGING_LOG_SEQN
+#   define LOGGING_SIGNAL_SEQNO LOGGING_SIGNAL_F_SEQN
+#  else
+#   define LOGGING_SIGNAL_SEQNO 0
 #  endif
-/// send record to process thread
-#  define LOGGING_WRITE_RECORD(r) do \
-   { \
-       LOGGING_LOCK(); \
-       if (LOGGING_LOG_RECORD_LIST == NULL) { \
-           (r)->next = (r); \
-           (r)->prev = (r); \
-       } \
-       else { \
-           (r)->next = LOGGING_LOG_RECORD_LIST; \
-           LOGGING_LOG_RECORD_LIST->prev->next = (r); \
-           (r)->prev = LOGGING_LOG_RECORD_LIST->prev; \
-           LOGGING_LOG_RECORD_LIST->prev = (r); \
-       } \
-       LOGGING_LOG_RECORD_LIST = (r); \
-       LOGGING_UNLOCK(); \
-   } while (0)
-#  define LOGGING_MALLOC(ptr, size) ptr = (log_record_t*)malloc(size);
-#  define LOGGING_FREE(ptr) free(ptr)
-/// process thread body
-#  define LOGGING_THREAD_LOOP(record_list) do \
+#  ifdef LOGGING_LOG_PROCID
+#   define LOGGING_SIGNAL_PROCID LOGGING_SIGNAL_F_PROCID
+#  else
+#   define LOGGING_SIGNAL_PROCID 0
+#  endif
+#  ifdef LOGGING_LOG_THRDID
+#   define LOGGING_SIGNAL_THRDID LOGGING_SIGNAL_F_THRDID
+#  else
+#   define LOGGING_SIGNAL_THRDID 0
+#  endif
+#  ifdef LOGGING_LOG_MODULE
+#   define LOGGING_SIGNAL_MODULE LOGGING_SIGNAL_F_MODULE
+#  else
+#   define LOGGING_SIGNAL_MODULE 0
+#  endif
+#  ifdef LOGGING_LOG_FILELINE
+#   define LOGGING_SIGNAL_FILELINE LOGGING_SIGNAL_F_FILELINE
+#  else
+#   define LOGGING_SIGNAL_FILELINE 0
+#  endif
+#  ifdef LOGGING_LOG_FUNCTION
+#   define LOGGING_SIGNAL_FUNCTION LOGGING_SIGNAL_F_FUNCTION
+#  else
+#   define LOGGING_SIGNAL_FUNCTION 0
+#  endif
+#  ifdef LOGGING_LOG_JSON
+#   define LOGGING_SIGNAL_JSON LOGGING_SIGNAL_F_JSON
+#  else
+#   define LOGGING_SIGNAL_JSON 0
+#  endif
+#  define LOGGING_SIGNAL_FIELDS (LOGGING_SIGNAL_LEVELFLAG \
+   | LOGGING_SIGNAL_TIME | LOGGING_SIGNAL_MONOTIME | LOGGING_SIGNAL_SEQNO \
+   | LOGGING_SIGNAL_PROCID | LOGGING_SIGNAL_THRDID | LOGGING_SIGNAL_MODULE \
+   | LOGGING_SIGNAL_FILELINE | LOGGING_SIGNAL_FUNCTION | LOGGING_SIGNAL_JSON)
+#  ifdef LOGGING_DIR_FILE
+#   define LOGGING_SIGNAL_FWRITE logging_dir_fwrite
+#  else
+#   define LOGGING_SIGNAL_FWRITE NULL
+#  endif
+#  define LOG_SIGNAL_SAFE(fmt, ...) do \
    { \
-       log_record *tail_record; \
-       LOGGING_LOCK(); \
-       if ((record_list) == NULL) { \
-           LOGGING_UNLOCK(); \
-           break; \
-       } \
-       tail_record = (record_list)->prev; \
-       tail_record->prev->next = (record_list); \
-       (record_list)->prev = tail_record->prev; \
-       tail_record->next = NULL; \
-       tail_record->prev = NULL; \
-       if ((record_list)->next == NULL && (record_list)->prev == NULL) { \
-           (record_list) = NULL; \
-       } \
-       LOGGING_UNLOCK(); \
-       LOGGING_RECORD_WRITE(tail_record); \
-       LOGGING_FREE(tail_record); \
+       static const log_signal_site_t _sig = { LOGGING_SIGNAL_FIELDS, \
+           "" LOGGING_ERROR_FLAG, LOGGING_MODULE_NAME, \
+           __FILE__ "(" LOGGING_STR(__LINE__) ")", __FUNCTION__ }; \
+       logging_signal_log(&_sig, fmt, ##__VA_ARGS__); \
    } while (0)
-# else
-/// directly write
-#  define LOGGING_WRITE_RECORD(log_record) do \
+   /* Resolve the fds of the caller's FILE * directions, e.g. in main. */
+#  define LOG_SIGNAL_SAFE_SETUP() do \
    { \
-       LOGGING_LOCK(); \
-       LOGGING_RECORD_WRITE(log_record); \
-       LOGGING_UNLOCK(); \
-       LOGGING_FREE(log_record); \
+       log_direction_t _d = { LOGGING_DIRECTION_NEXT, \
+                              (void *)(LOGGING_DIRECTION), LOGGING_DIR_WRITE }; \
+       logging_signal_directions(&_d, LOGGING_SIGNAL_FWRITE); \
    } while (0)
-#  define LOGGING_MALLOC(ptr, size) char mem[size]; ptr = (log_record_t*)mem
-#  define LOGGING_FREE(ptr)
-#  define LOGGING_THREAD_LOOP(dummy)
-# endif
-
-/******************************************************************************/
-// Dynamic Logging Level
-/******************************************************************************/
-# ifdef LOGGING_CONF_DYNAMIC_LOG_LEVEL
-#  ifndef LOGGING_LOG_MODULE
-#   define LOGGING_DYNAMIC_LOG_LEVEL_CHECK_M(l)
-#  else
-#   define LOGGING_DYNAMIC_LOG_LEVEL_CHECK_M(l) \
-    { \
-        const char *s = LOGGING_LOG_MODULE "_LOGGING_LOG_LEVEL"; \
-        if (((s = getenv(s)) != NULL) && (atoi(s) < l)) break; \
-    }
-#  endif
-#  define LOGGING_DYNAMIC_LOG_LEVEL_CHECK(l) \
-   { \
-       LOGGING_DYNAMIC_LOG_LEVEL_CHECK_M(l); \
-       const char *s = "LOGGING_LOG_LEVEL"; \
-       if (((s = getenv(s)) != NULL) && (atoi(s) < l)) break;\
-   }
 # else
-#  define LOGGING_DYNAMIC_LOG_LEVEL_CHECK(l)
+#  define LOG_SIGNAL_SAFE(fmt, ...)
+#  define LOG_SIGNAL_SAFE_SETUP()
 # endif
 
-// Macro Entry
-# define LOG_LEVEL(level, fmt, ...) do \
-{ \
-    LOGGING_DYNAMIC_LOG_LEVEL_CHECK(level); \
-    log_record_t *r; \
-    log_logger_t _l, *l = &_l; \
-    LOGGING_INIT_RECORD(r, level, FORMAT_COLON); \
-    LOGGING_INIT_LOGGER(l, level); \
-    LOGGING_INIT_DIRECTION(r, l); \
-    LOGGING_INIT_FORMAT(r, l); \
-    LOGGING_BUILD_RECORD(r, fmt "\n", ##__VA_ARGS__); \
-    LOGGING_WRITE_RECORD(r); \
-} while (0)
-
 /******************************************************************************/
 // Basic Interfaces
 /******************************************************************************/
 # if LOGGING_LOG_LEVEL >= LOGGING_DEBUG_LEVEL
 #  define LOG_DEBUG(fmt, ...) LOG_LEVEL(LOGGING_DEBUG_LEVEL, fmt, ##__VA_ARGS__)
+#  define LOG_DEBUG_KV(msg, ...) \
+   LOG_LEVEL_KV(LOGGING_DEBUG_LEVEL, msg, ##__VA_ARGS__)
 # else
 #  define LOG_DEBUG(fmt, ...)
+#  define LOG_DEBUG_KV(msg, ...)
 # endif
 # if LOGGING_LOG_LEVEL >= LOGGING_INFO_LEVEL
 #  define LOG_INFO(fmt, ...) LOG_LEVEL(LOGGING_INFO_LEVEL, fmt, ##__VA_ARGS__)
+#  define LOG_INFO_KV(msg, ...) \
+   LOG_LEVEL_KV(LOGGING_INFO_LEVEL, msg, ##__VA_ARGS__)
 # else
 #  define LOG_INFO(fmt, ...)
+#  define LOG_INFO_KV(msg, ...)
 # endif
 # if LOGGING_LOG_LEVEL >= LOGGING_WARN_LEVEL
 #  define LOG_WARN(fmt, ...) LOG_LEVEL(LOGGING_WARN_LEVEL, fmt, ##__VA_ARGS__)
+#  define LOG_WARN_KV(msg, ...) \
+   LOG_LEVEL_KV(LOGGING_WARN_LEVEL, msg, ##__VA_ARGS__)
 # else
 #  define LOG_WARN(fmt, ...)
+#  define LOG_WARN_KV(msg, ...)
 # endif
 # if LOGGING_LOG_LEVEL >= LOGGING_ERROR_LEVEL
 #  define LOG_ERROR(fmt, ...) LOG_LEVEL(LOGGING_ERROR_LEVEL, fmt, ##__VA_ARGS__)
+#  define LOG_ERROR_KV(msg, ...) \
+   LOG_LEVEL_KV(LOGGING_ERROR_LEVEL, msg, ##__VA_ARGS__)
 # else
 #  define LOG_ERROR(fmt, ...)
+#  define LOG_ERROR_KV(msg, ...)
 # endif
 
 /******************************************************************************/
 // Extend Interfaces
 /******************************************************************************/
 # if LOGGING_LOG_LEVEL >= LOGGING_DEBUG_LEVEL
-#  define LOG_BUFFER(msg, buff, cnt) do \
+#  ifdef LOGGING_CONF_SLOW_PATH
+#   define LOG_BUFFER(msg, buff, cnt) do \
    { \
-       log_record_t *r; \
-       struct log_logger _l, *l = &_l; \
-       LOGGING_INIT_RECORD(r, LOGGING_DEBUG_LEVEL, FORMAT_SPACE); \
-       LOGGING_INIT_LOGGER(l, LOGGING_DEBUG_LEVEL); \
-       LOGGING_INIT_FORMAT(r, l); \
-       LOGGING_INIT_DIRECTION(r, l); \
-       LOGGING_BUILD_FORMAT(r); \
-       /* TODO: if message_len > message_size, then error */ \
-       r->message_len += snprintf( \
-           &(r->message)+r->message_len,  \
-           r->message_size-r->message_len, \
-           "%s", msg); \
-       for (int i = 0; i < cnt; ++i) { \
-           r->message_len += snprintf( \
-               &(r->message)+r->message_len,   \
-               r->message_size-r->message_len, \
-               " %02X%s"+!i, (uint8_t)(buff[i]), ((i+1)==cnt) ? "\n" : ""); \
-       } \
-       LOGGING_WRITE_RECORD(r); \
+       LOGGING_SITE_DEF(LOGGING_DEBUG_LEVEL); \
+       LOGGING_SITE_CHECK(); \
+       LOGGING_CALL_DEF(LOGGING_DEBUG_LEVEL); \
+       LOGGING_CALL_BUFFER(&_call, &_d, msg, (const uint8_t *)(buff), \
+                           (int)(cnt)); \
+   } while (0)
+#  else
+#   define LOG_BUFFER(msg, buff, cnt) do \
+   { \
+       LOGGING_SITE_DEF(LOGGING_DEBUG_LEVEL); \
+       LOGGING_SITE_CHECK(); \
+       const uint8_t *_buff = (const uint8_t *)(buff); \
+       int _cnt = (int)(cnt), _off = 0, _n; \
+       do { \
+           log_record_t *r; \
+           struct log_logger _l, *l = &_l; \
+           LOGGING_INIT_RECORD(r, LOGGING_DEBUG_LEVEL, FORMAT_SPACE); \
+           LOGGING_CHECK_RECORD(r, LOGGING_DEBUG_LEVEL); \
+           LOGGING_INIT_LOGGER(l, LOGGING_DEBUG_LEVEL); \
+           LOGGING_INIT_FORMAT(r, l); \
+           LOGGING_INIT_DIRECTION(r, l); \
+           LOGGING_BUILD_FORMAT(r); \
+           _n = LOGGING_BUILD_BUFFER(r, msg, _buff+_off, _cnt-_off, _off); \
+           _off = _n > 0 ? _off + _n : _cnt; /* none fit: truncated */ \
+           LOGGING_RECORD_END(r); \
+           LOGGING_SITE_PROFILE(r); \
+           LOGGING_WRITE_RECORD(r); \
+       } while (_off < _cnt); \
    } while (0)
+#  endif
 
 #  define LOG_IF(expr, fmt, ...) if (expr) LOG_DEBUG(fmt, ##__VA_ARGS__)
-#  define LOG_IF_CHANGED(var, fmt, ...) do \
+#  define LOGGING_IF_CHANGED(cls, var, fmt, ...) do \
    { \
-       static char mem[sizeof(var)]; \
-       if (memcmp(mem, &var, sizeof(mem)) != 0) { \
-           memcpy(mem, &var, sizeof(mem)); \
+       static cls uint64_t _seen; \
+       if (LOGGING_CHANGED(&_seen, LOGGING_CHANGED_HASH(&(var), \
+                                                         sizeof(var)))) { \
            LOG_DEBUG(fmt, ##__VA_ARGS__); \
        } \
    } while (0)
+#  define LOGGING_IF_CHANGED_VALUE(cls, type, var, vfmt, fmt, ...) do \
+   { \
+       static cls struct { uint64_t seen; int lock; type value; } _snap; \
+       type _new, _old; \
+       uint64_t _h; \
+       (void)sizeof(char[sizeof(_new) == sizeof(var) ? 1 : -1]); \
+       memcpy(&_new, &(var), sizeof(_new)); /* padding too */ \
+       _h = LOGGING_CHANGED_HASH(&_new, sizeof(_new)); \
+       if (LOGGING_ATOMIC_LOAD(&_snap.seen) != _h) { \
+           int _changed; \
+           LOGGING_CHANGED_LOCK(&_snap.lock); \
+           _changed = _snap.seen != _h; \
+           _old = _snap.value; \
+           _snap.value = _new; \
+           LOGGING_ATOMIC_STORE(&_snap.seen, _h); \
+           LOGGING_CHANGED_UNLOCK(&_snap.lock); \
+           if (_changed) { \
+               LOG_DEBUG(fmt " (" vfmt " -> " vfmt ")", ##__VA_ARGS__, \
+                         _old, _new); \
+           } \
+       } \
+   } while (0)
+#  define LOG_IF_CHANGED(var, fmt, ...) \
+   LOGGING_IF_CHANGED(, var, fmt, ##__VA_ARGS__)
+#  define LOG_IF_CHANGED_THREAD(var, fmt, ...) \
+   LOGGING_IF_CHANGED(LOGGING_THREAD_LOCAL, var, fmt, ##__VA_ARGS__)
+#  define LOG_IF_CHANGED_VALUE(type, var, vfmt, fmt, ...) \
+   LOGGING_IF_CHANGED_VALUE(, type, var, vfmt, fmt, ##__VA_ARGS__)
+#  define LOG_IF_CHANGED_VALUE_THREAD(type, var, vfmt, fmt, ...) \
+   LOGGING_IF_CHANGED_VALUE(LOGGING_THREAD_LOCAL, type, var, vfmt, fmt, \
+                            ##__VA_ARGS__)
 #  define LOG_ELSE(fmt, ...) else LOG_DEBUG(fmt, ##__VA_ARGS__)
 #  define LOG_DEBUG_VAR(type, name, init) type name = init
 # else
 #  define LOG_BUFFER(...)
 #  define LOG_IF(...)
 #  define LOG_IF_CHANGED(...)
+#  define LOG_IF_CHANGED_THREAD(...)
+#  define LOG_IF_CHANGED_VALUE(...)
+#  define LOG_IF_CHANGED_VALUE_THREAD(...)
 #  define LOG_ELSE(...)
 #  define LOG_DEBUG_VAR(type, name, init)
 # endif
@@ -1142,9 +7247,21 @@ void LOGGING_BUILD_RECORD(log_record_t *r, const char *fmt, ...),
 # define LOG_INFO(fmt, ...)
 # define LOG_WARN(fmt, ...)
 # define LOG_ERROR(fmt, ...)
+# define LOG_DEBUG_KV(...)
+# define LOG_INFO_KV(...)
+# define LOG_WARN_KV(...)
+# define LOG_ERROR_KV(...)
 # define LOG_BUFFER(...)
 # define LOG_IF(...)
 # define LOG_IF_CHANGED(...)
+# define LOG_IF_CHANGED_THREAD(...)
+# define LOG_IF_CHANGED_VALUE(...)
+# define LOG_IF_CHANGED_VALUE_THREAD(...)
+# define LOG_SCOPE_TIMER(name)
+# define LOG_TIMER_BEGIN(id)
+# define LOG_TIMER_END(id)
+# define LOG_SIGNAL_SAFE(fmt, ...)
+# define LOG_SIGNAL_SAFE_SETUP()
 # define LOG_ELSE(...)
 # define LOG_DEBUG_VAR(type, name, init)
 
@@ -1153,3 +7270,415 @@ void LOGGING_BUILD_RECORD(log_record_t *r, const char *fmt, ...),
 #ifdef __cplusplus
 }
 #endif
+
+/******************************************************************************/
+// C++ Interfaces
+/******************************************************************************/
+/*
+  With LOGGING_CONF_CXX (C++17), logging::info("x={} y={}", x, y) formats
+  with type specific writers straight into the record, no printf varargs.
+  A format given as LOGGING_FMT("x={}") is split into constexpr segments,
+  and a bad format or argument count fails to compile. Being a type of its
+  own, it is also the call site of LOGGING_CONF_SITES.
+*/
+#if defined(__cplusplus) && defined(LOGGING_CONF_CXX) \
+    && !defined(LOGGING_CXX_H_)
+# define LOGGING_CXX_H_
+# if __cplusplus < 201703L && !(defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#  error LOGGING_CONF_CXX needs C++17
+# endif
+# include <charconv>
+# include <string>
+# include <string_view>
+# include <type_traits>
+# include <utility>
+# if defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1926)
+#  define LOGGING_CXX_FILE() __builtin_FILE()
+#  define LOGGING_CXX_LINE() __builtin_LINE()
+#  define LOGGING_CXX_FUNCTION() __builtin_FUNCTION()
+# else
+#  define LOGGING_CXX_FILE() ""
+#  define LOGGING_CXX_LINE() 0
+#  define LOGGING_CXX_FUNCTION() ""
+# endif
+/* A format checked at compile time, e.g. LOGGING_FMT("x={}"). */
+# define LOGGING_FMT(s) ::logging::detail::at([] { \
+      struct string { static constexpr const char *str() { return s; } }; \
+      return ::logging::format<string>(); \
+  }(), __FILE__, __LINE__, __func__)
+namespace logging
+{
+namespace detail
+{
+struct location
+{
+    const char *file;
+    int line;
+    const char *function;
+};
+} // namespace detail
+/// writers
+/*
+  Appends to the message being built, cut at the record's limit less the
+  tail its translation unit ends a record with.
+*/
+class buffer
+{
+public:
+    buffer(log_record_t *r, int tail) : r_(r), tail_(tail) {}
+    void append(const char *s, size_t n)
+    {
+        int cap = r_->message_size - 1 - tail_;
+        if (r_->message_len + (int)n > cap) {
+            if (LOGGING_RECORD_RESERVE(r_, r_->message_len + (int)n + 1
+                                       + tail_)) {
+                cap = r_->message_size - 1 - tail_;
+            }
+            if (r_->message_len + (int)n > cap) {
+                n = cap > r_->message_len ? (size_t)(cap - r_->message_len) : 0;
+                r_->message_trunc = 1;
+            }
+        }
+        memcpy(r_->message_buf + r_->message_len, s, n);
+        r_->message_len += (int)n;
+    }
+    void append(std::string_view s) { append(s.data(), s.size()); }
+private:
+    log_record_t *r_;
+    int tail_;
+};
+/*
+  How a T is written, specialize it for other types:
+    template <> struct logging::writer<point> {
+        static void write(logging::buffer &b, const point &p);
+    };
+*/
+template <class T, class Enable = void>
+struct writer
+{
+    static_assert(sizeof(T) == 0, "logging: no logging::writer for this type");
+};
+template <class T>
+struct writer<T, std::enable_if_t<std::is_integral_v<T>
+                                  && !std::is_same_v<T, bool>
+                                  && !std::is_same_v<T, char>>>
+{
+    static void write(buffer &b, T v)
+    {
+        char s[24];
+        b.append(s, (size_t)(std::to_chars(s, s + sizeof(s), v).ptr - s));
+    }
+};
+template <class T>
+struct writer<T, std::enable_if_t<std::is_floating_point_v<T>>>
+{
+    static void write(buffer &b, T v)
+    {
+        char s[32];
+# if defined(__cpp_lib_to_chars)
+        b.append(s, (size_t)(std::to_chars(s, s + sizeof(s), v).ptr - s));
+# else
+        int n = snprintf(s, sizeof(s), "%g", (double)v);
+        b.append(s, n > 0 ? (size_t)n : 0);
+# endif
+    }
+};
+template <class T>
+struct writer<T, std::enable_if_t<std::is_enum_v<T>>>
+{
+    static void write(buffer &b, T v)
+    {
+        writer<std::underlying_type_t<T>>::write(b,
+            static_cast<std::underlying_type_t<T>>(v));
+    }
+};
+template <>
+struct writer<bool>
+{
+    static void write(buffer &b, bool v) { b.append(v ? "true" : "false"); }
+};
+template <>
+struct writer<char>
+{
+    static void write(buffer &b, char v) { b.append(&v, 1); }
+};
+template <class T>
+struct writer<T, std::enable_if_t<std::is_convertible_v<T, std::string_view>>>
+{
+    static void write(buffer &b, const T &v)
+    {
+        if constexpr (std::is_pointer_v<T>) {
+            b.append(v ? std::string_view(v) : std::string_view("(null)"));
+        }
+        else {
+            b.append(std::string_view(v));
+        }
+    }
+};
+template <class T>
+struct writer<T, std::enable_if_t<(std::is_pointer_v<T>
+                                   || std::is_null_pointer_v<T>)
+                                  && !std::is_convertible_v<T,
+                                                            std::string_view>>>
+{
+    static void write(buffer &b, T v)
+    {
+        char s[2 + 2 * sizeof(void *)] = { '0', 'x' };
+        auto end = std::to_chars(s + 2, s + sizeof(s),
+                                 (uintptr_t)(const void *)v, 16).ptr;
+        b.append(s, (size_t)(end - s));
+    }
+};
+/// formats
+namespace detail
+{
+constexpr size_t length(const char *s)
+{
+    size_t n = 0;
+    while (s[n]) {
+        ++n;
+    }
+    return n;
+}
+/* The text without placeholders, argument i goes at offset[i+1]. */
+template <size_t N>
+struct parsed
+{
+    char text[N + 1];
+    size_t offset[N + 2];
+    size_t args;
+    bool ok;
+};
+template <size_t N>
+constexpr parsed<N> parse(const char *s)
+{
+    parsed<N> p{};
+    size_t n = 0;
+    p.ok = true;
+    for (size_t i = 0; s[i]; ++i) {
+        if ((s[i] == '{' || s[i] == '}') && s[i+1] == s[i]) {
+            p.text[n++] = s[i++];
+        }
+        else if (s[i] == '{' && s[i+1] == '}') {
+            p.offset[++p.args] = n;
+            ++i;
+        }
+        else if (s[i] == '{' || s[i] == '}') {
+            p.ok = false;
+        }
+        else {
+            p.text[n++] = s[i];
+        }
+    }
+    p.offset[p.args + 1] = n;
+    return p;
+}
+} // namespace detail
+template <class F>
+struct format
+{
+    static constexpr auto value =
+        detail::parse<detail::length(F::str())>(F::str());
+    detail::location at;
+};
+namespace detail
+{
+template <class F>
+format<F> at(format<F> f, const char *file, int line, const char *function)
+{
+    f.at = location{ file, line, function };
+    return f;
+}
+/* A runtime format, converting from it takes the caller's location. */
+struct format_string
+{
+    format_string(const char *s, const char *file = LOGGING_CXX_FILE(),
+                  int line = LOGGING_CXX_LINE(),
+                  const char *function = LOGGING_CXX_FUNCTION())
+        : str(s), at{ file, line, function }
+    {
+    }
+    const char *str;
+    location at;
+};
+template <class T>
+void write(buffer &b, const T &v)
+{
+    writer<std::decay_t<const T &>>::write(b, v);
+}
+/* A runtime format: placeholders without an argument are kept as is. */
+template <class... A>
+void write_format(buffer &b, const char *s, const A &...a)
+{
+    void (*writers[])(buffer &, const void *) = {
+        [](buffer &o, const void *v) { write(o, *(const A *)v); }..., nullptr
+    };
+    const void *args[] = { (const void *)&a..., nullptr };
+    size_t next = 0, i = 0, start = 0;
+    for (; s[i]; ++i) {
+        if ((s[i] == '{' || s[i] == '}') && s[i+1] == s[i]) {
+            b.append(s + start, i + 1 - start);
+            start = ++i + 1;
+        }
+        else if (s[i] == '{' && s[i+1] == '}' && next < sizeof...(A)) {
+            b.append(s + start, i - start);
+            writers[next](b, args[next]);
+            ++next;
+            start = ++i + 1;
+        }
+    }
+    b.append(s + start, i - start);
+}
+template <class F, size_t... I, class... A>
+void write_format(buffer &b, format<F>, std::index_sequence<I...>,
+                  const A &...a)
+{
+    constexpr auto &p = format<F>::value;
+    static_assert(p.ok, "logging: a { or } is not escaped as {{ or }}");
+    static_assert(p.args == sizeof...(A),
+                  "logging: the format and the arguments count differ");
+    ((b.append(p.text + p.offset[I], p.offset[I+1] - p.offset[I]),
+      write(b, a)), ...);
+    b.append(p.text + p.offset[p.args],
+             p.offset[p.args + 1] - p.offset[p.args]);
+}
+template <class F, class... A>
+void write_format(buffer &b, format<F> f, const A &...a)
+{
+    write_format(b, f, std::index_sequence_for<A...>(), a...);
+}
+/*
+  What depends on the configuration of the translation unit (module,
+  formats, direction, sites) has internal linkage, else the linker keeps
+  the instantiation of one unit for all of them.
+*/
+namespace
+{
+# ifdef LOG_LEVEL
+/* The site of a compile-time format, which is a type of its own. */
+template <int Level, class F>
+void *site(const location &at)
+{
+#  ifdef LOGGING_FEAT_SITES
+    if constexpr (!std::is_same_v<F, const char *>) {
+        static log_site_t s = [&] {
+            log_site_t x{};
+            x.file = at.file;
+            x.function = at.function;
+            x.module = LOGGING_MODULE_NAME;
+            x.line = at.line;
+            x.level = Level;
+            x.enabled = Level <= LOGGING_CONF_SITES_LEVEL;
+            return x;
+        }();
+        if (!LOGGING_ATOMIC_LOAD_ACQ(&s.registered)) {
+            LOGGING_SITE_REGISTER(&s);
+        }
+        return &s;
+    }
+#  endif
+    (void)at;
+    return nullptr;
+}
+template <class B>
+void build(log_record_t *r, const void *p)
+{
+    LOGGING_STATS_BEGIN(t);
+    buffer b(r, LOGGING_RECORD_TAIL_LEN);
+    (*(const B *)p)(b);
+    b.append("\n", 1);
+    LOGGING_STATS_END(LOGGING_STATS_RECORD, t);
+}
+template <int Level, class F, class... A>
+void log(const location &at, const F &f, const A &...a)
+{
+    if constexpr (Level <= LOGGING_LOG_LEVEL) {
+#  ifdef LOGGING_CONF_DYNAMIC_LOG_LEVEL
+        if (LOGGING_MODULE_LEVEL() < Level) {
+            LOGGING_METRICS_ADD(Level, LOGGING_METRICS_FILTERED, 1);
+            return;
+        }
+#  endif
+        void *s = site<Level, F>(at);
+        auto message = [&](buffer &b) { write_format(b, f, a...); };
+        const char *fl = at.file;
+#  ifdef LOGGING_LOG_FILELINE
+        char fileline[256], line[16];
+        size_t n = strlen(at.file), m;
+#  endif
+#  ifdef LOGGING_CONF_SITES
+        if (s && !LOGGING_ATOMIC_LOAD(&((log_site_t *)s)->enabled)) {
+            return;
+        }
+#  endif
+#  ifdef LOGGING_LOG_FILELINE
+        m = (size_t)(std::to_chars(line, line + sizeof(line), at.line).ptr
+                     - line);
+        if (n + m + 3 <= sizeof(fileline)) { // file(line)
+            memcpy(fileline, at.file, n);
+            fileline[n] = '(';
+            memcpy(fileline + n + 1, line, m);
+            memcpy(fileline + n + 1 + m, ")", 2);
+            fl = fileline;
+        }
+#  endif
+#  ifdef LOGGING_CONF_SLOW_PATH
+        const log_call_t c = { Level, at.line, at.file, fl, at.function,
+                               LOGGING_CALL_LOG, s };
+        const log_direction_t d = { LOGGING_DIRECTION_NEXT,
+                                    (void *)(LOGGING_DIRECTION),
+                                    LOGGING_DIR_WRITE };
+        LOGGING_CALL_BUILD(&c, &d, build<decltype(message)>, &message);
+#  else
+        do {
+            log_record_t *r;
+            log_logger_t _l, *l = &_l;
+            LOGGING_INIT_RECORD(r, Level, FORMAT_COLON);
+            LOGGING_CHECK_RECORD(r, Level);
+            LOGGING_INIT_LOGGER(l, Level);
+            l->function = at.function;
+            l->flie = at.file;
+            l->line = at.line;
+            l->fileline = fl;
+            LOGGING_INIT_DIRECTION(r, l);
+            LOGGING_INIT_FORMAT(r, l);
+            LOGGING_BUILD_FORMAT(r);
+            build<decltype(message)>(r, &message);
+            LOGGING_RECORD_END(r);
+            if (s) {
+                LOGGING_SITE_PROFILE_AT((log_site_t *)s, r);
+            }
+            LOGGING_WRITE_RECORD(r);
+        } while (0);
+#  endif
+    }
+}
+# else
+template <int Level, class F, class... A>
+void log(const location &, const F &, const A &...)
+{
+}
+# endif
+} // namespace
+} // namespace detail
+/// interfaces
+# define LOGGING_CXX_LEVEL(NAME, LEVEL) \
+  template <class... A> \
+  void NAME(detail::format_string f, const A &...a) \
+  { \
+      detail::log<LEVEL>(f.at, f.str, a...); \
+  } \
+  template <class F, class... A> \
+  void NAME(const format<F> &f, const A &...a) \
+  { \
+      detail::log<LEVEL>(f.at, f, a...); \
+  }
+namespace // as detail::log
+{
+LOGGING_CXX_LEVEL(debug, LOGGING_DEBUG_LEVEL)
+LOGGING_CXX_LEVEL(info, LOGGING_INFO_LEVEL)
+LOGGING_CXX_LEVEL(warn, LOGGING_WARN_LEVEL)
+LOGGING_CXX_LEVEL(error, LOGGING_ERROR_LEVEL)
+} // namespace
+} // namespace logging
+#endif // LOGGING_CONF_CXX
@@ -0,0 +1,116 @@
+/*
+  Tiny harness shared by the benchmarks: one timed pass for throughput, one
+  pass timing every call for the latency percentiles, and one JSON object
+  per line appended to the result file (stderr if none is given).
+*/
+#ifndef LOGGING_BENCH_H_
+#define LOGGING_BENCH_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct bench_result
+{
+    const char *name;
+    int threads;
+    long calls;
+    double ns_per_call;
+    double calls_per_sec;
+    int64_t p50;
+    int64_t p99;
+    int64_t p999;
+    int64_t max;
+} bench_result_t;
+
+static inline int64_t bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static inline void bench_percentiles(bench_result_t *r, int64_t *lat, long n)
+{
+    if (n <= 0) {
+        return;
+    }
+    qsort(lat, n, sizeof(int64_t), bench_cmp);
+    r->p50 = lat[n * 50 / 100];
+    r->p99 = lat[n * 99 / 100];
+    r->p999 = lat[n * 999 / 1000];
+    r->max = lat[n-1];
+}
+
+static inline void bench_report(const bench_result_t *r, const char *path)
+{
+    FILE *out = path ? fopen(path, "a") : stderr;
+    if (out == NULL) {
+        perror(path);
+        return;
+    }
+    fprintf(out, "{\"name\":\"%s\",\"threads\":%d,\"calls\":%ld,"
+                 "\"ns_per_call\":%.1f,\"calls_per_sec\":%.0f,"
+                 "\"p50_ns\":%lld,\"p99_ns\":%lld,\"p999_ns\":%lld,"
+                 "\"max_ns\":%lld}\n",
+            r->name, r->threads, r->calls, r->ns_per_call, r->calls_per_sec,
+            (long long)r->p50, (long long)r->p99, (long long)r->p999,
+            (long long)r->max);
+    if (out != stderr) {
+        fclose(out);
+    }
+}
+
+/* run fn n times on the calling thread */
+static inline void bench_single(const char *name, long n, void (*fn)(long),
+                                const char *path)
+{
+    bench_result_t r;
+    int64_t *lat = (int64_t *)malloc(sizeof(int64_t) * n);
+    int64_t t0, t1;
+    long i;
+
+    memset(&r, 0, sizeof(r));
+    r.name = name;
+    r.threads = 1;
+    r.calls = n;
+
+    for (i = 0; i < n / 10; ++i) { // warm up
+        fn(i);
+    }
+
+    t0 = bench_now();
+    for (i = 0; i < n; ++i) {
+        fn(i);
+    }
+    t1 = bench_now();
+    r.ns_per_call = (double)(t1 - t0) / n;
+    r.calls_per_sec = n * 1e9 / (double)(t1 - t0);
+
+    for (i = 0; i < n; ++i) {
+        t0 = bench_now();
+        fn(i);
+        lat[i] = bench_now() - t0;
+    }
+    bench_percentiles(&r, lat, n);
+    bench_report(&r, path);
+    free(lat);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LOGGING_BENCH_H_
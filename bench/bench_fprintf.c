@@ -0,0 +1,35 @@
+/*
+  Baseline: a raw fprintf of a line like the logging benchmarks produce.
+
+  usage: bench_fprintf [calls] [result.jsonl]
+*/
+#include "bench.h"
+
+#include <sys/time.h>
+
+static FILE *bench_sink;
+
+static void bench_call(long i)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    fprintf(bench_sink, "[I] [%ld.%06ld]: bench %ld %s\n",
+            (long)tv.tv_sec, (long)tv.tv_usec, i, "payload");
+}
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? atol(argv[1]) : 200000;
+    const char *path = argc > 2 ? argv[2] : NULL;
+
+    bench_sink = fopen("/dev/null", "w");
+    if (bench_sink == NULL) {
+        perror("sink");
+        return -1;
+    }
+
+    bench_single("fprintf", n, bench_call, path);
+
+    fclose(bench_sink);
+    return 0;
+}
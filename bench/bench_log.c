@@ -0,0 +1,63 @@
+/*
+  One logging call per iteration. The configuration under test comes from
+  the compile definitions set in CMakeLists.txt.
+
+  usage: bench_xxx [calls] [result.jsonl]
+*/
+#include "bench.h"
+
+FILE *bench_sink;
+
+#if defined(LOGGING_LOG_COLOR)
+# define LOGGING_DIR_ISATTY(dir) 1 // color the sink as if it was a terminal
+#endif
+#include "Logging.h"
+
+static void bench_call(long i)
+{
+    LOG_INFO("bench %ld %s", i, "payload");
+}
+
+#if defined(LOGGING_CONF_STATS)
+static void bench_stats(void)
+{
+    const char *names[] = LOGGING_STATS_NAMES;
+    logging_stats_t s;
+
+    logging_stats_snapshot(&s);
+    for (int i = 0; i < LOGGING_STATS_STAGES; ++i) {
+        if (s.count[i] == 0) {
+            continue;
+        }
+        fprintf(stderr, "%-8s %10llu calls %8.1f avg p50 < %llu p99 < %llu"
+            " cycles\n", names[i], (unsigned long long)s.count[i],
+            (double)s.cycles[i] / (double)s.count[i],
+            (unsigned long long)logging_stats_percentile(&s, i, 0.5),
+            (unsigned long long)logging_stats_percentile(&s, i, 0.99));
+    }
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? atol(argv[1]) : 200000;
+    const char *path = argc > 2 ? argv[2] : NULL;
+
+#if defined(BENCH_SINK_FILE)
+    bench_sink = fopen(BENCH_SINK_FILE, "w");
+#else
+    bench_sink = fopen("/dev/null", "w");
+#endif
+    if (bench_sink == NULL) {
+        perror("sink");
+        return -1;
+    }
+
+    bench_single(BENCH_NAME, n, bench_call, path);
+#if defined(LOGGING_CONF_STATS)
+    bench_stats();
+#endif
+
+    fclose(bench_sink);
+    return 0;
+}
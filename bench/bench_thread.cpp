@@ -0,0 +1,96 @@
+/*
+  LOGGING_LOG_THREAD with 1 to 64 producers and one writer thread draining
+  the record list. Throughput is end to end (until the list is drained),
+  latency is what a producer sees per call.
+
+  usage: bench_thread [calls] [result.jsonl]
+*/
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "bench.h"
+
+std::mutex lock;
+FILE *bench_sink;
+
+#define LOGGING_LOG_LOCKING
+#define LOGGING_LOCK() lock.lock()
+#define LOGGING_UNLOCK() lock.unlock()
+#define LOGGING_LOG_THREAD
+#define LOGGING_LOG_RECORD_LIST logging_log_record_list
+#include "Logging.h"
+log_record_t *logging_log_record_list;
+
+static bool bench_more(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return logging_log_record_list != NULL;
+}
+
+static void bench_run(int producers, long n, const char *path)
+{
+    std::vector<std::thread> threads;
+    std::vector<int64_t> lat(n);
+    std::atomic<bool> running(true);
+    long per = n / producers;
+    bench_result_t r;
+    int64_t t0, t1;
+
+    memset(&r, 0, sizeof(r));
+    r.name = "thread";
+    r.threads = producers;
+    r.calls = per * producers;
+
+    std::thread writer([&running]() {
+        while (running.load() || bench_more()) {
+            LOGGING_THREAD_LOOP(logging_log_record_list);
+        }
+    });
+
+    t0 = bench_now();
+    for (int t = 0; t < producers; ++t) {
+        threads.push_back(std::thread([t, per, &lat]() {
+            int64_t *l = &lat[t * per];
+            for (long i = 0; i < per; ++i) {
+                int64_t s = bench_now();
+                LOG_INFO("bench %ld %s", i, "payload");
+                l[i] = bench_now() - s;
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    running = false;
+    writer.join();
+    t1 = bench_now();
+
+    r.calls_per_sec = r.calls * 1e9 / (double)(t1 - t0);
+    r.ns_per_call = 0;
+    for (long i = 0; i < r.calls; ++i) {
+        r.ns_per_call += (double)lat[i];
+    }
+    r.ns_per_call /= r.calls;
+    bench_percentiles(&r, &lat[0], r.calls);
+    bench_report(&r, path);
+}
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? atol(argv[1]) : 200000;
+    const char *path = argc > 2 ? argv[2] : NULL;
+
+    bench_sink = fopen("/dev/null", "w");
+    if (bench_sink == NULL) {
+        perror("sink");
+        return -1;
+    }
+
+    for (int producers = 1; producers <= 64; producers *= 2) {
+        bench_run(producers, n, path);
+    }
+
+    fclose(bench_sink);
+    return 0;
+}
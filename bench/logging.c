@@ -0,0 +1,2 @@
+#define LOGGING_AS_SOURCE
+#include "Logging.h"
@@ -0,0 +1,190 @@
+/*
+  LOGGING_LOG_THREAD under load: 1 to 128 producers and one writer thread
+  draining the record list into a direction checking every record. A
+  record carries its producer, its number in the producer and a payload
+  whose length and bytes follow from both, so that a lost, duplicated,
+  reordered or torn record is told apart. Throughput is end to end, the
+  speedup and efficiency are against a single producer.
+
+  usage: stress_thread [records per producer] [max producers] [result.jsonl]
+  exits 1 when a record was wrong
+*/
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "bench.h"
+
+#ifndef STRESS_NAME
+# define STRESS_NAME "stress_thread"
+#endif
+#define STRESS_MAX_PRODUCERS 128
+#define STRESS_MAX_PAYLOAD 200
+
+std::mutex lock;
+static void stress_write(void *dir, const void *data, size_t size);
+
+#define LOGGING_LOG_LOCKING
+#define LOGGING_LOCK() lock.lock()
+#define LOGGING_UNLOCK() lock.unlock()
+#define LOGGING_LOG_THREAD
+#define LOGGING_LOG_RECORD_LIST logging_log_record_list
+#define LOGGING_LOG_DIRECTION NULL
+#define LOGGING_DIR_WRITE stress_write
+#include "Logging.h"
+log_record_t *logging_log_record_list;
+
+typedef struct stress_check
+{
+    long next[STRESS_MAX_PRODUCERS]; // number expected of each producer
+    long received;
+    long lost; // numbers skipped
+    long duplicated; // numbers seen again
+    long torn; // records not parsed or with a wrong payload
+} stress_check_t;
+
+static stress_check_t check; // only touched by the writer thread
+
+static char stress_byte(int producer, long i)
+{
+    return (char)('a' + (producer * 7 + i) % 26);
+}
+
+static size_t stress_len(int producer, long i)
+{
+    return (size_t)((producer * 31 + i * 17) % STRESS_MAX_PAYLOAD);
+}
+
+/* A record is "...: <producer> <number> <payload>\n". */
+static void stress_write(void *dir, const void *data, size_t size)
+{
+    const char *m = (const char *)data, *end = m + size, *p;
+    char *next;
+    long producer, i;
+    size_t len;
+
+    (void)dir;
+    ++check.received;
+    p = (const char *)memchr(m, ':', size);
+    if (p == NULL || end - p < 2 || end[-1] != '\n') {
+        ++check.torn;
+        return;
+    }
+    producer = strtol(p + 1, &next, 10);
+    i = strtol(next, &next, 10);
+    if (producer < 0 || producer >= STRESS_MAX_PRODUCERS || *next != ' ') {
+        ++check.torn;
+        return;
+    }
+    len = stress_len((int)producer, i);
+    if ((size_t)(end - 1 - (next + 1)) != len) {
+        ++check.torn;
+        return;
+    }
+    for (size_t k = 0; k < len; ++k) {
+        if (next[1 + k] != stress_byte((int)producer, i)) {
+            ++check.torn;
+            return;
+        }
+    }
+    if (i < check.next[producer]) {
+        ++check.duplicated;
+        return;
+    }
+    check.lost += i - check.next[producer];
+    check.next[producer] = i + 1;
+}
+
+static bool stress_more(void)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return logging_log_record_list != NULL;
+}
+
+/* Records per second of producers producers, false when one was wrong. */
+static bool stress_run(int producers, long n, double base, double *rate,
+                       const char *path)
+{
+    std::vector<std::thread> threads;
+    std::atomic<bool> running(true);
+    char payload[STRESS_MAX_PRODUCERS][STRESS_MAX_PAYLOAD + 1];
+    int64_t t0, t1;
+    long expected = (long)producers * n;
+    bool ok;
+
+    memset(&check, 0, sizeof(check));
+    std::thread writer([&running]() {
+        while (running.load() || stress_more()) {
+            LOGGING_THREAD_LOOP(logging_log_record_list);
+        }
+    });
+
+    t0 = bench_now();
+    for (int t = 0; t < producers; ++t) {
+        threads.push_back(std::thread([t, n, &payload]() {
+            char *s = payload[t];
+            for (long i = 0; i < n; ++i) {
+                size_t len = stress_len(t, i);
+                memset(s, stress_byte(t, i), len);
+                s[len] = '\0';
+                LOG_INFO("%d %ld %s", t, i, s);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    running = false;
+    writer.join();
+    t1 = bench_now();
+
+    for (int t = 0; t < producers; ++t) {
+        check.lost += n - check.next[t]; // the last ones
+    }
+    *rate = expected * 1e9 / (double)(t1 - t0);
+    ok = check.received == expected && check.lost == 0
+      && check.duplicated == 0 && check.torn == 0;
+
+    printf("%9d %12ld %14.0f %8.2f %10.2f %8ld %8ld %8ld %s\n", producers,
+           check.received, *rate, *rate / (base ? base : *rate),
+           *rate / (base ? base : *rate) / producers, check.lost,
+           check.duplicated, check.torn, ok ? "ok" : "FAILED");
+    if (path) {
+        FILE *out = fopen(path, "a");
+        if (out == NULL) {
+            perror(path);
+        }
+        else {
+            fprintf(out, "{\"name\":\"%s\",\"threads\":%d,"
+                         "\"records\":%ld,\"records_per_sec\":%.0f,"
+                         "\"speedup\":%.3f,\"efficiency\":%.3f,"
+                         "\"lost\":%ld,\"duplicated\":%ld,\"torn\":%ld}\n",
+                    STRESS_NAME, producers, check.received, *rate,
+                    *rate / (base ? base : *rate),
+                    *rate / (base ? base : *rate) / producers,
+                    check.lost, check.duplicated, check.torn);
+            fclose(out);
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    long n = argc > 1 ? atol(argv[1]) : 20000;
+    int max = argc > 2 ? atoi(argv[2]) : STRESS_MAX_PRODUCERS;
+    const char *path = argc > 3 ? argv[3] : NULL;
+    double base = 0, rate;
+    bool ok = true;
+
+    max = max < 1 ? 1 : max > STRESS_MAX_PRODUCERS ? STRESS_MAX_PRODUCERS : max;
+    printf("%9s %12s %14s %8s %10s %8s %8s %8s\n", "producers", "records",
+           "records/s", "speedup", "efficiency", "lost", "dup", "torn");
+    for (int producers = 1; producers <= max; // doubling, and max last
+         producers = producers < max && producers * 2 > max ? max
+                                                             : producers * 2) {
+        ok = stress_run(producers, n, base, &rate, path) && ok;
+        base = base ? base : rate;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,30 @@
+/*
+  Raw return addresses on the error records, named when they are written.
+  Linked with -rdynamic, so dladdr also finds the program's own functions.
+  The load map saved at the end lets logging-symbolize name them offline.
+*/
+#define LOGGING_LOG_BTRC
+#define LOGGING_CONF_BTRC_SYMBOLS
+#define LOGGING_LOG_LEVELFLAG
+#include "Logging.h"
+
+void parse(const char *s)
+{
+    if (s[0] != '{') {
+        LOG_ERROR("parse: bad input '%s'", s); // the stack, and its frames
+    }
+    LOG_INFO("parsed '%s'", s); // no stack
+}
+
+void load(const char *s)
+{
+    parse(s);
+}
+
+int main()
+{
+    load("{}");
+    load("oops");
+    logging_btrc_loadmap("backtrace.maps.txt");
+    return 0;
+}
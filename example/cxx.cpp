@@ -0,0 +1,39 @@
+#include <string>
+#define LOGGING_CONF_CXX
+#define LOGGING_LOG_LEVELFLAG
+#define LOGGING_LOG_MODULE "cxx"
+#define LOGGING_LOG_FILELINE
+#define LOGGING_LOG_TIME
+#include "Logging.h"
+
+struct point
+{
+    int x, y;
+};
+void cxx_module(const std::string &user); // cxx_module.cpp, module "net"
+template <>
+struct logging::writer<point>
+{
+    static void write(logging::buffer &b, const point &p)
+    {
+        b.append("(");
+        logging::writer<int>::write(b, p.x);
+        b.append(", ");
+        logging::writer<int>::write(b, p.y);
+        b.append(")");
+    }
+};
+
+int main()
+{
+    std::string user = "alice";
+    point at = { 3, 4 };
+
+    logging::debug("{}", "debug");
+    logging::info("user={} ratio={} ok={}", user, 0.5, true);
+    cxx_module(user);
+    logging::warn(LOGGING_FMT("at={} {{checked at compile time}}"), at);
+    logging::error("error");
+
+    return 0;
+}
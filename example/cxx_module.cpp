@@ -0,0 +1,15 @@
+/*
+  The other module of the cxx example: its records carry its own module
+  name, although main logs with the same argument types.
+*/
+#include <string>
+#define LOGGING_CONF_CXX
+#define LOGGING_LOG_LEVELFLAG
+#define LOGGING_LOG_MODULE "net"
+#define LOGGING_LOG_FILELINE
+#include "Logging.h"
+
+void cxx_module(const std::string &user)
+{
+    logging::info("user={} ratio={} ok={}", user, 0.25, false);
+}
@@ -0,0 +1,28 @@
+/*
+  Logging to a preallocated file through O_DIRECT, without the page cache.
+  The file reads as zeros past the records while the program runs, and is
+  cut where they end at exit.
+*/
+#define LOGGING_CONF_DIRECT
+#define LOGGING_LOG_LEVELFLAG
+#define LOGGING_LOG_DIRECTION (&app_log)
+#define LOGGING_DIR_WRITE logging_direct_write
+#include "Logging.h"
+
+static log_direct_t app_log = { "direct.log", 100 };
+
+int main()
+{
+    for (int i = 0; i < 10000; ++i) {
+        LOG_INFO("record %d", i); // whole blocks as the buffer fills
+    }
+    LOG_ERROR("error"); // writes the partial block, padded
+    LOG_INFO("after"); // written again with the block, 100 ms later at most
+    logging_direct_flush(&app_log);
+
+    printf("%s, %llu blocks written, %llu errors\n",
+           app_log.direct ? "O_DIRECT" : "page cache",
+           (unsigned long long)app_log.blocks,
+           (unsigned long long)app_log.errors);
+    return 0;
+}
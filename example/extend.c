@@ -8,6 +8,10 @@ int main()
         LOG_IF_CHANGED(a[i], "%s", ret[i]);
     }
 
+    for (int i = 0; i < 4; ++i) {
+        LOG_IF_CHANGED_VALUE(char, a[i], "%d", "a[%d]", i); // a[0] (0 -> 1)
+    }
+
     int b = 1;
     LOG_IF(b == 1, "ok");
     LOG_IF(b == 0, "error");
@@ -0,0 +1,24 @@
+#define LOGGING_LOG_JSON
+#define LOGGING_LOG_LEVELFLAG
+#define LOGGING_LOG_MODULE "json"
+#define LOGGING_LOG_FILELINE
+#define LOGGING_LOG_TIME
+#define LOGGING_LOG_FUNCTION
+#define LOGGING_LOG_PROCID
+#define LOGGING_LOG_THRDID
+#include "Logging.h"
+
+int main()
+{
+    const char *user = "alice \"the admin\"";
+    long latency_us = 1234;
+
+    LOG_DEBUG("%s", "debug");
+    LOG_INFO("multi\nline\ttext");
+    LOG_INFO_KV("login", "user", user, "latency_us", latency_us,
+                "ratio", 0.5, "ok", (_Bool)1);
+    LOG_WARN_KV("no fields");
+    LOG_ERROR("error");
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+/*
+  A configuration file read again at runtime. Its max_size rolls back a
+  file it configures; the io_uring direction, which is not a FILE *, is
+  left as it is.
+*/
+#define LOGGING_CONF_RELOAD
+#define LOGGING_CONF_URING
+#define LOGGING_LOG_LEVELFLAG
+#define LOGGING_LOG_DIRECTION (&app_log)
+#define LOGGING_DIR_WRITE logging_uring_write
+#include <sys/stat.h>
+#include "Logging.h"
+
+static log_uring_t app_log = { "reload.log" };
+
+static void configure(const char *settings)
+{
+    FILE *f = fopen("reload.conf", "w");
+    fputs(settings, f);
+    fclose(f);
+    if (logging_config_load("reload.conf") != 0) {
+        printf("reload.conf rejected\n");
+    }
+}
+
+static long size_of(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+int main()
+{
+    configure("max_size = 1K\n");
+    for (int i = 0; i < 100; ++i) {
+        LOG_INFO("record %d", i); // to io_uring, not rolled back
+    }
+    logging_uring_flush(&app_log);
+
+    configure("file = reload.txt\nmax_size = 1K\n");
+    for (int i = 0; i < 100; ++i) {
+        LOG_INFO("record %d", i); // to reload.txt, rolled back
+    }
+    configure("");
+    logging_config_reclaim(); // closes reload.txt
+
+    printf("reload.log %ld bytes, reload.txt %ld bytes\n",
+           size_of("reload.log"), size_of("reload.txt"));
+    return 0;
+}
@@ -0,0 +1,39 @@
+/*
+  Logging from signal handlers. LOG_ERROR could deadlock there, on the
+  lock, the heap or stdout's own lock held by the code interrupted, while
+  LOG_SIGNAL_SAFE only formats into a static buffer and calls write(2).
+*/
+#define LOGGING_CONF_SIGNAL_SAFE
+#define LOGGING_LOG_LEVELFLAG
+#define LOGGING_LOG_TIME
+#define LOGGING_LOG_FUNCTION
+#include <signal.h>
+#include "Logging.h"
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+    LOG_SIGNAL_SAFE("caught signal %d, stopping", sig);
+    stop = 1;
+}
+
+int main()
+{
+    int i;
+
+    LOG_SIGNAL_SAFE_SETUP(); // stdout's fd, before any handler runs
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    for (i = 0; i < 10 && !stop; ++i) {
+        LOG_INFO("record %d", i);
+        fflush(stdout); // else the handler's record comes out first
+        if (i == 5) {
+            raise(SIGTERM);
+        }
+    }
+    LOG_SIGNAL_SAFE("%-6s|%5s|%05d|%x|%p|%.3s|%c|%lld|%zu|%f|100%%", "left",
+                    "right", -42, 255u, (void *)&i, "truncated", 'c',
+                    -9000000000LL, sizeof(i), 1.5);
+    return 0;
+}
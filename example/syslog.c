@@ -0,0 +1,66 @@
+/*
+  Logging to a syslog socket. A stand-in listener is bound in /tmp, so the
+  datagrams can be printed as they arrive without a syslog daemon.
+*/
+#define _POSIX_C_SOURCE 200809L
+#define LOGGING_CONF_SYSLOG
+#define LOGGING_LOG_LEVELFLAG
+#define LOGGING_LOG_DIRECTION (&app_log)
+#define LOGGING_DIR_WRITE logging_syslog_write
+#include "Logging.h"
+
+#define SOCKET_PATH "/tmp/logging-syslog-example.sock"
+
+static log_syslog_t app_log = { SOCKET_PATH, "example", 0, 0, 100 };
+
+static int listener(void)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, SOCKET_PATH);
+    unlink(SOCKET_PATH);
+    if (fd < 0 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("listener");
+        exit(1);
+    }
+    return fd;
+}
+
+static void receive(int fd)
+{
+    char buf[1024];
+    ssize_t n;
+
+    while ((n = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT)) > 0) {
+        buf[n] = '\0';
+        printf("received: %s\n", buf);
+    }
+}
+
+int main()
+{
+    int fd = listener();
+
+    LOG_DEBUG("%s", "debug");
+    LOG_INFO("info");
+    LOG_WARN("warn");
+    LOG_ERROR("error"); // sends the batch of 4 datagrams
+    receive(fd);
+
+    close(fd); // the listener restarts, the sink reconnects
+    fd = listener();
+    LOG_INFO("after restart");
+    logging_syslog_flush(&app_log);
+    receive(fd);
+
+    printf("sent %llu, dropped %llu, connects %llu\n",
+           (unsigned long long)app_log.sent,
+           (unsigned long long)app_log.dropped,
+           (unsigned long long)app_log.connects);
+    close(fd);
+    unlink(SOCKET_PATH);
+    return 0;
+}
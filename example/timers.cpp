@@ -0,0 +1,39 @@
+/*
+  Timing sections into histograms, reported as one record per timer every
+  LOGGING_CONF_TIMERS_MS instead of one record per sample.
+*/
+#include <thread>
+#include <vector>
+#define LOGGING_CONF_TIMERS
+#define LOGGING_CONF_TIMERS_MS 100
+#define LOGGING_LOG_LEVELFLAG
+#include "Logging.h"
+
+static volatile unsigned sink;
+
+static void parse(int n)
+{
+    LOG_SCOPE_TIMER("parse"); // until the end of the function
+    for (int i = 0; i < n; ++i) {
+        sink += i;
+    }
+}
+
+int main()
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.push_back(std::thread([]() {
+            for (int i = 0; i < 20000; ++i) {
+                LOG_TIMER_BEGIN(step);
+                parse(i % 100 ? 100 : 10000);
+                LOG_TIMER_END(step);
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+    logging_timers_report(); // what is left since the last report
+    return 0;
+}
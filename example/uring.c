@@ -0,0 +1,27 @@
+/*
+  Logging to a file through io_uring: the buffers are written while the
+  program goes on, and waited for only when all of them are in flight.
+*/
+#define LOGGING_CONF_URING
+#define LOGGING_LOG_LEVELFLAG
+#define LOGGING_LOG_DIRECTION (&app_log)
+#define LOGGING_DIR_WRITE logging_uring_write
+#include "Logging.h"
+
+static log_uring_t app_log = { "uring.log", 100 };
+
+int main()
+{
+    for (int i = 0; i < 100000; ++i) {
+        LOG_INFO("record %d", i); // a write submitted per full buffer
+    }
+    LOG_ERROR("error"); // submits the partial buffer
+    logging_uring_flush(&app_log);
+
+    printf("%s, %llu writes, %llu waits, %llu errors\n",
+           app_log.ring ? "io_uring" : "pwrite thread",
+           (unsigned long long)app_log.writes,
+           (unsigned long long)app_log.waits,
+           (unsigned long long)app_log.errors);
+    return 0;
+}
@@ -0,0 +1,6 @@
+/*
+  The prebuilt logging_static and logging_shared library: every function of
+  Logging.h, including the out of line LOGGING_CONF_SLOW_PATH, compiled once.
+*/
+#define LOGGING_AS_SOURCE
+#include "Logging.h"
@@ -0,0 +1,276 @@
+/*
+  Merge log files into one stream ordered by the records' sequence numbers
+  (LOGGING_LOG_SEQN), monotonic times (LOGGING_LOG_MONOTIME) or times
+  (LOGGING_LOG_TIME), text or JSON lines. Each file is read as it goes,
+  holding at most a window of records of it: with a window of 1 it is a
+  k-way merge of sorted files, a wider one also sorts records logged out of
+  order by up to that many places, e.g. in a file shared with O_APPEND.
+  Lines without the key are continuations of the record before them.
+
+  usage: logging-merge [-k seqn|mono|time] [-w window] file...
+  the key is by default the first of seqn, mono and time all files have
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+enum { MERGE_SEQN, MERGE_MONO, MERGE_TIME, MERGE_KEYS };
+static const char *const merge_keys[MERGE_KEYS] = { "seqn", "mono", "time" };
+
+typedef struct merge_rec
+{
+    uint64_t key;
+    uint64_t order; // read order in its file, for equal keys
+    int in;
+    char *text;
+    size_t len;
+} merge_rec_t;
+
+typedef struct merge_in
+{
+    FILE *f;
+    const char *name;
+    char *line; // read ahead, the first line of the next record
+    size_t cap;
+    ssize_t len; // -1 when there is no line ahead
+    size_t queued; // records of it in the heap
+    uint64_t order;
+} merge_in_t;
+
+/* Parse digits at s into *v, the number of them. */
+static int merge_digits(const char *s, const char *end, uint64_t *v)
+{
+    int n = 0;
+    for (*v = 0; s + n < end && s[n] >= '0' && s[n] <= '9'; ++n) {
+        *v = *v * 10 + (uint64_t)(s[n] - '0');
+    }
+    return n;
+}
+
+/* A "seconds.micros" time as micros, 0 if it is not one. */
+static int merge_time(const char *s, const char *end, uint64_t *v)
+{
+    uint64_t secs, us;
+    int n = merge_digits(s, end, &secs);
+    if (n == 0 || s + n >= end || s[n] != '.'
+        || merge_digits(s + n + 1, end, &us) != 6) {
+        return 0;
+    }
+    *v = secs * 1000000 + us;
+    return 1;
+}
+
+/*
+  Find the key of a line in the fields in front of its message: the text
+  "seq(N)", "mono(N)" and "[S.U]", or the JSON "seqn":N, "mono":N and
+  "time":S.U before "msg".
+*/
+static int merge_key(const char *line, size_t len, int kind, uint64_t *v)
+{
+    static const char *const text[] = { "seq(", "mono(", "[" };
+    static const char *const json[] = { "\"seqn\":", "\"mono\":", "\"time\":" };
+    const char *end, *p, *tag;
+    char *cut;
+
+    if (len > 0 && line[0] == '{') {
+        cut = strstr(line, "\"msg\":");
+        tag = json[kind];
+    }
+    else {
+        cut = strstr(line, ": ");
+        tag = text[kind];
+    }
+    end = cut ? cut : line + len;
+    for (p = line; p < end && (p = strstr(p, tag)) != NULL && p < end; ++p) {
+        const char *at = p + strlen(tag);
+        if (kind == MERGE_TIME ? merge_time(at, end, v)
+                               : merge_digits(at, end, v) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Read the next record of in, its first line and the continuations. */
+static int merge_read(merge_in_t *in, int kind, merge_rec_t *r)
+{
+    size_t cap = 0;
+    if (in->len < 0) {
+        in->len = getline(&in->line, &in->cap, in->f);
+    }
+    if (in->len < 0) {
+        return 0;
+    }
+    if (!merge_key(in->line, (size_t)in->len, kind, &r->key)) {
+        r->key = 0; // lines before the first record
+    }
+    r->text = in->line;
+    r->len = (size_t)in->len;
+    cap = in->cap;
+    in->line = NULL;
+    in->cap = 0;
+    while ((in->len = getline(&in->line, &in->cap, in->f)) >= 0) {
+        uint64_t v;
+        if (merge_key(in->line, (size_t)in->len, kind, &v)) {
+            break;
+        }
+        if (r->len + (size_t)in->len + 1 > cap) {
+            cap = (r->len + (size_t)in->len + 1) * 2;
+            if ((r->text = (char *)realloc(r->text, cap)) == NULL) {
+                perror("logging-merge");
+                exit(1);
+            }
+        }
+        memcpy(r->text + r->len, in->line, (size_t)in->len + 1);
+        r->len += (size_t)in->len;
+    }
+    r->order = in->order++;
+    return 1;
+}
+
+static int merge_less(const merge_rec_t *a, const merge_rec_t *b)
+{
+    if (a->key != b->key) {
+        return a->key < b->key;
+    }
+    if (a->in != b->in) {
+        return a->in < b->in;
+    }
+    return a->order < b->order;
+}
+
+static void merge_push(merge_rec_t *heap, size_t *n, const merge_rec_t *r)
+{
+    size_t i = (*n)++;
+    heap[i] = *r;
+    while (i > 0 && merge_less(&heap[i], &heap[(i - 1) / 2])) {
+        merge_rec_t t = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = t;
+        i = (i - 1) / 2;
+    }
+}
+
+static merge_rec_t merge_pop(merge_rec_t *heap, size_t *n)
+{
+    merge_rec_t top = heap[0];
+    size_t i = 0;
+    heap[0] = heap[--*n];
+    for (;;) {
+        size_t l = 2 * i + 1, m = i;
+        if (l < *n && merge_less(&heap[l], &heap[m])) {
+            m = l;
+        }
+        if (l + 1 < *n && merge_less(&heap[l + 1], &heap[m])) {
+            m = l + 1;
+        }
+        if (m == i) {
+            break;
+        }
+        {
+            merge_rec_t t = heap[i];
+            heap[i] = heap[m];
+            heap[m] = t;
+        }
+        i = m;
+    }
+    return top;
+}
+
+/* Fill the window of in. */
+static void merge_fill(merge_in_t *ins, int i, int kind, size_t window,
+                       merge_rec_t *heap, size_t *n)
+{
+    merge_rec_t r;
+    while (ins[i].queued < window && merge_read(&ins[i], kind, &r)) {
+        r.in = i;
+        merge_push(heap, n, &r);
+        ++ins[i].queued;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    static char out[1 << 20];
+    merge_in_t *ins;
+    merge_rec_t *heap;
+    size_t window = 1, n = 0;
+    int kind = -1, count, opt;
+
+    while ((opt = getopt(argc, argv, "k:w:h")) != -1) {
+        switch (opt) {
+        case 'k':
+            for (kind = MERGE_KEYS - 1; kind >= 0; --kind) {
+                if (strcmp(optarg, merge_keys[kind]) == 0) {
+                    break;
+                }
+            }
+            if (kind < 0) {
+                fprintf(stderr, "logging-merge: %s: not a key\n", optarg);
+                return 1;
+            }
+            break;
+        case 'w': window = (size_t)atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-k seqn|mono|time] [-w window] "
+                    "file...\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    count = argc - optind;
+    if (count < 1 || window < 1) {
+        fprintf(stderr, "usage: %s [-k seqn|mono|time] [-w window] file...\n",
+                argv[0]);
+        return 1;
+    }
+    ins = (merge_in_t *)calloc((size_t)count, sizeof(merge_in_t));
+    heap = (merge_rec_t *)calloc((size_t)count * window, sizeof(merge_rec_t));
+    if (ins == NULL || heap == NULL) {
+        perror("logging-merge");
+        return 1;
+    }
+    for (int i = 0; i < count; ++i) {
+        ins[i].name = argv[optind + i];
+        ins[i].f = strcmp(ins[i].name, "-") == 0 ? stdin
+                 : fopen(ins[i].name, "r");
+        if (ins[i].f == NULL) {
+            perror(ins[i].name);
+            return 1;
+        }
+        ins[i].len = getline(&ins[i].line, &ins[i].cap, ins[i].f);
+    }
+    if (kind < 0) { // the first key every file's first line has
+        for (kind = 0; kind < MERGE_KEYS - 1; ++kind) {
+            int all = 1;
+            for (int i = 0; i < count && all; ++i) {
+                uint64_t v;
+                all = ins[i].len < 0 || merge_key(ins[i].line,
+                          (size_t)ins[i].len, kind, &v);
+            }
+            if (all) {
+                break;
+            }
+        }
+    }
+
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+    for (int i = 0; i < count; ++i) {
+        merge_fill(ins, i, kind, window, heap, &n);
+    }
+    while (n > 0) {
+        merge_rec_t r = merge_pop(heap, &n);
+        fwrite(r.text, 1, r.len, stdout);
+        if (r.len > 0 && r.text[r.len - 1] != '\n') { // a last line
+            putchar('\n');
+        }
+        free(r.text);
+        --ins[r.in].queued;
+        merge_fill(ins, r.in, kind, window, heap, &n);
+    }
+    fflush(stdout);
+    return 0;
+}
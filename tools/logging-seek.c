@@ -0,0 +1,141 @@
+/*
+  Print the part of a log written between two times, found by a binary
+  search of its LOGGING_CONF_INDEX side file instead of a scan of the log.
+  The window is widened to the index entries around it, records written
+  before the first entry are always included.
+
+  usage: logging-seek [-i index] log from [to]
+  times are seconds since the epoch or local "YYYY-MM-DD[ T]HH:MM:SS"
+*/
+#define _POSIX_C_SOURCE 200809L
+#define LOGGING_CONF_INDEX
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "Logging.h"
+
+static int64_t seek_time(const char *s)
+{
+    struct tm tm;
+    char *end;
+    double secs;
+
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(s, "%d-%d-%d%*[ T]%d:%d:%d", &tm.tm_year, &tm.tm_mon,
+               &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) == 6) {
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        return (int64_t)mktime(&tm) * 1000000;
+    }
+    secs = strtod(s, &end);
+    if (end == s || *end) {
+        fprintf(stderr, "logging-seek: %s: not a time\n", s);
+        exit(1);
+    }
+    return (int64_t)(secs * 1e6);
+}
+
+/* The first of the n entries written after t. */
+static size_t seek_after(const logging_index_entry_t *e, size_t n, int64_t t)
+{
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (e[mid].time <= t) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *index = NULL;
+    char name[512], buf[64 * 1024];
+    const logging_index_header_t *h;
+    const logging_index_entry_t *e;
+    struct stat log_st, st;
+    uint64_t begin = 0, end;
+    int64_t from, to = INT64_MAX;
+    size_t n, i;
+    void *m;
+    int fd, log, opt;
+
+    while ((opt = getopt(argc, argv, "i:h")) != -1) {
+        switch (opt) {
+        case 'i': index = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-i index] log from [to]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (argc - optind < 2) {
+        fprintf(stderr, "usage: %s [-i index] log from [to]\n", argv[0]);
+        return 1;
+    }
+    from = seek_time(argv[optind + 1]);
+    if (argc - optind > 2) {
+        to = seek_time(argv[optind + 2]);
+    }
+    if (index == NULL) {
+        snprintf(name, sizeof(name), "%s.idx", argv[optind]);
+        index = name;
+    }
+
+    if ((log = open(argv[optind], O_RDONLY)) < 0 || fstat(log, &log_st) != 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    if ((fd = open(index, O_RDONLY)) < 0 || fstat(fd, &st) != 0) {
+        perror(index);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(*h)) {
+        fprintf(stderr, "logging-seek: %s: not an index\n", index);
+        return 1;
+    }
+    m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        perror(index);
+        return 1;
+    }
+    h = (const logging_index_header_t *)m;
+    if (h->magic != LOGGING_INDEX_MAGIC || h->version != LOGGING_INDEX_VERSION) {
+        fprintf(stderr, "logging-seek: %s: unknown layout\n", index);
+        return 1;
+    }
+    e = (const logging_index_entry_t *)(h + 1);
+    n = ((size_t)st.st_size - sizeof(*h)) / sizeof(*e);
+    while (n > 0 && e[n - 1].offset > (uint64_t)log_st.st_size) {
+        --n; // not flushed yet, or the log was rolled back under us
+    }
+
+    i = seek_after(e, n, from);
+    if (i > 0) {
+        begin = e[i - 1].offset; // written before from, kept as a margin
+    }
+    i = seek_after(e, n, to);
+    end = i < n ? e[i].offset : (uint64_t)log_st.st_size;
+
+    while (begin < end) {
+        size_t want = end - begin < sizeof(buf) ? (size_t)(end - begin)
+                                                : sizeof(buf);
+        ssize_t got = pread(log, buf, want, (off_t)begin);
+        if (got <= 0) {
+            break;
+        }
+        fwrite(buf, 1, (size_t)got, stdout);
+        begin += (uint64_t)got;
+    }
+    munmap(m, (size_t)st.st_size);
+    close(log);
+    return 0;
+}
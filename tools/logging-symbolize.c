@@ -0,0 +1,187 @@
+/*
+  Name the frames of the raw backtraces (LOGGING_LOG_BTRC) in a log, text
+  or JSON lines, after the process is gone. The executable mappings saved
+  by logging_btrc_loadmap turn each address into a module and an offset,
+  which addr2line turns into a function and a source line.
+
+  usage: logging-symbolize -m maps [-n] [log...]
+  -n only prints modules and offsets, without running addr2line
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define SYMBOLIZE_DEPTH 64
+
+typedef struct symbolize_map
+{
+    uint64_t start, end, offset;
+    char path[512];
+    int exec; // an ET_EXEC module is linked at its addresses
+} symbolize_map_t;
+
+static symbolize_map_t *maps;
+static size_t nmaps;
+
+static int symbolize_is_exec(const char *path)
+{
+    unsigned char h[18];
+    FILE *f = fopen(path, "rb");
+    int exec = 0;
+    if (f && fread(h, 1, sizeof(h), f) == sizeof(h)
+        && memcmp(h, "\177ELF", 4) == 0) {
+        exec = (h[5] == 1 ? h[16] | h[17] << 8 : h[17] | h[16] << 8) == 2;
+    }
+    if (f) {
+        fclose(f);
+    }
+    return exec;
+}
+
+static int symbolize_load(const char *name)
+{
+    char line[1024];
+    FILE *f = fopen(name, "r");
+    size_t cap = 0;
+
+    if (f == NULL) {
+        perror(name);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        symbolize_map_t m;
+        unsigned long long start, end, offset;
+        if (sscanf(line, "%llx-%llx %*s %llx %*s %*s %511s", &start, &end,
+                   &offset, m.path) != 4 || m.path[0] != '/') {
+            continue; // anonymous, [vdso] and the like
+        }
+        if (nmaps == cap) {
+            cap = cap ? cap * 2 : 64;
+            maps = (symbolize_map_t *)realloc(maps, cap * sizeof(*maps));
+            if (maps == NULL) {
+                perror("logging-symbolize");
+                exit(1);
+            }
+        }
+        m.start = start;
+        m.end = end;
+        m.offset = offset;
+        m.exec = symbolize_is_exec(m.path);
+        maps[nmaps++] = m;
+    }
+    fclose(f);
+    return 0;
+}
+
+static const symbolize_map_t *symbolize_find(uint64_t pc)
+{
+    for (size_t i = 0; i < nmaps; ++i) {
+        if (pc >= maps[i].start && pc < maps[i].end) {
+            return &maps[i];
+        }
+    }
+    return NULL;
+}
+
+/* The addresses after "bt(" or "btrc":" in front of the message. */
+static int symbolize_parse(const char *line, uint64_t *pcs)
+{
+    const char *p = strstr(line, "\"btrc\":\"0x");
+    char *end;
+    int n = 0;
+
+    p = p ? p + 8 : strstr(line, "bt(0x");
+    p = p && p[0] == 'b' ? p + 3 : p;
+    while (p && n < SYMBOLIZE_DEPTH && p[0] == '0' && p[1] == 'x') {
+        pcs[n++] = strtoull(p + 2, &end, 16);
+        p = *end == ' ' ? end + 1 : end;
+    }
+    return n;
+}
+
+static void symbolize_frame(int i, uint64_t pc, int lines)
+{
+    const symbolize_map_t *m = symbolize_find(pc);
+    char cmd[1024], out[1024];
+    uint64_t off;
+    FILE *p;
+
+    if (m == NULL) {
+        printf("    #%d 0x%llx ?\n", i, (unsigned long long)pc);
+        return;
+    }
+    off = m->exec ? pc : pc - m->start + m->offset;
+    printf("    #%d 0x%llx %s+0x%llx", i, (unsigned long long)pc, m->path,
+           (unsigned long long)off);
+    if (lines && strchr(m->path, '\'') == NULL) {
+        /* a return address, the call is the byte before it */
+        snprintf(cmd, sizeof(cmd), "addr2line -Cfpe '%s' 0x%llx 2>/dev/null",
+                 m->path, (unsigned long long)(off - 1));
+        fflush(stdout);
+        if ((p = popen(cmd, "r")) != NULL) {
+            if (fgets(out, sizeof(out), p) && strncmp(out, "??", 2) != 0) {
+                out[strcspn(out, "\n")] = '\0';
+                printf(" %s", out);
+            }
+            pclose(p);
+        }
+    }
+    putchar('\n');
+}
+
+static void symbolize_file(FILE *f, int lines)
+{
+    char *line = NULL;
+    size_t cap = 0;
+    uint64_t pcs[SYMBOLIZE_DEPTH];
+
+    while (getline(&line, &cap, f) >= 0) {
+        int n = symbolize_parse(line, pcs);
+        fputs(line, stdout);
+        for (int i = 0; i < n; ++i) {
+            symbolize_frame(i, pcs[i], lines);
+        }
+    }
+    free(line);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *map = NULL;
+    int lines = 1, opt;
+
+    while ((opt = getopt(argc, argv, "m:nh")) != -1) {
+        switch (opt) {
+        case 'm': map = optarg; break;
+        case 'n': lines = 0; break;
+        default:
+            fprintf(stderr, "usage: %s -m maps [-n] [log...]\n", argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (map == NULL) {
+        fprintf(stderr, "usage: %s -m maps [-n] [log...]\n", argv[0]);
+        return 1;
+    }
+    if (symbolize_load(map) != 0) {
+        return 1;
+    }
+    if (optind == argc) {
+        symbolize_file(stdin, lines);
+    }
+    for (int i = optind; i < argc; ++i) {
+        FILE *f = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "r");
+        if (f == NULL) {
+            perror(argv[i]);
+            return 1;
+        }
+        symbolize_file(f, lines);
+        if (f != stdin) {
+            fclose(f);
+        }
+    }
+    return 0;
+}
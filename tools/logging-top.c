@@ -0,0 +1,209 @@
+/*
+  Live view of the LOGGING_CONF_SHM_METRICS counters of running processes.
+  The /logging.<pid> segments are mapped read only, the logging processes
+  are never attached to or signaled.
+
+  usage: logging-top [-d seconds] [-n iterations] [pid...]
+*/
+#define _POSIX_C_SOURCE 200809L
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <dirent.h>
+#include <time.h>
+#include "Logging.h"
+
+#define TOP_MAX_PROCS 64
+#define TOP_MAX_ROWS (TOP_MAX_PROCS * LOGGING_CONF_METRICS_MODULES * 4)
+
+typedef struct top_proc
+{
+    long long pid;
+    const logging_metrics_t *m;
+    uint64_t last[LOGGING_CONF_METRICS_MODULES]
+                 [LOGGING_METRICS_LEVELS][LOGGING_METRICS_KINDS];
+} top_proc_t;
+
+typedef struct top_row
+{
+    const top_proc_t *p;
+    const char *module;
+    int level;
+    const uint64_t *now;
+    double rate; // records per second
+    double bytes_rate;
+} top_row_t;
+
+static const logging_metrics_t *top_map(long long pid)
+{
+    char name[64];
+    struct stat st;
+    void *m;
+    int fd;
+
+    snprintf(name, sizeof(name), LOGGING_METRICS_SHM_PREFIX "%lld", pid);
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(logging_metrics_t)) {
+        close(fd);
+        return NULL;
+    }
+    m = mmap(NULL, sizeof(logging_metrics_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        return NULL;
+    }
+    if (((const logging_metrics_t *)m)->magic != LOGGING_METRICS_MAGIC
+        || ((const logging_metrics_t *)m)->version != LOGGING_METRICS_VERSION
+        || ((const logging_metrics_t *)m)->size != sizeof(logging_metrics_t)) {
+        fprintf(stderr, "logging-top: %s: unknown layout\n", name);
+        munmap(m, sizeof(logging_metrics_t));
+        return NULL;
+    }
+    return (const logging_metrics_t *)m;
+}
+
+static int top_scan(top_proc_t *procs, int n, int cap)
+{
+    DIR *dir = opendir("/dev/shm");
+    struct dirent *e;
+    const char *prefix = LOGGING_METRICS_SHM_PREFIX + 1;
+
+    if (dir == NULL) {
+        return n;
+    }
+    while (n < cap && (e = readdir(dir)) != NULL) {
+        if (strncmp(e->d_name, prefix, strlen(prefix)) == 0) {
+            procs[n].pid = atoll(e->d_name + strlen(prefix));
+            if ((procs[n].m = top_map(procs[n].pid)) != NULL) {
+                ++n;
+            }
+        }
+    }
+    closedir(dir);
+    return n;
+}
+
+static int top_cmp(const void *a, const void *b)
+{
+    const top_row_t *x = (const top_row_t *)a, *y = (const top_row_t *)b;
+    if (x->bytes_rate != y->bytes_rate) {
+        return x->bytes_rate < y->bytes_rate ? 1 : -1;
+    }
+    return x->now[LOGGING_METRICS_BYTES] < y->now[LOGGING_METRICS_BYTES]
+        ? 1 : -1;
+}
+
+static void top_show(top_proc_t *procs, int n, double secs, top_row_t *rows)
+{
+    const char *levels[] = { "-", "ERROR", "WARN", "INFO", "DEBUG" };
+    int count = 0;
+
+    for (int p = 0; p < n; ++p) {
+        const logging_metrics_t *m = procs[p].m;
+        int alive = kill((pid_t)procs[p].pid, 0) == 0 || errno != ESRCH;
+        printf("pid %lld %s%s\n", procs[p].pid, m->proc,
+               alive ? "" : " (exited)");
+        for (uint32_t i = 0; i < m->modules; ++i) {
+            const logging_metrics_module_t *s = &m->module[i];
+            if (s->state != 2) {
+                continue;
+            }
+            for (int l = 1; l < LOGGING_METRICS_LEVELS; ++l) {
+                const uint64_t *now = s->counter[l];
+                uint64_t *last = procs[p].last[i][l];
+                top_row_t *r = &rows[count];
+                if (now[LOGGING_METRICS_EMITTED] == 0
+                    && now[LOGGING_METRICS_FILTERED] == 0
+                    && now[LOGGING_METRICS_DROPPED] == 0) {
+                    continue;
+                }
+                r->p = &procs[p];
+                r->module = s->name[0] ? s->name : "-";
+                r->level = l;
+                r->now = now;
+                r->rate = secs > 0 ? (double)(now[LOGGING_METRICS_EMITTED]
+                    - last[LOGGING_METRICS_EMITTED]) / secs : 0;
+                r->bytes_rate = secs > 0 ? (double)(now[LOGGING_METRICS_BYTES]
+                    - last[LOGGING_METRICS_BYTES]) / secs : 0;
+                memcpy(last, now, sizeof(uint64_t) * LOGGING_METRICS_KINDS);
+                ++count;
+            }
+        }
+    }
+
+    qsort(rows, count, sizeof(top_row_t), top_cmp);
+    printf("\n%8s %-20s %-5s %10s %10s %10s %10s %10s %12s %14s\n",
+           "PID", "MODULE", "LEVEL", "REC/S", "EMITTED", "FILTERED",
+           "DROPPED", "TRUNCATED", "BYTES/S", "BYTES");
+    for (int i = 0; i < count; ++i) {
+        const uint64_t *c = rows[i].now;
+        printf("%8lld %-20.20s %-5s %10.0f %10llu %10llu %10llu %10llu"
+               " %12.0f %14llu\n", rows[i].p->pid, rows[i].module,
+               levels[rows[i].level], rows[i].rate,
+               (unsigned long long)c[LOGGING_METRICS_EMITTED],
+               (unsigned long long)c[LOGGING_METRICS_FILTERED],
+               (unsigned long long)c[LOGGING_METRICS_DROPPED],
+               (unsigned long long)c[LOGGING_METRICS_TRUNCATED],
+               rows[i].bytes_rate,
+               (unsigned long long)c[LOGGING_METRICS_BYTES]);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    static top_proc_t procs[TOP_MAX_PROCS];
+    static top_row_t rows[TOP_MAX_ROWS];
+    double delay = 1;
+    long iterations = -1;
+    int n = 0, opt, tty = isatty(STDOUT_FILENO);
+    struct timespec ts;
+
+    while ((opt = getopt(argc, argv, "d:n:h")) != -1) {
+        switch (opt) {
+        case 'd': delay = atof(optarg); break;
+        case 'n': iterations = atol(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-d seconds] [-n iterations] [pid...]\n",
+                    argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    for (; optind < argc && n < TOP_MAX_PROCS; ++optind) {
+        procs[n].pid = atoll(argv[optind]);
+        if ((procs[n].m = top_map(procs[n].pid)) == NULL) {
+            fprintf(stderr, "logging-top: no metrics for pid %lld\n",
+                    procs[n].pid);
+            continue;
+        }
+        ++n;
+    }
+    if (n == 0) {
+        n = top_scan(procs, 0, TOP_MAX_PROCS);
+    }
+    if (n == 0) {
+        fprintf(stderr, "logging-top: no process with "
+                "LOGGING_CONF_SHM_METRICS found\n");
+        return 1;
+    }
+
+    ts.tv_sec = (time_t)delay;
+    ts.tv_nsec = (long)((delay - (double)ts.tv_sec) * 1e9);
+    for (long i = 0; iterations < 0 || i < iterations; ++i) {
+        if (tty) {
+            printf("\033[H\033[2J");
+        }
+        top_show(procs, n, i == 0 ? 0 : delay, rows);
+        if (iterations < 0 || i + 1 < iterations) {
+            nanosleep(&ts, NULL);
+        }
+    }
+    return 0;
+}